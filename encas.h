@@ -50,6 +50,32 @@ typedef uint64_t u64;
 #endif
 //---------------
 
+//-----Threads-----
+// Compile with -fopenmp (/openmp) to run the heavy loops on multiple threads,
+// without it every ENCAS_OMP() pragma is a no-op
+#ifdef _OPENMP
+#include <omp.h>
+#define ENCAS_PRAGMA(x) _Pragma(#x)
+#define ENCAS_OMP(x) ENCAS_PRAGMA(omp x)
+#else
+#define ENCAS_OMP(x)
+#endif
+
+// Loops shorter than this stay on one thread
+#ifndef ENCAS_PARALLEL_MIN
+#define ENCAS_PARALLEL_MIN 65536
+#endif
+//---------------
+
+//-----SIMD-----
+// SSE2 is baseline on x86-64, other targets use the scalar loops.
+// Define ENCAS_NO_SIMD to force the scalar loops.
+#if !defined(ENCAS_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define ENCAS_SSE2
+#endif
+//---------------
+
 //-----Alloc-----
 #ifdef ENCAS_CUSTOM_ALLOC
 #define ENCAS_MALLOC(size) ENCAS_CUSTOM_ALLOC(size)
@@ -90,6 +116,18 @@ typedef struct Encas_FaceKeyMap {
     u32 len;
 } Encas_FaceKeyMap;
 
+typedef struct Encas_QuadKey {
+    u32 v[4];
+} Encas_QuadKey;
+
+typedef struct Encas_QuadKeyMap {
+    Encas_QuadKey *keys;
+    u8 *values;
+    u32 *global_indices;
+    u32 cap;
+    u32 len;
+} Encas_QuadKeyMap;
+
 #define ENCAS_TABLE_SIZE 1024
 
 typedef struct Encas_HashEntry {
@@ -102,10 +140,29 @@ typedef struct {
     Encas_HashEntry** table;
 } Encas_HashTable;
 
+// Payload of a Fortran Binary record, see Encas_File.records
+typedef struct Encas_FileRecord {
+    u64 pos;        // Position of the payload in the bytes that size and cur count
+    const u8 *data; // Payload in buffer
+} Encas_FileRecord;
+
 typedef struct Encas_File {
     u8 *buffer;
     u64 size; // Size of file
     u64 cur;  // Current position of cursor in the file
+    bool swap; // File byte order differs from the host, see _encas_detect_byte_order
+    bool owned; // buffer is heap memory (not mapped), freed with ENCAS_FREE
+    u64 buffer_size; // Bytes of buffer
+
+    // Fortran Binary files are read in place. records lists the payloads between the markers
+    // (num_records of them and one past the last), size and cur only count payload bytes.
+    // joined holds the records split in sub-records, a read over several records is gathered
+    // in scratch. NULL for the other files.
+    Encas_FileRecord *records;
+    u64 num_records;
+    u8 *joined;
+    u8 *scratch;
+    u64 scratch_size;
 } Encas_File;
 
 #define IS_ENCAS_EOF(f) (f->cur >= f->size)
@@ -175,18 +232,46 @@ typedef struct Encas_HashTableArray {
     u32 cap;
 } Encas_HashTableArray;
 
+typedef enum {
+    ENCAS_MODE_GIVEN,
+    ENCAS_MODE_IGNORE,
+    ENCAS_MODE_OFF,
+    ENCAS_MODE_ASSIGN,
+    ENCAS_MODE_UNKNOWN,
+} Encas_Mode;
+
+// Axis aligned bounding box, empty when min > max
+typedef struct Encas_AABB {
+    float min[3];
+    float max[3];
+} Encas_AABB;
+
 typedef struct Encas_MeshInfoPart {
     s32 *elem_sizes;
     u32 *elem_offsets;
+    bool *elem_ghost; // g_ element block
     s32 len;
+    s32 num_ghost_elemtypes;
     u64 elem_vert_map_array_size;
+    u64 ghost_elem_vert_map_array_size;
     s32 num_of_coords;
+    u32 block_dims[3]; // Node dims of a structured part, 0 otherwise
 } Encas_MeshInfoPart;
 
 typedef struct Encas_MeshInfo {
     Encas_MeshInfoPart *parts;
     u32 len;
     Encas_HashTable *part_num_lookup;
+    Encas_Mode node_id_mode;
+    Encas_Mode element_id_mode;
+    bool has_extents;
+    Encas_AABB extents; // Only valid if has_extents
+
+    // Fingerprints of the file: part numbers, node ids, element blocks and connectivity (topology),
+    // and the x/y/z coordinates (coords). Equal fingerprints mean equal sections.
+    u64 topology_hash;
+    u64 coords_hash;
+    bool shares_parts; // parts and part_num_lookup belong to the previous time step with the same topology
 } Encas_MeshInfo;
 
 typedef struct Encas_MeshInfoArray {
@@ -216,8 +301,25 @@ typedef enum Encas_VariableType {
     ENCAS_VARIABLE_VECTOR_PER_NODE,
     ENCAS_VARIABLE_SCALAR_PER_ELEMENT,
     ENCAS_VARIABLE_VECTOR_PER_ELEMENT,
+    ENCAS_VARIABLE_TENSOR_SYMM_PER_NODE,     // 11 22 33 12 13 23
+    ENCAS_VARIABLE_TENSOR_ASYMM_PER_NODE,    // 11 12 13 21 22 23 31 32 33
+    ENCAS_VARIABLE_TENSOR_SYMM_PER_ELEMENT,
+    ENCAS_VARIABLE_TENSOR_ASYMM_PER_ELEMENT,
+    ENCAS_VARIABLE_COMPLEX_SCALAR_PER_NODE,  // Re_fn and Im_fn, see Encas_LoadComplexVariableData
+    ENCAS_VARIABLE_COMPLEX_VECTOR_PER_NODE,
+    ENCAS_VARIABLE_COMPLEX_SCALAR_PER_ELEMENT,
+    ENCAS_VARIABLE_COMPLEX_VECTOR_PER_ELEMENT,
+    ENCAS_VARIABLE_SCALAR_PER_MEASURED_NODE, // One value per particle, see Encas_LoadMeasuredVariable
+    ENCAS_VARIABLE_VECTOR_PER_MEASURED_NODE,
 } Encas_VariableType;
 
+// Storage of the real and imaginary parts of a complex variable part with count values
+// (count = number of nodes or cells times the number of components)
+typedef enum Encas_ComplexLayout {
+    ENCAS_COMPLEX_SPLIT,       // count real values, then count imaginary values
+    ENCAS_COMPLEX_INTERLEAVED, // real, imaginary pairs
+} Encas_ComplexLayout;
+
 // type of: [ts] [fs] description filename
 // e.g.: scalar per node, vector per element... etc.
 typedef struct Encas_DescFile {
@@ -225,7 +327,9 @@ typedef struct Encas_DescFile {
     s32 ts, fs; // OPTIONAL
     bool ts_set, fs_set;
     Encas_MutStr description;
-    Encas_MutStr filename;
+    Encas_MutStr filename;    // Re_fn of complex variables
+    Encas_MutStr im_filename; // Im_fn of complex variables
+    float frequency;          // complex variables only
 } Encas_DescFile;
 
 typedef struct Encas_VariableArray {
@@ -267,14 +371,6 @@ typedef struct Encas_Case {
     char                 dirname[PATH_MAX + 1];
 } Encas_Case;
 
-typedef enum {
-    ENCAS_MODE_GIVEN,
-    ENCAS_MODE_IGNORE,
-    ENCAS_MODE_OFF,
-    ENCAS_MODE_ASSIGN,
-    ENCAS_MODE_UNKNOWN,
-} Encas_Mode;
-
 typedef struct Encas_Vertex
 {
     float x, y, z;
@@ -287,23 +383,156 @@ typedef struct Encas_Vertices
     float *z;
 } Encas_Vertices;
 
+// Coordinate layouts, see Encas_GeometryOptions.vertex_layout
+typedef enum Encas_VertexLayout {
+    ENCAS_VERTEX_SOA,      // Separate x, y and z arrays (Encas_Vertices)
+    ENCAS_VERTEX_AOS_XYZ,  // Interleaved xyz, 12 bytes per vertex (Encas_Vertex)
+    ENCAS_VERTEX_AOS_XYZW, // Interleaved xyzw with w = 1, 16 bytes per vertex
+} Encas_VertexLayout;
+
+// Floats per vertex of an interleaved layout, 0 for SoA
+force_inline u32 Encas_VertexStride(Encas_VertexLayout layout) { return layout == ENCAS_VERTEX_AOS_XYZW ? 4 : layout == ENCAS_VERTEX_AOS_XYZ ? 3 : 0; }
+
+// Particles of a measured geometry file. Zero it before the first load, the arrays are
+// reused (and only grown) when the next time step is read into it.
+typedef struct Encas_Particles {
+    Encas_Vertices positions;
+    s32 *ids;
+    u64 len;
+    u64 cap;
+    bool swap; // Byte order of the measured files, the variable files have nothing to detect it from
+} Encas_Particles;
+
+// nsided/nfaced block in compressed sparse row form, node indices are 0 based.
+// nsided: cell c has the nodes conn[offsets[c] .. offsets[c + 1])
+// nfaced: cell c has the faces offsets[c] .. offsets[c + 1], face f has the nodes
+//         conn[face_offsets[f] .. face_offsets[f + 1])
+typedef struct Encas_PolyElem {
+    u32 *counts;       // Nodes (nsided) or faces (nfaced) of every cell
+    u64 *offsets;      // num_cells + 1
+
+    // nfaced only
+    u64 num_faces;
+    u32 *face_counts;  // Nodes of every face
+    u64 *face_offsets; // num_faces + 1
+
+    u32 *conn;
+    u64 conn_size;
+} Encas_PolyElem;
+
 typedef struct Encas_Elem
 {
     Encas_Elem_Type  type;
-    u8               elem_size; // Size of one elem
+    u8               elem_size; // Size of one elem, 0 for nsided/nfaced
     u32              elem_vert_map_size;    // num_of_elems * size_of_elem_type
     u32              elem_vert_map_entry;
+    u32              num_cells;
+    bool             is_ghost; // g_ block, elem_vert_map_entry points into ghost_elem_vert_map_array
+    Encas_PolyElem   *poly; // Connectivity of nsided/nfaced blocks, NULL otherwise
 } Encas_Elem;
 
+// id -> index lookup of the node or element ids of a part
+typedef struct Encas_IdIndex {
+    // Compact ids: index = dense[id - min_id]
+    s32 min_id;
+    u32 *dense;
+    u64 dense_size;
+
+    // Sparse ids: flat open addressing hash
+    s32 *keys;
+    u32 *values;
+    u32 cap;
+} Encas_IdIndex;
+
+#define ENCAS_INVALID_INDEX UINT32_MAX
+
+typedef enum Encas_BlockType {
+    ENCAS_BLOCK_CURVILINEAR,
+    ENCAS_BLOCK_RECTILINEAR,
+    ENCAS_BLOCK_UNIFORM,
+} Encas_BlockType;
+
+// Structured part. Nodes are numbered i fastest, node (i, j, k) is
+// i + dims[0] * (j + dims[1] * k), cells likewise over the cell dims.
+// The coordinates are stored in vert_array like any other part, the hexa8
+// (quad4/bar2 for flat blocks) connectivity is only built by Encas_ExpandBlockConnectivity.
+typedef struct Encas_Block {
+    Encas_BlockType type;
+    u32 dims[3];     // Nodes along i, j, k
+    bool iblanked;
+    bool with_ghost;
+
+    float origin[3]; // Uniform only
+    float delta[3];  // Uniform only
+    float *axis[3];  // Rectilinear only, dims[c] coordinates along axis c
+    s32 *iblank;     // One per node if iblanked, NULL otherwise
+} Encas_Block;
+
+// Unsigned index type of a connectivity, the narrowest one that can address the vertices
+typedef enum Encas_IndexType {
+    ENCAS_INDEX_U16,
+    ENCAS_INDEX_U32,
+    ENCAS_INDEX_U64,
+} Encas_IndexType;
+
+// Typed view of len indices, read them with Encas_IndexAt or cast data by type
+typedef struct Encas_IndexArray {
+    Encas_IndexType type;
+    void *data;
+    u64 len;
+} Encas_IndexArray;
+
+force_inline Encas_IndexType Encas_IndexTypeFor(u64 num_of_vertices) {
+    if (num_of_vertices <= (u64)UINT16_MAX + 1)
+        return ENCAS_INDEX_U16;
+    if (num_of_vertices <= (u64)UINT32_MAX)
+        return ENCAS_INDEX_U32;
+    return ENCAS_INDEX_U64;
+}
+
+force_inline u64 Encas_IndexSize(Encas_IndexType type) { return type == ENCAS_INDEX_U16 ? 2 : type == ENCAS_INDEX_U32 ? 4 : 8; }
+
+force_inline u64 Encas_IndexAt(const Encas_IndexArray *arr, u64 i) {
+    if (arr->type == ENCAS_INDEX_U16)
+        return ((const u16 *)arr->data)[i];
+    if (arr->type == ENCAS_INDEX_U32)
+        return ((const u32 *)arr->data)[i];
+    return ((const u64 *)arr->data)[i];
+}
+
 typedef struct Encas_Mesh
 {
     s32            part_number;
     Encas_Vertices vert_array;
     u64            vert_array_size;
+    float          *vertices;     // Interleaved copy of vert_array, NULL unless an AoS layout was asked
+    Encas_VertexLayout vertex_layout; // Layout of vertices
     Encas_Elem     *elem_array;
     u64            elem_array_size;
 
+    // NULL for blocks and for parts loaded with Encas_GeometryOptions.narrow_connectivity,
+    // until Encas_ExpandConnectivity
     u32            *elem_vert_map_array;
+
+    // Ghost (halo) element blocks, only kept with Encas_GeometryOptions.keep_ghosts.
+    // They share vert_array with the owned elements and are never part of the shell.
+    Encas_Elem     *ghost_elem_array;
+    u64            ghost_elem_array_size;
+    u32            *ghost_elem_vert_map_array;
+
+    s32            *node_ids; // Only with 'node id given', NULL otherwise
+    s32            *elem_ids; // Only with 'element id given', one per cell in element order (owned cells, then the kept ghosts), NULL otherwise
+
+    Encas_IdIndex  *node_id_index; // Built on first use by Encas_GetNodeIdIndex
+    Encas_IdIndex  *elem_id_index; // Built on first use by Encas_GetElementIdIndex
+    Encas_IndexArray connectivity; // Narrowest type for the part, see Encas_GetConnectivity
+    bool           narrow_connectivity; // connectivity is the u16 one of the slab, elem_vert_map_array is not read
+
+    Encas_AABB     bounds; // Computed while the coordinates are copied
+
+    Encas_Block    *block; // Structured part, NULL otherwise
+
+    bool           in_slab; // The mesh and its arrays live in the slab of its Encas_MeshArray, see Encas_DeleteMesh
 } Encas_Mesh;
 
 #define DEFAULT_MESHARRAY_CAP 16
@@ -311,14 +540,41 @@ typedef struct Encas_MeshArray {
     Encas_Mesh **elems;
     u32 len;
     u32 cap;
+
+    bool has_extents;
+    Encas_AABB extents; // Extents written in the geometry file, only valid if has_extents
+    Encas_AABB bounds;  // Union of the part bounds
+
+    u64 topology_hash; // Encas_MeshInfo.topology_hash of the file it was read from
+    u64 coords_hash;   // Encas_MeshInfo.coords_hash of the file it was read from
+
+    void *slab; // Single allocation holding the meshes read from a file, NULL otherwise
 } Encas_MeshArray;
 
+typedef struct Encas_GeometryOptions {
+    // Keep the g_ element blocks in Encas_Mesh.ghost_elem_array instead of dropping them
+    bool keep_ghosts;
+    // An AoS layout also interleaves the coordinates of every part into Encas_Mesh.vertices
+    // while they are read. vert_array is always filled, the rest of the library reads it.
+    Encas_VertexLayout vertex_layout;
+    // Parts of at most 65536 nodes only keep the u16 Encas_Mesh.connectivity, half the bytes.
+    // Their elem_vert_map_array stays NULL until Encas_ExpandConnectivity, the shell and the
+    // flat mesh read the u16 cells directly.
+    bool narrow_connectivity;
+} Encas_GeometryOptions;
+
+// What has to be reloaded when moving between two time steps of the model geometry
+typedef enum Encas_GeometryChange {
+    ENCAS_GEOMETRY_UNCHANGED,      // Same file content, the loaded mesh can be kept
+    ENCAS_GEOMETRY_COORDS_CHANGED, // Same parts and connectivity, only the coordinates differ
+    ENCAS_GEOMETRY_CHANGED,        // Different topology, the geometry has to be loaded again
+} Encas_GeometryChange;
+
 typedef struct Encas_FlatMesh {
     Encas_Vertex *vertices;
     u64 vertices_size;
 
-    u64 *elem_vert_map;
-    u64 elem_vert_map_size;
+    Encas_IndexArray elem_vert_map; // Narrowest index type for vertices_size
 
     u32 num_variables; // Number of variables
     float **data; // All variables converted to node values
@@ -335,8 +591,62 @@ typedef struct Encas_ShellParams {
     u32 *tria_global_idx;
 
     u32 global_ebo_size;
+    u64 orig_vertices_size; // Number of vertices of the mesh the shell was built from
+    u64 topology_hash;      // Encas_MeshArray.topology_hash of the mesh the shell was built from
+
+    // Per part gather plan: the vertices of part p are vbo[vbo_part_offsets[p] .. vbo_part_offsets[p + 1])
+    u32 *vbo_part_offsets;
+    u32 num_parts;
+
+    // Origin of every shell triangle: the triangles of part p are [ebo_part_offsets[p] .. ebo_part_offsets[p + 1])
+    // and tria_cell_idx is the index of their cell within the part, in element order
+    u32 *tria_cell_idx;
+    u32 *ebo_part_offsets;
+
+    // Welded vertex of every mesh vertex (orig_vertices_size entries), NULL without welding
+    u32 *weld_map;
+
+    // Cell to point averaging operator of the shell vertices (CSR, built on first use).
+    // Row i holds the global cell indices around vbo vertex i, c2p_weights[i] = 1 / row length
+    u32 *c2p_row_offsets;
+    u32 *c2p_cells;
+    float *c2p_weights;
+    u64 c2p_num_cells;
 } Encas_ShellParams;
 
+typedef enum Encas_ShellMode {
+    ENCAS_SHELL_MODE_TRIANGLES, // Every face is split into triangles before deduplication
+    ENCAS_SHELL_MODE_QUADS,     // Quad faces are deduplicated on their 4 vertices, only boundary quads are split
+} Encas_ShellMode;
+
+typedef enum Encas_WeldMode {
+    ENCAS_WELD_NONE,        // Every part keeps its own vertices
+    ENCAS_WELD_NODE_ID,     // Vertices with the same node id are merged (needs 'node id given')
+    ENCAS_WELD_POSITION,    // Vertices closer than weld_tolerance are merged
+} Encas_WeldMode;
+
+typedef struct Encas_ShellOptions {
+    Encas_ShellMode mode;
+
+    // Welding merges the duplicated vertices of part interfaces before the faces are
+    // matched, so the faces between two parts are not reported as boundary. In
+    // ENCAS_SHELL_MODE_TRIANGLES quads are split along the diagonal through their smallest
+    // welded vertex, so both sides of a face emit the same triangles.
+    Encas_WeldMode weld;
+    float weld_tolerance; // ENCAS_WELD_POSITION only, 0 merges bit-identical positions
+} Encas_ShellOptions;
+
+typedef enum Encas_ExportFormat {
+    ENCAS_EXPORT_OBJ,        // Wavefront OBJ (text)
+    ENCAS_EXPORT_PLY,        // Binary PLY
+    ENCAS_EXPORT_STL,        // Binary STL
+} Encas_ExportFormat;
+
+// Size of the write buffer of the exporters
+#ifndef ENCAS_EXPORT_BUFFER_SIZE
+#define ENCAS_EXPORT_BUFFER_SIZE (4 << 20)
+#endif
+
 //------------------------------------
 
 static inline u32 _encas_hash(s32 key) {
@@ -355,7 +665,7 @@ ENCAS_API bool Encas_SearchHashTable(Encas_HashTable* hashTable, s32 key, s32 *v
 ENCAS_API void Encas_DeleteFromHashTable(Encas_HashTable* hashTable, s32 key);
 ENCAS_API void Encas_DeleteHashTable(Encas_HashTable* hashTable);
 ENCAS_API Encas_File *Encas_SlurpFile(char *filename);
-ENCAS_API bool Encas_FileAdvace(Encas_File *f, u32 n);
+ENCAS_API bool Encas_FileAdvace(Encas_File *f, u64 n);
 ENCAS_API void Encas_FreeFile(Encas_File *file);
 ENCAS_API bool Encas_Copy_Str_To_MutStr(Encas_Str str, Encas_MutStr *mutstr);
 ENCAS_API Encas_Str Encas_ReadLine(Encas_File *f);
@@ -404,13 +714,41 @@ ENCAS_API Encas_MeshArray *Encas_CreateMeshArrayWithCap(u32 cap);
 ENCAS_API bool Encas_PushMeshArray(Encas_MeshArray *arr, Encas_Mesh *mesh);
 ENCAS_API void Encas_DeleteMeshArray(Encas_MeshArray *arr);
 ENCAS_API const char *Encas_ElemToCstr(Encas_Elem_Type elem);
+ENCAS_API bool Encas_BuildIdIndex(Encas_IdIndex *index, const s32 *ids, u64 count);
+ENCAS_API void Encas_DeleteIdIndex(Encas_IdIndex *index);
+ENCAS_API u32 Encas_LookupId(const Encas_IdIndex *index, s32 id);
+ENCAS_API u64 Encas_TranslateIds(const Encas_IdIndex *index, const s32 *ids, u64 count, u32 *indices);
+ENCAS_API const Encas_IdIndex *Encas_GetNodeIdIndex(Encas_Mesh *mesh);
+ENCAS_API const Encas_IdIndex *Encas_GetElementIdIndex(Encas_Mesh *mesh);
+ENCAS_API const Encas_IndexArray *Encas_GetConnectivity(Encas_Mesh *mesh);
+ENCAS_API u64 Encas_BlockNumNodes(const Encas_Block *block);
+ENCAS_API u64 Encas_BlockNumCells(const Encas_Block *block);
+ENCAS_API void Encas_BlockCellDims(const Encas_Block *block, u32 cell_dims[3]);
+ENCAS_API bool Encas_ExpandBlockConnectivity(Encas_Mesh *mesh);
+ENCAS_API bool Encas_ExpandConnectivity(Encas_Mesh *mesh);
+ENCAS_API void Encas_InterleaveVertices(const Encas_Vertices *src, u64 count, float *dst, Encas_VertexLayout layout);
 ENCAS_API Encas_MeshArray *Encas_ReadGeometry(Encas_MeshInfo *mesh_info, char *filename);
+ENCAS_API Encas_MeshArray *Encas_ReadGeometryEx(Encas_MeshInfo *mesh_info, char *filename, const Encas_GeometryOptions *options);
 ENCAS_API Encas_MeshArray *Encas_LoadGeometry(Encas_Case *encase, u32 time_value_idx);
+ENCAS_API Encas_MeshArray *Encas_LoadGeometryEx(Encas_Case *encase, u32 time_value_idx, const Encas_GeometryOptions *options);
+ENCAS_API Encas_GeometryChange Encas_GeometryStepChange(Encas_Case *encase, u32 from_time_value_idx, u32 to_time_value_idx);
+ENCAS_API bool Encas_ReadGeometryCoords(Encas_MeshInfo *mesh_info, char *filename, Encas_MeshArray *mesh);
+ENCAS_API bool Encas_UpdateGeometryCoords(Encas_Case *encase, Encas_MeshArray *mesh, u32 time_value_idx);
 ENCAS_API u32 Encas_GetCellTrianglesCount(Encas_Elem_Type cell_type);
 ENCAS_API void Encas_TriangulateTria3s(u32 *elem_vert_map_array, u32 num_cells, u32 *faces, u64 *faces_offset, u64 vert_offset);
 ENCAS_API void Encas_TriangulateTetra4s(u32 *elem_vert_map_array, u32 num_cells, u32 *faces, u64 *faces_offset, u64 vert_offset);
+ENCAS_API void Encas_TriangulateQuad4s(u32 *elem_vert_map_array, u32 num_cells, u32 *faces, u64 *faces_offset, u64 vert_offset);
+ENCAS_API void Encas_TriangulatePyramid5s(u32 *elem_vert_map_array, u32 num_cells, u32 *faces, u64 *faces_offset, u64 vert_offset);
+ENCAS_API void Encas_TriangulatePenta6s(u32 *elem_vert_map_array, u32 num_cells, u32 *faces, u64 *faces_offset, u64 vert_offset);
+ENCAS_API void Encas_TriangulateHexa8s(u32 *elem_vert_map_array, u32 num_cells, u32 *faces, u64 *faces_offset, u64 vert_offset);
+ENCAS_API void Encas_GetCellFacesCount(Encas_Elem_Type cell_type, u32 *num_trias, u32 *num_quads);
 //ENCAS_API void Encas_LoadGeometryShell(Encas_Case *encase, Encas_MeshArray *mesh, float **vbo_out, u32 *vbo_size, u32 **vbo_orig_idx_out, u32 **ebo_out, u32 *ebo_size);
 ENCAS_API void Encas_LoadGeometryShell(Encas_Case *encase, Encas_MeshArray *mesh, Encas_ShellParams *params);
+ENCAS_API void Encas_LoadGeometryShellEx(Encas_Case *encase, Encas_MeshArray *mesh, Encas_ShellParams *params, const Encas_ShellOptions *options);
+ENCAS_API void Encas_UpdateGeometryShellCoords(Encas_MeshArray *mesh, Encas_ShellParams *params);
+ENCAS_API void Encas_LoadGeometryShellCached(Encas_Case *encase, Encas_MeshArray *mesh, Encas_ShellParams *params, const Encas_ShellOptions *options);
+ENCAS_API void Encas_DeleteShellParams(Encas_ShellParams *params);
+ENCAS_API bool Encas_ExportShell(const Encas_ShellParams *params, const char *filename, Encas_ExportFormat format);
 ENCAS_API bool Encas_LoadVariableOnShell_Vertices(Encas_Case *encase, Encas_MeshArray *mesh, u32 variable_idx, u32 time_value_idx, Encas_ShellParams *params, float **var_vbo_out);
 ENCAS_API bool Encas_LoadVariableOnShell_Elements(Encas_Case *encase, Encas_MeshArray *mesh, u32 variable_idx, u32 time_value_idx, Encas_ShellParams *params, float **var_vbo_out);
 ENCAS_API void Encas_DeleteFloatArrParts(float **data, u32 num_of_parts);
@@ -420,6 +758,21 @@ ENCAS_API float **Encas_ReadVariableDataPerNode(Encas_Case *encase, Encas_MeshIn
 ENCAS_API float *Encas_ReadVariableDataPerNodePart(Encas_Case *encase, Encas_MeshInfo *mesh_info, char *filename, u32 part_idx, u32 num_of_data);
 ENCAS_API float *Encas_LoadVariableDataPart(Encas_Case *encase, u32 time_value_idx, u32 variable_idx, u32 part_idx);
 ENCAS_API float **Encas_LoadVariableData(Encas_Case *encase, u32 time_value_idx, u32 variable_idx);
+ENCAS_API float *Encas_LoadBlockVariable(Encas_Case *encase, u32 time_value_idx, u32 variable_idx, u32 part_idx, u32 dims[3]);
+ENCAS_API u32 Encas_VariableNumComponents(Encas_VariableType type);
+ENCAS_API bool Encas_VariableIsPerElement(Encas_VariableType type);
+ENCAS_API bool Encas_VariableIsComplex(Encas_VariableType type);
+ENCAS_API bool Encas_VariableIsMeasured(Encas_VariableType type);
+ENCAS_API bool Encas_ReadMeasuredGeometry(char *filename, Encas_Particles *particles);
+ENCAS_API bool Encas_LoadMeasuredGeometry(Encas_Case *encase, u32 time_value_idx, Encas_Particles *particles);
+ENCAS_API bool Encas_ReadMeasuredVariable(char *filename, const Encas_Particles *particles, u32 num_of_data, float *out);
+ENCAS_API bool Encas_LoadMeasuredVariable(Encas_Case *encase, u32 time_value_idx, u32 variable_idx, const Encas_Particles *particles, float *out);
+ENCAS_API void Encas_DeleteParticles(Encas_Particles *particles);
+ENCAS_API float **Encas_LoadComplexVariableData(Encas_Case *encase, u32 time_value_idx, u32 variable_idx, Encas_ComplexLayout layout);
+ENCAS_API void Encas_ComplexAtPhase(const float *data, u64 count, Encas_ComplexLayout layout, float phase, float *out);
+ENCAS_API void Encas_ComplexMagnitudePhase(const float *data, u64 count, Encas_ComplexLayout layout, float *magnitude, float *phase);
+ENCAS_API bool Encas_TensorVonMises(const float *tensor, u64 count, u32 num_of_data, float *out);
+ENCAS_API bool Encas_TensorPrincipal(const float *tensor, u64 count, u32 num_of_data, float *out);
 ENCAS_API void Encas_MeshArray_To_FlatMesh(Encas_Case *encas, Encas_MeshArray *mesh, Encas_FlatMesh *flat, u32 time_idx, u32 variable_idx);
 ENCAS_API void Encas_DeleteFlatMesh(Encas_FlatMesh *flat);
 ENCAS_API bool Encas_EqualFaceKey(const Encas_FaceKey *a, const Encas_FaceKey *b);
@@ -429,6 +782,12 @@ ENCAS_API void Encas_RehashFaceKeyMap(Encas_FaceKeyMap *map, u32 new_cap);
 ENCAS_API void Encas_SetFaceKeyMap(Encas_FaceKeyMap *map, Encas_FaceKey key, u8 value, u32 global_idx);
 ENCAS_API bool Encas_GetFaceKeyMap(Encas_FaceKeyMap *map, Encas_FaceKey key, u8 *out_value);
 ENCAS_API void Encas_RehashFaceKeyMap(Encas_FaceKeyMap *map, u32 new_cap);
+ENCAS_API bool Encas_EqualQuadKey(const Encas_QuadKey *a, const Encas_QuadKey *b);
+ENCAS_API void Encas_CreateQuadKeyMap(Encas_QuadKeyMap *map, u32 cap);
+ENCAS_API void Encas_DeleteQuadKeyMap(Encas_QuadKeyMap *map);
+ENCAS_API void Encas_RehashQuadKeyMap(Encas_QuadKeyMap *map, u32 new_cap);
+ENCAS_API void Encas_SetQuadKeyMap(Encas_QuadKeyMap *map, Encas_QuadKey key, u8 value, u32 global_idx);
+ENCAS_API bool Encas_GetQuadKeyMap(Encas_QuadKeyMap *map, Encas_QuadKey key, u8 *out_value);
 
 #ifdef ENCAS_IMPLEMENTATION
 ENCAS_API void Encas_Init(encas_log_callback *logger) {
@@ -451,17 +810,24 @@ ENCAS_API void Encas_Log(Encas_Log_Level level, const char *format, ...) {
 }
 
 ENCAS_API void Encas_DeleteMeshInfo(Encas_MeshInfo *info) {
+    if (info->shares_parts)
+        return;
+
     for (u32 i = 0; i < info->len; ++i) {
         ENCAS_FREE(info->parts[i].elem_sizes);
         ENCAS_FREE(info->parts[i].elem_offsets);
+        ENCAS_FREE(info->parts[i].elem_ghost);
     }
 
     ENCAS_FREE(info->parts);
+    Encas_DeleteHashTable(info->part_num_lookup);
 }
 
 ENCAS_API void Encas_CreateMeshInfoArray(Encas_MeshInfoArray *arr, u32 len) {
     arr->len = len;
     arr->elems = (Encas_MeshInfo *)ENCAS_MALLOC(len * sizeof(Encas_MeshInfo));
+    // Steps after a failing one are never parsed, they must still be safe to delete
+    memset(arr->elems, 0, len * sizeof(Encas_MeshInfo));
 }
 
 ENCAS_API void Encas_DeleteMeshInfoArray(Encas_MeshInfoArray *arr) {
@@ -648,13 +1014,25 @@ ENCAS_API Encas_File *Encas_SlurpFile(char *filename) {
 #endif
 
     file->cur = 0;
+    file->swap = false;
+    file->buffer_size = file->size;
+    file->records = NULL;
+    file->num_records = 0;
+    file->joined = NULL;
+    file->scratch = NULL;
+    file->scratch_size = 0;
+#ifdef __unix__
+    file->owned = false;
+#else
+    file->owned = true;
+#endif
 
     return file;
 }
 
-ENCAS_API bool Encas_FileAdvace(Encas_File *f, u32 n) {
+ENCAS_API bool Encas_FileAdvace(Encas_File *f, u64 n) {
     if (f->cur + n > f->size) {
-        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Cannot advance file by %d bytes!\n", n);
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Cannot advance file by %llu bytes!\n", (unsigned long long)n);
         return false;
     }
 
@@ -663,16 +1041,64 @@ ENCAS_API bool Encas_FileAdvace(Encas_File *f, u32 n) {
 }
 
 ENCAS_API void Encas_FreeFile(Encas_File *file) {
+    if (file->owned)
+        ENCAS_FREE(file->buffer);
 #ifdef __unix__
-    munmap(file->buffer, file->size);
-#endif
-#ifdef _WIN32
-    ENCAS_FREE(file->buffer);
+    else
+        munmap(file->buffer, file->buffer_size);
 #endif
 
+    ENCAS_FREE(file->records);
+    ENCAS_FREE(file->joined);
+    ENCAS_FREE(file->scratch);
     ENCAS_FREE(file);
 }
 
+// Record of f that holds the payload position pos, the last one of a run of empty records
+static u64 _encas_find_record(const Encas_File *f, u64 pos) {
+    u64 lo = 0, hi = f->num_records;
+    while (hi - lo > 1) {
+        u64 mid = lo + (hi - lo) / 2;
+        if (f->records[mid].pos <= pos)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Gathers n bytes at the payload position pos of a Fortran Binary file, in place if they are
+// in one record, otherwise copied to f->scratch. The caller checks pos + n <= f->size.
+static const u8 *_encas_gather_records(Encas_File *f, u64 pos, u64 n) {
+    u64 r = _encas_find_record(f, pos);
+    if (pos + n <= f->records[r + 1].pos)
+        return f->records[r].data + (pos - f->records[r].pos);
+
+    if (n > f->scratch_size) {
+        ENCAS_FREE(f->scratch);
+        f->scratch = (u8 *)ENCAS_MALLOC(n);
+        f->scratch_size = n;
+    }
+
+    for (u64 done = 0; done < n; ++r) {
+        u64 offset = pos + done - f->records[r].pos;
+        u64 len = f->records[r + 1].pos - f->records[r].pos - offset;
+        if (len > n - done)
+            len = n - done;
+        memcpy(f->scratch + done, f->records[r].data + offset, len);
+        done += len;
+    }
+    return f->scratch;
+}
+
+// The n bytes at position pos of f, valid until the next read of f. The caller checks
+// pos + n <= f->size.
+static inline const u8 *_encas_file_at(Encas_File *f, u64 pos, u64 n) {
+    if (!f->records)
+        return f->buffer + pos;
+    return _encas_gather_records(f, pos, n);
+}
+
 ENCAS_API bool Encas_Copy_Str_To_MutStr(Encas_Str str, Encas_MutStr *mutstr) {
     if (mutstr == NULL) {
         return false;
@@ -757,20 +1183,75 @@ ENCAS_API Encas_Str Encas_ReadBinaryLine(Encas_File *f) {
         return str;
     }
 
-    str.buffer = f->buffer + f->cur;
+    str.buffer = (u8 *)_encas_file_at(f, f->cur, 80);
     str.len = 80;
     f->cur += 80;
 
     return str;
 }
 
+static inline u32 _encas_bswap32(u32 v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_bswap32(v);
+#elif defined(_MSC_VER)
+    return _byteswap_ulong(v);
+#else
+    return (v >> 24) | ((v >> 8) & 0xFF00u) | ((v << 8) & 0xFF0000u) | (v << 24);
+#endif
+}
+
+#ifdef ENCAS_SSE2
+static inline __m128i _encas_bswap32_sse2(__m128i v) {
+    // Swap the bytes of every 16 bit half, then the halves
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+}
+#endif
+
+// 32 bit value from the (possibly unaligned) file buffer, in host byte order
+static inline u32 _encas_load_u32(const u8 *src, bool swap) {
+    u32 v;
+    memcpy(&v, src, sizeof(u32));
+    return swap ? _encas_bswap32(v) : v;
+}
+
+static inline float _encas_load_f32(const u8 *src, bool swap) {
+    u32 v = _encas_load_u32(src, swap);
+    float ret;
+    memcpy(&ret, &v, sizeof(float));
+    return ret;
+}
+
+// Copies n 32 bit values (floats or ints) from the file buffer. With swap the bytes are
+// swapped in the registers on the way, so foreign byte order costs no second pass.
+static void _encas_copy32(void *dst, const u8 *src, u64 n, bool swap) {
+    if (!swap) {
+        memcpy(dst, src, n * sizeof(u32));
+        return;
+    }
+
+    u8 *out = (u8 *)dst;
+    u64 i = 0;
+#ifdef ENCAS_SSE2
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i * sizeof(u32)));
+        _mm_storeu_si128((__m128i *)(out + i * sizeof(u32)), _encas_bswap32_sse2(v));
+    }
+#endif
+    for (; i < n; ++i) {
+        u32 v = _encas_load_u32(src + i * sizeof(u32), true);
+        memcpy(out + i * sizeof(u32), &v, sizeof(u32));
+    }
+}
+
 ENCAS_API s32 Encas_ReadS32(Encas_File *f) {
     if (f->cur + sizeof(s32) > f->size) {
         Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Cannot read S32!\n");
         return 0;
     }
 
-    s32 ret = *(s32*)(f->buffer + f->cur);
+    s32 ret = (s32)_encas_load_u32(_encas_file_at(f, f->cur, sizeof(s32)), f->swap);
     f->cur += sizeof(s32);
     return ret;
 }
@@ -884,74 +1365,96 @@ ENCAS_API u32 Encas_Str_to_U32(Encas_Str str) {
     return n;
 }
 
+// Powers of ten that are exact in a double
+static const double _encas_pow10[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// Correctly rounded, without going through pow(): up to 19 digits with a power of ten
+// that is exact in a double need a single rounding (Clinger's fast path). Rounding that
+// double to float again is only wrong if it lands exactly halfway between two floats,
+// those and everything else (long mantissas, huge exponents, subnormals, inf/nan) go to strtof.
 ENCAS_API float Encas_Str_to_F32(Encas_Str str) {
     if (!str.buffer || str.len == 0)
         return 0.0f;
 
-    double result = 0.0;
-    double fraction = 0.0;
-    int exponent = 0;
-    int sign = 1;
-    double frac_divisor = 1;
-    int i = 0;
-
-    if (i < str.len && (str.buffer[i] == '-' || str.buffer[i] == '+')) {
-        if (str.buffer[i] == '-') {
-            sign = -1;
-        }
+    const u8 *s = str.buffer;
+    u32 i = 0;
+    while (i < str.len && (s[i] == ' ' || s[i] == '\t'))
         i++;
-    }
 
-    while (i < str.len && isdigit((u8)str.buffer[i])) {
-        result = result * 10.0 + (str.buffer[i] - '0');
+    bool negative = false;
+    if (i < str.len && (s[i] == '-' || s[i] == '+')) {
+        negative = s[i] == '-';
         i++;
     }
 
-    if (i < str.len && str.buffer[i] == '.') {
-        i++;
-        while (i < str.len && isdigit(str.buffer[i])) {
-            fraction = fraction * 10.0 + (str.buffer[i] - '0');
-            frac_divisor *= 10.0;
-            i++;
+    u64 mantissa = 0;
+    u32 digits = 0;
+    s32 exponent = 0;
+    bool any_digit = false, exact = true;
+
+    for (; i < str.len && (u8)(s[i] - '0') < 10; ++i) {
+        any_digit = true;
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (s[i] - '0');
+            digits += mantissa != 0;
+        } else {
+            exponent++;
+            exact &= s[i] == '0';
         }
     }
 
-    result += fraction / frac_divisor;
-
-    if (i < str.len && (str.buffer[i] == 'e' || str.buffer[i] == 'E')) {
-        i++;
-        int exp_sign = 1;
-        int exp_value = 0;
-
-        if (i < str.len && (str.buffer[i] == '-' || str.buffer[i] == '+')) {
-            if (str.buffer[i] == '-') {
-                exp_sign = -1;
+    if (i < str.len && s[i] == '.') {
+        for (++i; i < str.len && (u8)(s[i] - '0') < 10; ++i) {
+            any_digit = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (s[i] - '0');
+                digits += mantissa != 0;
+                exponent--;
+            } else {
+                exact &= s[i] == '0';
             }
-            i++;
         }
+    }
 
-        while (i < str.len && isdigit((u8)str.buffer[i])) {
-            exp_value = exp_value * 10 + (str.buffer[i] - '0');
-            i++;
+    if (any_digit && i < str.len && (s[i] == 'e' || s[i] == 'E')) {
+        u32 j = i + 1;
+        bool exp_negative = false;
+        if (j < str.len && (s[j] == '-' || s[j] == '+')) {
+            exp_negative = s[j] == '-';
+            j++;
         }
 
-        exponent = exp_sign * exp_value;
-    }
+        s32 exp_value = 0;
+        for (; j < str.len && (u8)(s[j] - '0') < 10; ++j)
+            if (exp_value < 100000)
+                exp_value = exp_value * 10 + (s[j] - '0');
 
-#if 0
-    while (exponent > 0) {
-        result *= 10.0f;
-        exponent--;
+        exponent += exp_negative ? -exp_value : exp_value;
     }
 
-    while (exponent < 0) {
-        result /= 10.0f;
-        exponent++;
+    if (any_digit && exact) {
+        if (mantissa == 0)
+            return negative ? -0.0f : 0.0f;
+
+        if (mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+            double d = (double)mantissa;
+            d = exponent < 0 ? d / _encas_pow10[-exponent] : d * _encas_pow10[exponent];
+
+            u64 bits;
+            memcpy(&bits, &d, sizeof(bits));
+            if (d >= FLT_MIN && d <= FLT_MAX && (bits & 0x1FFFFFFFull) != 0x10000000ull)
+                return (float)(negative ? -d : d);
+        }
     }
-#endif
-    result *= pow(10.0f, exponent);
 
-    return (float)(sign * result);
+    char tmp[64];
+    u32 len = str.len < sizeof(tmp) - 1 ? str.len : (u32)sizeof(tmp) - 1;
+    memcpy(tmp, str.buffer, len);
+    tmp[len] = '\0';
+    return strtof(tmp, NULL);
 }
 
 ENCAS_API bool Encas_Str_IsNumber(Encas_Str str) {
@@ -1165,6 +1668,9 @@ ENCAS_API bool Encas_PushTimeArray(Encas_TimeArray *arr, Encas_Time *time) {
 }
 
 ENCAS_API void Encas_DeleteTimeArray(Encas_TimeArray *arr) {
+    if (arr == NULL)
+        return;
+
     for (u32 i = 0; i < arr->len; ++i)
         Encas_DeleteTime(arr->elems[i]);
 
@@ -1354,7 +1860,7 @@ static u32 _get_elem_vert_count(Encas_Elem_Type type) {
             return 8;
         case ENCAS_ELEM_HEXA20:
             return 20;
-        // TODO: implement
+        // Varies by cell, see Encas_PolyElem
         case ENCAS_ELEM_NSIDED:
         case ENCAS_ELEM_NFACED:
             return 0;
@@ -1363,263 +1869,1012 @@ static u32 _get_elem_vert_count(Encas_Elem_Type type) {
     }
 }
 
-ENCAS_API bool Encas_ParseMeshInfo(Encas_MeshInfo *info, char *filename) {
-    Encas_Log(ENCAS_LOG_LEVEL_INFO, "Loading %s geometry file\n", filename);
-    if (!check_if_file_exists(filename)) {
-        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Cannot open %s geometry file\n", filename);
-        return false;
+static inline u32 _encas_max_threads() {
+#ifdef _OPENMP
+    return (u32)omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+// Sum of n counts of the file buffer, used to skip nsided/nfaced blocks without storing them
+static u64 _encas_sum_s32(const u8 *counts, u64 n, bool swap) {
+    u64 sum = 0;
+    ENCAS_OMP(parallel for reduction(+:sum) if(n > ENCAS_PARALLEL_MIN))
+    for (u64 i = 0; i < n; ++i)
+        sum += _encas_load_u32(counts + i * sizeof(s32), swap);
+    return sum;
+}
+
+// Exclusive prefix sum of counts into offsets (n + 1 elements), returns the total.
+// Every thread sums a chunk, the chunk sums are scanned, then every thread writes
+// the offsets of its chunk starting from its scanned sum.
+static u64 _encas_prefix_sum_u32(const u32 *counts, u64 n, u64 *offsets) {
+    const u32 num_chunks = n > ENCAS_PARALLEL_MIN ? _encas_max_threads() : 1;
+    const u64 chunk_size = (n + num_chunks - 1) / num_chunks;
+    u64 *chunk_sums = (u64 *)ENCAS_MALLOC((num_chunks + 1) * sizeof(u64));
+
+    ENCAS_OMP(parallel for)
+    for (u32 chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+        u64 begin = chunk_idx * chunk_size;
+        u64 end = begin + chunk_size < n ? begin + chunk_size : n;
+        u64 sum = 0;
+        for (u64 i = begin; i < end; ++i)
+            sum += counts[i];
+        chunk_sums[chunk_idx] = sum;
+    }
+
+    u64 total = 0;
+    for (u32 chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+        u64 sum = chunk_sums[chunk_idx];
+        chunk_sums[chunk_idx] = total;
+        total += sum;
+    }
+
+    ENCAS_OMP(parallel for)
+    for (u32 chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+        u64 begin = chunk_idx * chunk_size;
+        u64 end = begin + chunk_size < n ? begin + chunk_size : n;
+        u64 sum = chunk_sums[chunk_idx];
+        for (u64 i = begin; i < end; ++i) {
+            offsets[i] = sum;
+            sum += counts[i];
+        }
     }
+    offsets[n] = total;
 
-    Encas_File *f = Encas_SlurpFile(filename);
-    Encas_Mode node_id, element_id;
+    ENCAS_FREE(chunk_sums);
+    return total;
+}
 
-    Encas_Str line = Encas_ReadBinaryLine(f);
+// Bytes of an element block after its element ids, f->cur must point there.
+// nsided/nfaced blocks start with their count arrays, their size depends on the counts.
+static u64 _encas_elem_block_size(Encas_File *f, Encas_Elem_Type type, s32 num_of_elements) {
+    if (type != ENCAS_ELEM_NSIDED && type != ENCAS_ELEM_NFACED)
+        return (u64)num_of_elements * _get_elem_vert_count(type) * sizeof(s32);
 
-    if (!Encas_Str_StartsWith(line, Encas_Str_Lit("C Binary"))) {
-        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' is not in C Binary form!\n", filename);
-        Encas_FreeFile(f);
-        return false;
-    }
+    // Truncated files: return a size past the end, Encas_FileAdvace reports it
+    u64 size = (u64)num_of_elements * sizeof(s32);
+    if (f->cur + size > f->size)
+        return size;
 
-    // Skip the two description line
-    if (!Encas_FileAdvace(f, 160)) {
-        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file is not contains description!\n", filename);
-        Encas_FreeFile(f);
-        return false;
-    }
+    u64 num_entries = _encas_sum_s32(_encas_file_at(f, f->cur, size), num_of_elements, f->swap);
+    if (type == ENCAS_ELEM_NFACED) {
+        // num_entries is the number of faces, then the nodes of every face follow
+        if (f->cur + size + num_entries * sizeof(s32) > f->size)
+            return size + num_entries * sizeof(s32);
 
-    line = Encas_ReadBinaryLine(f);
-    // node id
-    if (!Encas_Str_StartsWith(line, Encas_Str_Lit("node id "))) {
-        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file is not contains node id!\n", filename);
-        Encas_FreeFile(f);
-        return false;
+        u64 num_faces = num_entries;
+        num_entries = _encas_sum_s32(_encas_file_at(f, f->cur + size, num_faces * sizeof(s32)), num_faces, f->swap);
+        size += num_faces * sizeof(s32);
     }
 
-    // Substring in a hacky way :)
-    line.buffer += 8;
-    line.len -= 8;
+    return size + num_entries * sizeof(s32);
+}
 
-    if ((node_id = _get_mode(line)) == ENCAS_MODE_UNKNOWN) {
-        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: Unkown mode found! (not in: <off/given/assign/ignore>) at node id\n", filename);
-        Encas_FreeFile(f);
-        return false;
+static void _encas_delete_poly_elem(Encas_PolyElem *poly) {
+    ENCAS_FREE(poly->counts);
+    ENCAS_FREE(poly->offsets);
+    ENCAS_FREE(poly->face_counts);
+    ENCAS_FREE(poly->face_offsets);
+    ENCAS_FREE(poly->conn);
+    ENCAS_FREE(poly);
+}
+
+static void _encas_delete_block(Encas_Block *block) {
+    for (u32 c = 0; c < 3; ++c)
+        ENCAS_FREE(block->axis[c]);
+    ENCAS_FREE(block->iblank);
+    ENCAS_FREE(block);
+}
+
+// 1 based -> 0 based copy of n node indices from the (possibly unaligned) file buffer.
+// Returns false if an index is outside of [0, num_nodes), 0 and negative file indices included.
+static bool _encas_decode_conn_range(u32 *dst, const u8 *src, u64 n, u32 num_nodes, bool swap) {
+    u64 i = 0;
+    bool valid = true;
+
+#ifdef ENCAS_SSE2
+    // No unsigned compare in SSE2: flip the sign bits and compare signed
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i sign = _mm_set1_epi32((int)0x80000000u);
+    const __m128i limit = _mm_xor_si128(_mm_set1_epi32((int)num_nodes), sign);
+    __m128i in_range = _mm_set1_epi32(-1);
+    for (; i + 8 <= n; i += 8) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *)(src + i * sizeof(u32)));
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(src + (i + 4) * sizeof(u32)));
+        if (swap) {
+            v0 = _encas_bswap32_sse2(v0);
+            v1 = _encas_bswap32_sse2(v1);
+        }
+        v0 = _mm_sub_epi32(v0, one);
+        v1 = _mm_sub_epi32(v1, one);
+        _mm_storeu_si128((__m128i *)(dst + i), v0);
+        _mm_storeu_si128((__m128i *)(dst + i + 4), v1);
+        in_range = _mm_and_si128(in_range, _mm_cmplt_epi32(_mm_xor_si128(v0, sign), limit));
+        in_range = _mm_and_si128(in_range, _mm_cmplt_epi32(_mm_xor_si128(v1, sign), limit));
+    }
+    valid = _mm_movemask_epi8(in_range) == 0xFFFF;
+#endif
+
+    for (; i < n; ++i) {
+        dst[i] = _encas_load_u32(src + i * sizeof(u32), swap) - 1;
+        valid &= dst[i] < num_nodes;
     }
 
-    // element id
-    line = Encas_ReadBinaryLine(f);
-    if (!Encas_Str_StartsWith(line, Encas_Str_Lit("element id "))) {
-        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file is not contains element id!\n", filename);
-        Encas_FreeFile(f);
-        return false;
+    return valid;
+}
+
+// Decodes n node indices into dst and validates them in the same pass.
+// Returns the position of the first index outside of [0, num_nodes), n if they are all valid.
+static u64 _encas_decode_conn(u32 *dst, const u8 *src, u64 n, u32 num_nodes, bool swap) {
+    const s64 chunk = ENCAS_PARALLEL_MIN;
+    const s64 num_chunks = ((s64)n + chunk - 1) / chunk;
+    bool valid = true;
+
+    ENCAS_OMP(parallel for reduction(&&:valid) if(num_chunks > 1))
+    for (s64 k = 0; k < num_chunks; ++k) {
+        u64 begin = (u64)(k * chunk);
+        u64 count = n - begin < (u64)chunk ? n - begin : (u64)chunk;
+        valid = _encas_decode_conn_range(dst + begin, src + begin * sizeof(u32), count, num_nodes, swap) && valid;
     }
 
-    // Substring in a hacky way :)
-    line.buffer += 11;
-    line.len -= 11;
+    if (valid)
+        return n;
 
-    if ((element_id = _get_mode(line)) == ENCAS_MODE_UNKNOWN) {
-        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: Unkown mode found! (not in: <off/given/assign/ignore>) at element id\n", filename);
-        Encas_FreeFile(f);
-        return false;
+    // Rare: find the first bad one in the already decoded indices
+    u64 i = 0;
+    while (i < n && dst[i] < num_nodes)
+        ++i;
+    return i;
+}
+
+// Last row r < num_rows with offsets[r] <= x, the row of CSR entry x
+static u64 _encas_find_row(const u64 *offsets, u64 num_rows, u64 x) {
+    u64 lo = 0, hi = num_rows;
+    while (hi - lo > 1) {
+        u64 mid = lo + (hi - lo) / 2;
+        if (offsets[mid] <= x)
+            lo = mid;
+        else
+            hi = mid;
     }
+    return lo;
+}
 
-    // extents?
-    line = Encas_ReadBinaryLine(f);
-    if (Encas_Str_StartsWith(line, Encas_Str_Lit("extents"))) {
-        // Skips extents for now
-        // maybe implement later
-        Encas_FileAdvace(f, 6 * sizeof(float));
-        line = Encas_ReadBinaryLine(f);
+// Reads an nsided/nfaced block after its element ids into CSR form, does not advance the file.
+// Returns NULL if the file is truncated or a cell references a node outside of [1, num_nodes].
+static Encas_PolyElem *_encas_read_poly_elem(Encas_File *f, const char *filename, Encas_Elem_Type type, u32 num_cells, u32 num_nodes) {
+    const char *type_name = type == ENCAS_ELEM_NSIDED ? "nsided" : "nfaced";
+    u64 pos = f->cur;
+    if (f->size - pos < (u64)num_cells * sizeof(u32)) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: %s block is truncated!\n", filename, type_name);
+        return NULL;
     }
 
-    u64 before_parts = f->cur;
-    Encas_Str before_parts_line = { .buffer = line.buffer, .len = line.len }; 
-    u64 num_of_parts = 0;
+    Encas_PolyElem *poly = (Encas_PolyElem *)ENCAS_MALLOC(sizeof(Encas_PolyElem));
+    memset(poly, 0, sizeof(Encas_PolyElem));
 
-    // Count how many parts are in the file
-    while (Encas_Str_StartsWith(line, Encas_Str_Lit("part"))) {
-        num_of_parts++;
-        Encas_ReadS32(f);
-        Encas_FileAdvace(f, 80);
+    poly->counts = (u32 *)ENCAS_MALLOC(num_cells * sizeof(u32));
+    poly->offsets = (u64 *)ENCAS_MALLOC(((u64)num_cells + 1) * sizeof(u64));
+    _encas_copy32(poly->counts, _encas_file_at(f, pos, num_cells * sizeof(u32)), num_cells, f->swap);
+    u64 num_entries = _encas_prefix_sum_u32(poly->counts, num_cells, poly->offsets);
+    pos += num_cells * sizeof(u32);
 
-        while (!IS_ENCAS_EOF(f)) {
-            line = Encas_ReadBinaryLine(f);
-            bool is_ghost = false;
-            Encas_Elem_Type elem_type;
+    if (type == ENCAS_ELEM_NFACED) {
+        if (f->size - pos < num_entries * sizeof(u32)) {
+            Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: %s block is truncated!\n", filename, type_name);
+            _encas_delete_poly_elem(poly);
+            return NULL;
+        }
 
-            if (Encas_Str_StartsWith(line, Encas_Str_Lit("coordinates"))) {
-                s32 num_of_nodes = Encas_ReadS32(f);
+        poly->num_faces = num_entries;
+        poly->face_counts = (u32 *)ENCAS_MALLOC(poly->num_faces * sizeof(u32));
+        poly->face_offsets = (u64 *)ENCAS_MALLOC((poly->num_faces + 1) * sizeof(u64));
+        _encas_copy32(poly->face_counts, _encas_file_at(f, pos, poly->num_faces * sizeof(u32)), poly->num_faces, f->swap);
+        num_entries = _encas_prefix_sum_u32(poly->face_counts, poly->num_faces, poly->face_offsets);
+        pos += poly->num_faces * sizeof(u32);
+    }
 
-                // Skip node ids
-                if (node_id == ENCAS_MODE_GIVEN || node_id == ENCAS_MODE_IGNORE)
-                    Encas_FileAdvace(f, num_of_nodes * sizeof(s32));
+    if (f->size - pos < num_entries * sizeof(u32)) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: %s block is truncated!\n", filename, type_name);
+        _encas_delete_poly_elem(poly);
+        return NULL;
+    }
 
-                Encas_FileAdvace(f, 3 * num_of_nodes * sizeof(float));
+    poly->conn_size = num_entries;
+    poly->conn = (u32 *)ENCAS_MALLOC(num_entries * sizeof(u32));
+    u64 bad = _encas_decode_conn(poly->conn, _encas_file_at(f, pos, num_entries * sizeof(u32)), num_entries, num_nodes, f->swap);
+    if (bad < num_entries) {
+        u64 row = type == ENCAS_ELEM_NFACED ? _encas_find_row(poly->face_offsets, poly->num_faces, bad) : bad;
+        u64 cell = _encas_find_row(poly->offsets, num_cells, row);
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: %s element %llu references node %d, the part has %u nodes!\n",
+                  filename, type_name, (unsigned long long)cell + 1, (s32)(poly->conn[bad] + 1), num_nodes);
+        _encas_delete_poly_elem(poly);
+        return NULL;
+    }
 
-            }
+    return poly;
+}
 
-            else if (Encas_Str_StartsWith(line, Encas_Str_Lit("block"))) {
-                Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Structured data is not implemented yet! (block keyword)\n");
-                Encas_FreeFile(f);
-                return false;
-            }
+// Bytes of the block a poly elem was read from, after the element ids
+static inline u64 _encas_poly_block_size(const Encas_PolyElem *poly, u32 num_cells) {
+    return ((u64)num_cells + poly->num_faces + poly->conn_size) * sizeof(s32);
+}
 
-            // Element type
-            else if ((elem_type = Encas_ReadElemType(line, &is_ghost)) != ENCAS_ELEM_UNKNOWN) {
-                s32 num_of_elements = Encas_ReadS32(f);
+// Node range of cell c of a poly block, the nodes of an nfaced cell repeat on its faces
+static inline void _encas_poly_cell_nodes(const Encas_PolyElem *poly, Encas_Elem_Type type, u64 c, u64 *begin, u64 *end) {
+    if (type == ENCAS_ELEM_NFACED) {
+        *begin = poly->face_offsets[poly->offsets[c]];
+        *end = poly->face_offsets[poly->offsets[c + 1]];
+    } else {
+        *begin = poly->offsets[c];
+        *end = poly->offsets[c + 1];
+    }
+}
 
-                // Skip element ids
-                if (element_id == ENCAS_MODE_GIVEN || element_id == ENCAS_MODE_IGNORE)
-                    Encas_FileAdvace(f, num_of_elements * sizeof(s32));
+static inline void _encas_empty_aabb(Encas_AABB *box) {
+    for (u32 c = 0; c < 3; ++c) {
+        box->min[c] = FLT_MAX;
+        box->max[c] = -FLT_MAX;
+    }
+}
 
-                u32 elem_vert_count = _get_elem_vert_count(elem_type);
-                Encas_FileAdvace(f, num_of_elements * elem_vert_count * sizeof(s32));
-            }
+static inline void _encas_merge_aabb(Encas_AABB *dst, const Encas_AABB *src) {
+    for (u32 c = 0; c < 3; ++c) {
+        dst->min[c] = src->min[c] < dst->min[c] ? src->min[c] : dst->min[c];
+        dst->max[c] = src->max[c] > dst->max[c] ? src->max[c] : dst->max[c];
+    }
+}
 
-            else {
-                break;
-            }
+// Reads the 6 floats after 'extents': xmin xmax ymin ymax zmin zmax
+static void _encas_read_extents(Encas_File *f, Encas_AABB *box) {
+    float e[6];
+    _encas_copy32(e, _encas_file_at(f, f->cur, sizeof(e)), 6, f->swap);
+    for (u32 c = 0; c < 3; ++c) {
+        box->min[c] = e[2 * c];
+        box->max[c] = e[2 * c + 1];
+    }
+    Encas_FileAdvace(f, sizeof(e));
+}
+
+// Copies n floats from the (possibly unaligned) file buffer and returns their min/max,
+// so the bounds come for free while the coordinates are in the registers anyway.
+// NaNs are ignored.
+static void _encas_copy_minmax(float *dst, const u8 *src, u64 n, bool swap, float *min_out, float *max_out) {
+    float lo = FLT_MAX, hi = -FLT_MAX;
+    u64 i = 0;
+
+#ifdef ENCAS_SSE2
+    __m128 lo0 = _mm_set1_ps(FLT_MAX), lo1 = lo0;
+    __m128 hi0 = _mm_set1_ps(-FLT_MAX), hi1 = hi0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i r0 = _mm_loadu_si128((const __m128i *)(src + i * sizeof(float)));
+        __m128i r1 = _mm_loadu_si128((const __m128i *)(src + (i + 4) * sizeof(float)));
+        if (swap) {
+            r0 = _encas_bswap32_sse2(r0);
+            r1 = _encas_bswap32_sse2(r1);
         }
+        __m128 v0 = _mm_castsi128_ps(r0);
+        __m128 v1 = _mm_castsi128_ps(r1);
+        _mm_storeu_ps(dst + i, v0);
+        _mm_storeu_ps(dst + i + 4, v1);
+        // min/max return the second operand on NaN
+        lo0 = _mm_min_ps(v0, lo0);
+        lo1 = _mm_min_ps(v1, lo1);
+        hi0 = _mm_max_ps(v0, hi0);
+        hi1 = _mm_max_ps(v1, hi1);
+    }
+
+    float lanes_lo[4], lanes_hi[4];
+    _mm_storeu_ps(lanes_lo, _mm_min_ps(lo0, lo1));
+    _mm_storeu_ps(lanes_hi, _mm_max_ps(hi0, hi1));
+    for (u32 l = 0; l < 4; ++l) {
+        lo = lanes_lo[l] < lo ? lanes_lo[l] : lo;
+        hi = lanes_hi[l] > hi ? lanes_hi[l] : hi;
     }
+#endif
 
-    if (!num_of_parts) {
-        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "there are no parts in '%s' file!", filename);
-        Encas_FreeFile(f);
-        return false;
+    for (; i < n; ++i) {
+        float v = _encas_load_f32(src + i * sizeof(float), swap);
+        dst[i] = v;
+        lo = v < lo ? v : lo;
+        hi = v > hi ? v : hi;
     }
 
-    f->cur = before_parts;
+    *min_out = lo;
+    *max_out = hi;
+}
 
-    line.buffer = before_parts_line.buffer;
-    line.len = before_parts_line.len;
+static bool _encas_str_contains(Encas_Str str, const char *word) {
+    u32 word_len = (u32)strlen(word);
+    for (u32 i = 0; i + word_len <= str.len; ++i)
+        if (memcmp(str.buffer + i, word, word_len) == 0)
+            return true;
+    return false;
+}
 
-    info->parts = (Encas_MeshInfoPart *)ENCAS_MALLOC(num_of_parts * sizeof(Encas_MeshInfoPart));
-    info->len = num_of_parts;
-    info->part_num_lookup = Encas_CreateHashTable();
-
-    u32 part_idx = 0;
-    // Parts
-    while (Encas_Str_StartsWith(line, Encas_Str_Lit("part"))) {
-        s32 part_number = Encas_ReadS32(f);
+// Parses the options of a 'block' line and the dims that follow it:
+// block [curvilinear|rectilinear|uniform] [iblanked] [with_ghost] [range]
+static bool _encas_read_block_header(Encas_File *f, Encas_Str line, Encas_Block *block) {
+    memset(block, 0, sizeof(Encas_Block));
 
-        // Skip description line
-        Encas_FileAdvace(f, 80);
+    block->type = ENCAS_BLOCK_CURVILINEAR;
+    if (_encas_str_contains(line, "rectilinear"))
+        block->type = ENCAS_BLOCK_RECTILINEAR;
+    else if (_encas_str_contains(line, "uniform"))
+        block->type = ENCAS_BLOCK_UNIFORM;
 
-        u64 begin = f->cur;
-        u32 num_of_elemtypes = 0;
+    block->iblanked = _encas_str_contains(line, "iblanked");
+    block->with_ghost = _encas_str_contains(line, "with_ghost");
 
-        // First only count the size of the memory to be allocated
-        while (!IS_ENCAS_EOF(f)) {
-            line = Encas_ReadBinaryLine(f);
-            bool is_ghost = false;
-            Encas_Elem_Type elem_type;
+    if (_encas_str_contains(line, "range")) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "block range is not supported!\n");
+        return false;
+    }
 
-            if (Encas_Str_StartsWith(line, Encas_Str_Lit("coordinates"))) {
-                s32 num_of_nodes = Encas_ReadS32(f);
+    if (f->cur + 3 * sizeof(s32) > f->size) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Cannot read block dimensions!\n");
+        return false;
+    }
 
-                // Skip node ids
-                if (node_id == ENCAS_MODE_GIVEN || node_id == ENCAS_MODE_IGNORE)
-                    Encas_FileAdvace(f, num_of_nodes * sizeof(s32));
+    for (u32 c = 0; c < 3; ++c) {
+        s32 dim = Encas_ReadS32(f);
+        if (dim < 1) {
+            Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Invalid block dimensions!\n");
+            return false;
+        }
+        block->dims[c] = (u32)dim;
+    }
 
-                Encas_FileAdvace(f, 3 * num_of_nodes * sizeof(float));
+    return true;
+}
 
-            }
+// Bytes of a block part after its dims: coordinates, iblanks, ghost flags and ids
+static u64 _encas_block_data_size(const Encas_Block *block, Encas_Mode node_id, Encas_Mode element_id) {
+    const u64 num_nodes = Encas_BlockNumNodes(block);
+    const u64 num_cells = Encas_BlockNumCells(block);
 
-            // Element type
-            else if ((elem_type = Encas_ReadElemType(line, &is_ghost)) != ENCAS_ELEM_UNKNOWN) {
-                s32 num_of_elements = Encas_ReadS32(f);
+    u64 size = 0;
+    switch (block->type) {
+        case ENCAS_BLOCK_CURVILINEAR:
+            size += 3 * num_nodes * sizeof(float);
+            break;
+        case ENCAS_BLOCK_RECTILINEAR:
+            size += ((u64)block->dims[0] + block->dims[1] + block->dims[2]) * sizeof(float);
+            break;
+        case ENCAS_BLOCK_UNIFORM:
+            size += 6 * sizeof(float);
+            break;
+    }
 
-                // Skip element ids
-                if (element_id == ENCAS_MODE_GIVEN || element_id == ENCAS_MODE_IGNORE)
-                    Encas_FileAdvace(f, num_of_elements * sizeof(s32));
+    if (block->iblanked)
+        size += num_nodes * sizeof(s32);
+    if (block->with_ghost)
+        size += 80 + num_cells * sizeof(s32);
+    if (node_id == ENCAS_MODE_GIVEN || node_id == ENCAS_MODE_IGNORE)
+        size += 80 + num_nodes * sizeof(s32);
+    if (element_id == ENCAS_MODE_GIVEN || element_id == ENCAS_MODE_IGNORE)
+        size += 80 + num_cells * sizeof(s32);
 
+    return size;
+}
 
-                num_of_elemtypes++;
-                u32 elem_vert_count = _get_elem_vert_count(elem_type);
-                Encas_FileAdvace(f, num_of_elements * elem_vert_count * sizeof(s32));
-            }
+// Skips a block part of the geometry file, f->cur must be after the 'block' line
+static bool _encas_skip_block(Encas_File *f, Encas_Str line, Encas_Mode node_id, Encas_Mode element_id, Encas_Block *block) {
+    if (!_encas_read_block_header(f, line, block))
+        return false;
+    return Encas_FileAdvace(f, _encas_block_data_size(block, node_id, element_id));
+}
 
-            else {
-                break;
-            }
-        }
+// EnSight numbers the parts from 1, a number outside of this range is read in the wrong byte order
+static inline bool _encas_is_part_number(u32 v) {
+    return v >= 1 && v <= 0xFFFFFF;
+}
 
-        f->cur = begin;
+// Whether the first part at pos reads right in the byte order swap: its number has to be a part
+// number and the count after it has to fit in the rest of the file. In a geometry file that is the
+// node count of 'coordinates', the dims of a 'block' or the count of the first element type. A
+// variable file (mesh_info given) has to name a part of mesh_info, with room for its nodes.
+static bool _encas_first_part_fits(Encas_File *f, u64 pos, bool swap, const Encas_MeshInfo *mesh_info) {
+    u32 part_number = _encas_load_u32(_encas_file_at(f, pos + 80, sizeof(u32)), swap);
+    if (!_encas_is_part_number(part_number))
+        return false;
 
-        info->parts[part_idx].len = num_of_elemtypes;
-        info->parts[part_idx].elem_sizes = (s32 *)ENCAS_MALLOC(num_of_elemtypes * sizeof(s32));
-        info->parts[part_idx].elem_offsets = (u32 *)ENCAS_MALLOC(num_of_elemtypes * sizeof(u32));
-        if (info->parts[part_idx].elem_sizes == NULL) {
-            Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Couldn't allocate memory!");
-            Encas_FreeFile(f);
+    // 'part', the number and the line after it: the type line of a variable file or the
+    // description of a geometry file
+    u64 at = pos + 80 + sizeof(u32);
+    if (mesh_info) {
+        s32 part_idx;
+        if (!mesh_info->part_num_lookup || !Encas_SearchHashTable(mesh_info->part_num_lookup, (s32)part_number, &part_idx))
             return false;
+        if (at + 80 > f->size || memcmp(_encas_file_at(f, at, 80), "coordinates", 11) != 0)
+            return true;
+        return (u64)mesh_info->parts[part_idx].num_of_coords * sizeof(float) <= f->size - (at + 80);
+    }
+
+    at += 80;
+    if (at + 80 + 3 * sizeof(s32) > f->size)
+        return true;
+
+    Encas_Str line;
+    line.buffer = (u8 *)_encas_file_at(f, at, 80);
+    line.len = 80;
+    at += 80;
+    const u64 rest = f->size - at;
+
+    if (Encas_Str_StartsWith(line, Encas_Str_Lit("coordinates"))) {
+        s32 num_of_coords = (s32)_encas_load_u32(_encas_file_at(f, at, sizeof(s32)), swap);
+        return num_of_coords >= 0 && (u64)num_of_coords * 3 * sizeof(float) <= rest - sizeof(s32);
+    }
+
+    if (Encas_Str_StartsWith(line, Encas_Str_Lit("block"))) {
+        Encas_Block block;
+        memset(&block, 0, sizeof(Encas_Block));
+        block.type = ENCAS_BLOCK_CURVILINEAR;
+        if (_encas_str_contains(line, "rectilinear"))
+            block.type = ENCAS_BLOCK_RECTILINEAR;
+        else if (_encas_str_contains(line, "uniform"))
+            block.type = ENCAS_BLOCK_UNIFORM;
+        block.iblanked = _encas_str_contains(line, "iblanked");
+        block.with_ghost = _encas_str_contains(line, "with_ghost");
+
+        for (u32 c = 0; c < 3; ++c) {
+            s32 dim = (s32)_encas_load_u32(_encas_file_at(f, at + c * sizeof(s32), sizeof(s32)), swap);
+            if (dim < 1)
+                return false;
+            block.dims[c] = (u32)dim;
         }
-        info->parts[part_idx].elem_vert_map_array_size = 0;
+        return _encas_block_data_size(&block, ENCAS_MODE_OFF, ENCAS_MODE_OFF) <= rest - 3 * sizeof(s32);
+    }
 
-        // Then store the data
+    bool is_ghost;
+    if (Encas_ReadElemType(line, &is_ghost) != ENCAS_ELEM_UNKNOWN) {
+        s32 num_of_elems = (s32)_encas_load_u32(_encas_file_at(f, at, sizeof(s32)), swap);
+        return num_of_elems >= 0 && (u64)num_of_elems * sizeof(s32) <= rest - sizeof(s32);
+    }
 
-        u32 elem_idx = 0;
+    return true;
+}
 
-        while (!IS_ENCAS_EOF(f)) {
-            line = Encas_ReadBinaryLine(f);
-            bool is_ghost = false;
-            Encas_Elem_Type elem_type;
+// Sets f->swap from the first part. f->cur must point at the optional 'extents' line or at the
+// first 'part' line, the cursor is not moved. The byte order whose part number and counts fit the
+// file wins, a part number like 256 reads as a part number in both orders. mesh_info is given for
+// variable files and NULL for geometry files.
+static void _encas_detect_byte_order(Encas_File *f, const Encas_MeshInfo *mesh_info) {
+    u64 pos = f->cur;
+    if (pos + 80 <= f->size && memcmp(_encas_file_at(f, pos, 80), "extents", 7) == 0)
+        pos += 80 + 6 * sizeof(float);
+    if (pos + 80 + sizeof(u32) > f->size || memcmp(_encas_file_at(f, pos, 80), "part", 4) != 0)
+        return;
 
-            if (Encas_Str_StartsWith(line, Encas_Str_Lit("coordinates"))) {
-                s32 num_of_nodes = Encas_ReadS32(f);
+    const bool native = _encas_first_part_fits(f, pos, false, mesh_info);
+    const bool swapped = _encas_first_part_fits(f, pos, true, mesh_info);
+    if (native != swapped) {
+        f->swap = swapped;
+        return;
+    }
 
-                // Skip node ids
-                if (node_id == ENCAS_MODE_GIVEN || node_id == ENCAS_MODE_IGNORE)
-                    Encas_FileAdvace(f, num_of_nodes * sizeof(s32));
+    u32 part_number = _encas_load_u32(_encas_file_at(f, pos + 80, sizeof(u32)), false);
+    f->swap = !_encas_is_part_number(part_number) && _encas_is_part_number(_encas_bswap32(part_number));
+}
 
-                info->parts[part_idx].num_of_coords = num_of_nodes;
-                Encas_FileAdvace(f, 3 * num_of_nodes * sizeof(float));
+// ASCII Gold files are rewritten into the C Binary layout in memory, so every reader below
+// only has to know the binary one. Text lines become 80 byte lines, numbers become s32 or
+// float. The numbers of a run of numeric lines are parsed in parallel over line ranges.
+
+typedef struct Encas_ByteBuffer {
+    u8 *data;
+    u64 len;
+    u64 cap;
+} Encas_ByteBuffer;
+
+static u8 *_encas_bytes_reserve(Encas_ByteBuffer *b, u64 n) {
+    if (b->len + n > b->cap) {
+        u64 cap = b->cap ? b->cap : 4096;
+        while (cap < b->len + n)
+            cap *= 2;
+        b->data = (u8 *)ENCAS_REALLOC(b->data, cap);
+        b->cap = cap;
+    }
+    return b->data + b->len;
+}
+
+static void _encas_bytes_line(Encas_ByteBuffer *b, const u8 line[80]) {
+    memcpy(_encas_bytes_reserve(b, 80), line, 80);
+    b->len += 80;
+}
+
+static inline bool _encas_ascii_is_space(u8 c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline bool _encas_ascii_is_number_start(u8 c) {
+    return (u8)(c - '0') < 10 || c == '-' || c == '+' || c == '.';
+}
+
+// Next text line without its line break as an 80 byte, NUL padded line like the binary ones
+static bool _encas_ascii_line(const u8 **cur, const u8 *end, u8 line[80]) {
+    const u8 *p = *cur;
+    if (p >= end)
+        return false;
+
+    const u8 *nl = (const u8 *)memchr(p, '\n', end - p);
+    const u8 *line_end = nl ? nl : end;
+    *cur = nl ? nl + 1 : end;
+    if (line_end > p && line_end[-1] == '\r')
+        line_end--;
+
+    u64 len = (u64)(line_end - p) < 80 ? (u64)(line_end - p) : 80;
+    memset(line, 0, 80);
+    memcpy(line, p, len);
+    return true;
+}
+
+// End of the run of numeric lines that starts at p: the first line starting with anything else
+static const u8 *_encas_ascii_run_end(const u8 *p, const u8 *end) {
+    while (p < end) {
+        const u8 *q = p;
+        while (q < end && (*q == ' ' || *q == '\t'))
+            q++;
+        if (q < end && *q != '\n' && *q != '\r' && !_encas_ascii_is_number_start(*q))
+            break;
+
+        const u8 *nl = (const u8 *)memchr(q, '\n', end - q);
+        p = nl ? nl + 1 : end;
+    }
+    return p;
+}
+
+// Next number of a run. Numbers are separated by white space, a sign right after a digit
+// starts a new number as well because fixed width fields like %12.5e%12.5e can touch.
+static inline bool _encas_ascii_next_number(const u8 **cur, const u8 *end, Encas_Str *number) {
+    const u8 *p = *cur;
+    while (p < end && _encas_ascii_is_space(*p))
+        p++;
+    if (p >= end) {
+        *cur = p;
+        return false;
+    }
+
+    const u8 *begin = p++;
+    while (p < end && !_encas_ascii_is_space(*p) && !((*p == '-' || *p == '+') && (u8)(p[-1] - '0') < 10))
+        p++;
+
+    number->buffer = (u8 *)begin;
+    number->len = (u32)(p - begin);
+    *cur = p;
+    return true;
+}
 
+// Parses the numbers of [p, end) into out (NULL only counts them). Number first + i is stored
+// as a float if it is in [float_begin, float_end), as an s32 otherwise.
+static u64 _encas_ascii_parse_range(const u8 *p, const u8 *end, u32 *out, u64 first, u64 float_begin, u64 float_end) {
+    Encas_Str number;
+    u64 n = 0;
+    while (_encas_ascii_next_number(&p, end, &number)) {
+        if (out) {
+            u64 idx = first + n;
+            if (idx >= float_begin && idx < float_end) {
+                float v = Encas_Str_to_F32(number);
+                memcpy(out + n, &v, sizeof(float));
+            } else {
+                s32 v = Encas_Str_to_S32(number);
+                memcpy(out + n, &v, sizeof(s32));
             }
+        }
+        n++;
+    }
+    return n;
+}
 
-            // Element type
-            else if ((elem_type = Encas_ReadElemType(line, &is_ghost)) != ENCAS_ELEM_UNKNOWN) {
-                s32 num_of_elements = Encas_ReadS32(f);
+// Parses a whole run [begin, end) to the end of out, returns the number of numbers.
+// Large runs are split at line breaks, counted, then parsed in parallel.
+static u64 _encas_ascii_parse_run(const u8 *begin, const u8 *end, Encas_ByteBuffer *out, u64 float_begin, u64 float_end) {
+    const u64 size = (u64)(end - begin);
+    s64 num_chunks = size > ENCAS_PARALLEL_MIN ? (s64)_encas_max_threads() * 4 : 1;
+    if ((u64)num_chunks > size / 4096 + 1)
+        num_chunks = (s64)(size / 4096 + 1);
 
-                // Skip element ids
-                if (element_id == ENCAS_MODE_GIVEN || element_id == ENCAS_MODE_IGNORE)
-                    Encas_FileAdvace(f, num_of_elements * sizeof(s32));
+    const u8 **starts = (const u8 **)ENCAS_MALLOC((num_chunks + 1) * sizeof(const u8 *));
+    u64 *offsets = (u64 *)ENCAS_MALLOC((num_chunks + 1) * sizeof(u64));
 
-                u32 elem_vert_count = _get_elem_vert_count(elem_type);
+    starts[0] = begin;
+    starts[num_chunks] = end;
+    for (s64 k = 1; k < num_chunks; ++k) {
+        const u8 *p = begin + size * k / num_chunks;
+        if (p < starts[k - 1])
+            p = starts[k - 1];
+        const u8 *nl = (const u8 *)memchr(p, '\n', end - p);
+        starts[k] = nl ? nl + 1 : end;
+    }
 
-                // ghost elems
-                if (!is_ghost) {
-                    info->parts[part_idx].elem_vert_map_array_size += num_of_elements * elem_vert_count;
+    ENCAS_OMP(parallel for if(num_chunks > 1))
+    for (s64 k = 0; k < num_chunks; ++k)
+        offsets[k] = _encas_ascii_parse_range(starts[k], starts[k + 1], NULL, 0, 0, 0);
 
-                }
+    u64 total = 0;
+    for (s64 k = 0; k < num_chunks; ++k) {
+        u64 count = offsets[k];
+        offsets[k] = total;
+        total += count;
+    }
 
-                info->parts[part_idx].elem_sizes[elem_idx] = num_of_elements;
-                info->parts[part_idx].elem_offsets[elem_idx] = (elem_idx == 0) ? 0 : info->parts[part_idx].elem_offsets[elem_idx - 1] + num_of_elements;
-                Encas_FileAdvace(f, num_of_elements * elem_vert_count * sizeof(s32));
+    u32 *dst = (u32 *)_encas_bytes_reserve(out, total * sizeof(u32));
+
+    ENCAS_OMP(parallel for if(num_chunks > 1))
+    for (s64 k = 0; k < num_chunks; ++k)
+        _encas_ascii_parse_range(starts[k], starts[k + 1], dst + offsets[k], offsets[k], float_begin, float_end);
+
+    out->len += total * sizeof(u32);
+
+    ENCAS_FREE(starts);
+    ENCAS_FREE(offsets);
+    return total;
+}
+
+// First n numbers of a run as integers, without consuming them
+static void _encas_ascii_peek_s32(const u8 *p, const u8 *end, s32 *values, u32 n) {
+    Encas_Str number;
+    for (u32 i = 0; i < n; ++i)
+        values[i] = _encas_ascii_next_number(&p, end, &number) ? Encas_Str_to_S32(number) : 0;
+}
+
+// An ASCII file has a line break in what would be the first 80 byte binary line
+static bool _encas_is_ascii_file(const Encas_File *f) {
+    return memchr(f->buffer, '\n', f->size < 80 ? f->size : 80) != NULL;
+}
+
+// Rewrites an ASCII geometry (geometry = true) or variable file in the C Binary layout.
+// Returns NULL if the file is malformed.
+static Encas_File *_encas_ascii_to_binary(const Encas_File *f, bool geometry) {
+    const u8 *p = f->buffer;
+    const u8 *end = f->buffer + f->size;
+    Encas_ByteBuffer out;
+    u8 line[80];
+    Encas_Str str = { line, 80 };
+    bool node_ids = false, ok = true;
+
+    memset(&out, 0, sizeof(out));
+
+    // Header: the description (two lines for geometries) and the id modes
+    if (geometry) {
+        u8 header[80] = "C Binary";
+        memset(header + 8, 0, sizeof(header) - 8);
+        _encas_bytes_line(&out, header);
+    }
+
+    u32 header_lines = geometry ? 4 : 1;
+    for (u32 i = 0; i < header_lines && ok; ++i) {
+        ok = _encas_ascii_line(&p, end, line);
+        _encas_bytes_line(&out, line);
+        if (i == 2 && Encas_Str_StartsWith(str, Encas_Str_Lit("node id "))) {
+            Encas_Mode mode = _get_mode(Encas_Str_from_zstr((char *)line + 8, 72));
+            node_ids = mode == ENCAS_MODE_GIVEN || mode == ENCAS_MODE_IGNORE;
+        }
+    }
+
+    while (ok && _encas_ascii_line(&p, end, line)) {
+        bool is_ghost;
+        const u8 *run_end = _encas_ascii_run_end(p, end);
+
+        // Blank lines between the sections
+        if (line[0] == '\0')
+            continue;
+
+        _encas_bytes_line(&out, line);
+
+        if (Encas_Str_StartsWith(str, Encas_Str_Lit("part"))) {
+            // Part number, then the description of a geometry part
+            s32 part_number;
+            u8 number_line[80];
+            ok = _encas_ascii_line(&p, end, number_line);
+            const u8 *number_end = (const u8 *)memchr(number_line, '\0', 80);
+            _encas_ascii_peek_s32(number_line, number_end ? number_end : number_line + 80, &part_number, 1);
+            memcpy(_encas_bytes_reserve(&out, sizeof(s32)), &part_number, sizeof(s32));
+            out.len += sizeof(s32);
+
+            if (geometry && ok) {
+                ok = _encas_ascii_line(&p, end, line);
+                _encas_bytes_line(&out, line);
             }
+            continue;
+        }
 
-            else {
-                break;
+        if (!geometry) {
+            // coordinates, block or an element type: floats up to the next keyword
+            _encas_ascii_parse_run(p, run_end, &out, 0, UINT64_MAX);
+        } else if (Encas_Str_StartsWith(str, Encas_Str_Lit("extents"))) {
+            ok = _encas_ascii_parse_run(p, run_end, &out, 0, UINT64_MAX) == 6;
+        } else if (Encas_Str_StartsWith(str, Encas_Str_Lit("coordinates"))) {
+            // Number of nodes, optional node ids, then x, y and z
+            s32 num_of_nodes;
+            _encas_ascii_peek_s32(p, run_end, &num_of_nodes, 1);
+            u64 coords_begin = 1 + (node_ids ? (u64)num_of_nodes : 0);
+            u64 coords_end = coords_begin + 3 * (u64)num_of_nodes;
+            ok = num_of_nodes >= 0 && _encas_ascii_parse_run(p, run_end, &out, coords_begin, coords_end) == coords_end;
+        } else if (Encas_Str_StartsWith(str, Encas_Str_Lit("block"))) {
+            // Dims, the coordinates (all, the axes or origin and delta), then the optional iblanks
+            s32 dims[3];
+            _encas_ascii_peek_s32(p, run_end, dims, 3);
+            u64 num_of_floats;
+            if (_encas_str_contains(str, "rectilinear"))
+                num_of_floats = (u64)dims[0] + (u64)dims[1] + (u64)dims[2];
+            else if (_encas_str_contains(str, "uniform"))
+                num_of_floats = 6;
+            else
+                num_of_floats = 3 * (u64)dims[0] * (u64)dims[1] * (u64)dims[2];
+            u64 num_of_values = 3 + num_of_floats;
+            if (_encas_str_contains(str, "iblanked"))
+                num_of_values += (u64)dims[0] * (u64)dims[1] * (u64)dims[2];
+            ok = dims[0] > 0 && dims[1] > 0 && dims[2] > 0 &&
+                 _encas_ascii_parse_run(p, run_end, &out, 3, 3 + num_of_floats) == num_of_values;
+        } else if (Encas_Str_StartsWith(str, Encas_Str_Lit("ghost_flags")) ||
+                   Encas_Str_StartsWith(str, Encas_Str_Lit("node_ids")) ||
+                   Encas_Str_StartsWith(str, Encas_Str_Lit("element_ids")) ||
+                   Encas_ReadElemType(str, &is_ghost) != ENCAS_ELEM_UNKNOWN) {
+            // Block ids or an element block: only integers
+            _encas_ascii_parse_run(p, run_end, &out, 0, 0);
+        } else {
+            ok = false;
+        }
+
+        p = run_end;
+    }
+
+    if (!ok) {
+        ENCAS_FREE(out.data);
+        return NULL;
+    }
+
+    Encas_File *bin = (Encas_File *)ENCAS_MALLOC(sizeof(Encas_File));
+    bin->buffer = out.data;
+    bin->size = out.len;
+    bin->cur = 0;
+    bin->swap = false;
+    bin->owned = true;
+    bin->buffer_size = out.len;
+    bin->records = NULL;
+    bin->num_records = 0;
+    bin->joined = NULL;
+    bin->scratch = NULL;
+    bin->scratch_size = 0;
+    return bin;
+}
+
+// Fortran Binary files wrap every record (a line, a count, an array) in a length marker
+// before and after it. The markers are checked once and the records are listed, the readers
+// step over the markers through _encas_file_at and see the C Binary layout.
+
+// Record marker of 4 or 8 bytes. Records split by the compiler have negative markers.
+static inline s64 _encas_fortran_marker(const u8 *src, u32 width, bool swap) {
+    if (width == 4)
+        return (s32)_encas_load_u32(src, swap);
+
+    u64 lo = _encas_load_u32(src + (swap ? 4 : 0), swap);
+    u64 hi = _encas_load_u32(src + (swap ? 0 : 4), swap);
+    return (s64)(lo | (hi << 32));
+}
+
+// The first record is always an 80 byte line, its markers tell the width and the byte order.
+// Returns the marker width, 0 if the file is not Fortran Binary.
+static u32 _encas_fortran_marker_width(const Encas_File *f, bool *swap) {
+    for (u32 width = 4; width <= 8; width += 4) {
+        for (u32 s = 0; s < 2; ++s) {
+            if (f->size < 80 + 2 * (u64)width)
+                continue;
+            if (_encas_fortran_marker(f->buffer, width, s) == 80 &&
+                _encas_fortran_marker(f->buffer + width + 80, width, s) == 80) {
+                *swap = s;
+                return width;
             }
         }
+    }
+    return 0;
+}
 
-        // Part end
-        Encas_InsertHashTable(info->part_num_lookup, part_number, part_idx);
-        part_idx++;
+// The first line of a Fortran Binary geometry reads as this one
+static const u8 _encas_c_binary_line[80] = "C Binary";
+
+// Lists the records of a Fortran Binary file in f->records, "Fortran Binary" becomes "C Binary"
+// in a geometry. The payloads stay in buffer, only a record that the compiler split in
+// sub-records (negative head markers up to the last one) is joined in f->joined. Returns false
+// if a marker pair doesn't match or runs out of the file.
+static bool _encas_fortran_records(Encas_File *f, u32 width, bool swap, bool geometry) {
+    // Check the markers, count the records and the bytes of the split ones
+    u64 num_records = 0, joined_size = 0, split_size = 0;
+    for (u64 src = 0; src < f->size;) {
+        if (f->size - src < 2 * (u64)width)
+            return false;
+
+        s64 head = _encas_fortran_marker(f->buffer + src, width, swap);
+        u64 record_size = head < 0 ? (u64)-head : (u64)head;
+        if (record_size > f->size - src - 2 * (u64)width)
+            return false;
+
+        s64 tail = _encas_fortran_marker(f->buffer + src + width + record_size, width, swap);
+        if (tail != head && tail != -head)
+            return false;
+
+        if (head < 0 || split_size)
+            split_size += record_size;
+        if (head >= 0) {
+            ++num_records;
+            joined_size += split_size;
+            split_size = 0;
+        }
+        src += record_size + 2 * (u64)width;
+    }
+    // A split record cut by the end of the file
+    if (split_size) {
+        ++num_records;
+        joined_size += split_size;
+    }
+
+    Encas_FileRecord *records = (Encas_FileRecord *)ENCAS_MALLOC((num_records + 1) * sizeof(Encas_FileRecord));
+    u8 *joined = joined_size ? (u8 *)ENCAS_MALLOC(joined_size) : NULL;
+    u64 src = 0, len = 0, joined_len = 0, r = 0;
+    bool split = false;
+    while (src < f->size) {
+        s64 head = _encas_fortran_marker(f->buffer + src, width, swap);
+        u64 record_size = head < 0 ? (u64)-head : (u64)head;
+        const u8 *payload = f->buffer + src + width;
+
+        if (!split) {
+            split = head < 0;
+            records[r].pos = len;
+            records[r].data = split ? joined + joined_len : payload;
+        }
+        if (split) {
+            memcpy(joined + joined_len, payload, record_size);
+            joined_len += record_size;
+        }
+        if (head >= 0) {
+            split = false;
+            ++r;
+        }
+
+        len += record_size;
+        src += record_size + 2 * (u64)width;
     }
+    records[num_records].pos = len;
+    records[num_records].data = NULL;
 
-    Encas_FreeFile(f);
+    if (geometry && num_records && memcmp(records[0].data, "Fortran Binary", 14) == 0)
+        records[0].data = _encas_c_binary_line;
+
+    f->records = records;
+    f->num_records = num_records;
+    f->joined = joined;
+    f->size = len;
+    f->cur = 0;
     return true;
+}
+
+// Opens a geometry or a variable file, ASCII files are rewritten to C Binary on the way and the
+// records of Fortran Binary files are listed
+static Encas_File *_encas_open_gold_file(char *filename, bool geometry) {
+    Encas_File *f = Encas_SlurpFile(filename);
+    if (f == NULL)
+        return NULL;
+
+    bool swap;
+    u32 marker_width = _encas_fortran_marker_width(f, &swap);
+    if (marker_width) {
+        if (_encas_fortran_records(f, marker_width, swap, geometry))
+            return f;
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' has broken Fortran record markers!\n", filename);
+        Encas_FreeFile(f);
+        return NULL;
+    }
+
+    if (!_encas_is_ascii_file(f))
+        return f;
+
+    Encas_File *bin = _encas_ascii_to_binary(f, geometry);
+    if (bin == NULL)
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' is not a valid ASCII EnSight Gold file!\n", filename);
 
     Encas_FreeFile(f);
-    Encas_DeleteMeshInfo(info);
-    return false;
+    return bin;
 }
 
-// Reads a geometry file then parse the part numbers into a hashtable
-ENCAS_API Encas_HashTable *Encas_ParseGeoFileLookup(char *filename) {
-    Encas_File *f = Encas_SlurpFile(filename);
+// Geometry fingerprints. Sections are hashed in fixed 1 MB chunks with four independent
+// multiply-rotate lanes, the chunks in parallel, then the chunk hashes are folded in order,
+// so the result does not depend on the number of threads.
+#define ENCAS_FINGERPRINT_SEED 0x27d4eb2f165667c5ULL
+#define ENCAS_FINGERPRINT_CHUNK ((u64)1 << 20)
+
+static inline u64 _encas_mix64(u64 h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline u64 _encas_fingerprint_u64(u64 h, u64 v) {
+    return _encas_mix64((h ^ v) + 0x9e3779b97f4a7c15ULL);
+}
+
+static inline u64 _encas_fingerprint_lane(u64 acc, const u8 *src) {
+    u64 v;
+    memcpy(&v, src, sizeof(u64));
+    acc += v * 0xc2b2ae3d27d4eb4fULL;
+    acc = (acc << 31) | (acc >> 33);
+    return acc * 0x9e3779b97f4a7c15ULL;
+}
+
+static u64 _encas_fingerprint_chunk(const u8 *src, u64 n, u64 seed) {
+    u64 lanes[4] = { seed, seed + 0x9e3779b97f4a7c15ULL, seed ^ 0xc2b2ae3d27d4eb4fULL, ~seed };
+
+    u64 i = 0;
+    for (; i + 32 <= n; i += 32)
+        for (u32 lane = 0; lane < 4; ++lane)
+            lanes[lane] = _encas_fingerprint_lane(lanes[lane], src + i + lane * sizeof(u64));
+
+    if (i < n) {
+        u8 tail[32] = { 0 };
+        memcpy(tail, src + i, n - i);
+        for (u32 lane = 0; lane < 4; ++lane)
+            lanes[lane] = _encas_fingerprint_lane(lanes[lane], tail + lane * sizeof(u64));
+    }
+
+    u64 h = n;
+    for (u32 lane = 0; lane < 4; ++lane)
+        h = _encas_fingerprint_u64(h, lanes[lane]);
+    return h;
+}
+
+// Folds n bytes of src into the fingerprint h
+static u64 _encas_fingerprint_bytes(u64 h, const u8 *src, u64 n) {
+    h = _encas_fingerprint_u64(h, n);
+    const u64 num_chunks = (n + ENCAS_FINGERPRINT_CHUNK - 1) / ENCAS_FINGERPRINT_CHUNK;
+    if (num_chunks <= 1)
+        return n ? _encas_fingerprint_u64(h, _encas_fingerprint_chunk(src, n, 0)) : h;
+
+    u64 *chunk_hashes = (u64 *)ENCAS_MALLOC(num_chunks * sizeof(u64));
+    ENCAS_OMP(parallel for)
+    for (s64 c = 0; c < (s64)num_chunks; ++c) {
+        u64 begin = (u64)c * ENCAS_FINGERPRINT_CHUNK;
+        u64 size = n - begin < ENCAS_FINGERPRINT_CHUNK ? n - begin : ENCAS_FINGERPRINT_CHUNK;
+        chunk_hashes[c] = _encas_fingerprint_chunk(src + begin, size, (u64)c);
+    }
+
+    for (u64 c = 0; c < num_chunks; ++c)
+        h = _encas_fingerprint_u64(h, chunk_hashes[c]);
+
+    ENCAS_FREE(chunk_hashes);
+    return h;
+}
+
+// Folds the bytes [begin, end) of f into the fingerprint h, record by record in Fortran Binary
+static u64 _encas_fingerprint_file(u64 h, Encas_File *f, u64 begin, u64 end) {
+    if (!f->records)
+        return _encas_fingerprint_bytes(h, f->buffer + begin, end - begin);
+
+    for (u64 r = _encas_find_record(f, begin); begin < end; ++r) {
+        u64 record_end = f->records[r + 1].pos < end ? f->records[r + 1].pos : end;
+        h = _encas_fingerprint_bytes(h, f->records[r].data + (begin - f->records[r].pos), record_end - begin);
+        begin = record_end;
+    }
+    return h;
+}
+
+ENCAS_API bool Encas_ParseMeshInfo(Encas_MeshInfo *info, char *filename) {
+    Encas_Log(ENCAS_LOG_LEVEL_INFO, "Loading %s geometry file\n", filename);
+    // Failing early must still leave something Encas_DeleteMeshInfo can free
+    memset(info, 0, sizeof(Encas_MeshInfo));
+
+    if (!check_if_file_exists(filename)) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Cannot open %s geometry file\n", filename);
+        return false;
+    }
+
+    Encas_File *f = _encas_open_gold_file(filename, true);
+    if (!f)
+        return false;
     Encas_Mode node_id, element_id;
 
     Encas_Str line = Encas_ReadBinaryLine(f);
@@ -1627,14 +2882,14 @@ ENCAS_API Encas_HashTable *Encas_ParseGeoFileLookup(char *filename) {
     if (!Encas_Str_StartsWith(line, Encas_Str_Lit("C Binary"))) {
         Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' is not in C Binary form!\n", filename);
         Encas_FreeFile(f);
-        return NULL;
+        return false;
     }
 
     // Skip the two description line
     if (!Encas_FileAdvace(f, 160)) {
         Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file is not contains description!\n", filename);
         Encas_FreeFile(f);
-        return NULL;
+        return false;
     }
 
     line = Encas_ReadBinaryLine(f);
@@ -1642,7 +2897,7 @@ ENCAS_API Encas_HashTable *Encas_ParseGeoFileLookup(char *filename) {
     if (!Encas_Str_StartsWith(line, Encas_Str_Lit("node id "))) {
         Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file is not contains node id!\n", filename);
         Encas_FreeFile(f);
-        return NULL;
+        return false;
     }
 
     // Substring in a hacky way :)
@@ -1652,7 +2907,7 @@ ENCAS_API Encas_HashTable *Encas_ParseGeoFileLookup(char *filename) {
     if ((node_id = _get_mode(line)) == ENCAS_MODE_UNKNOWN) {
         Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: Unkown mode found! (not in: <off/given/assign/ignore>) at node id\n", filename);
         Encas_FreeFile(f);
-        return NULL;
+        return false;
     }
 
     // element id
@@ -1660,7 +2915,7 @@ ENCAS_API Encas_HashTable *Encas_ParseGeoFileLookup(char *filename) {
     if (!Encas_Str_StartsWith(line, Encas_Str_Lit("element id "))) {
         Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file is not contains element id!\n", filename);
         Encas_FreeFile(f);
-        return NULL;
+        return false;
     }
 
     // Substring in a hacky way :)
@@ -1670,25 +2925,334 @@ ENCAS_API Encas_HashTable *Encas_ParseGeoFileLookup(char *filename) {
     if ((element_id = _get_mode(line)) == ENCAS_MODE_UNKNOWN) {
         Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: Unkown mode found! (not in: <off/given/assign/ignore>) at element id\n", filename);
         Encas_FreeFile(f);
-        return NULL;
+        return false;
     }
 
+    _encas_detect_byte_order(f, NULL);
+
     // extents?
     line = Encas_ReadBinaryLine(f);
+    info->has_extents = false;
     if (Encas_Str_StartsWith(line, Encas_Str_Lit("extents"))) {
-        // Skips extents for now
-        Encas_FileAdvace(f, 6 * sizeof(float));
+        info->has_extents = true;
+        _encas_read_extents(f, &info->extents);
         line = Encas_ReadBinaryLine(f);
     }
 
-    // Parts
-    u32 part_count = 0;
-    Encas_HashTable *h = Encas_CreateHashTable();
+    u64 before_parts = f->cur;
+    Encas_Str before_parts_line = { .buffer = line.buffer, .len = line.len }; 
+    u64 num_of_parts = 0;
 
+    // Count how many parts are in the file
     while (Encas_Str_StartsWith(line, Encas_Str_Lit("part"))) {
-        s32 part_num = Encas_ReadS32(f);
-        Encas_InsertHashTable(h, part_num, part_count);
-        part_count++;
+        num_of_parts++;
+        Encas_ReadS32(f);
+        Encas_FileAdvace(f, 80);
+
+        while (!IS_ENCAS_EOF(f)) {
+            line = Encas_ReadBinaryLine(f);
+            bool is_ghost = false;
+            Encas_Elem_Type elem_type;
+
+            if (Encas_Str_StartsWith(line, Encas_Str_Lit("coordinates"))) {
+                s32 num_of_nodes = Encas_ReadS32(f);
+
+                // Skip node ids
+                if (node_id == ENCAS_MODE_GIVEN || node_id == ENCAS_MODE_IGNORE)
+                    Encas_FileAdvace(f, num_of_nodes * sizeof(s32));
+
+                Encas_FileAdvace(f, 3 * num_of_nodes * sizeof(float));
+
+            }
+
+            else if (Encas_Str_StartsWith(line, Encas_Str_Lit("block"))) {
+                Encas_Block block;
+                if (!_encas_skip_block(f, line, node_id, element_id, &block)) {
+                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: invalid block part!\n", filename);
+                    Encas_FreeFile(f);
+                    return false;
+                }
+            }
+
+            // Element type
+            else if ((elem_type = Encas_ReadElemType(line, &is_ghost)) != ENCAS_ELEM_UNKNOWN) {
+                s32 num_of_elements = Encas_ReadS32(f);
+
+                // Skip element ids
+                if (element_id == ENCAS_MODE_GIVEN || element_id == ENCAS_MODE_IGNORE)
+                    Encas_FileAdvace(f, num_of_elements * sizeof(s32));
+
+                Encas_FileAdvace(f, _encas_elem_block_size(f, elem_type, num_of_elements));
+            }
+
+            else {
+                break;
+            }
+        }
+    }
+
+    if (!num_of_parts) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "there are no parts in '%s' file!", filename);
+        Encas_FreeFile(f);
+        return false;
+    }
+
+    f->cur = before_parts;
+
+    line.buffer = before_parts_line.buffer;
+    line.len = before_parts_line.len;
+
+    info->parts = (Encas_MeshInfoPart *)ENCAS_MALLOC(num_of_parts * sizeof(Encas_MeshInfoPart));
+    memset(info->parts, 0, num_of_parts * sizeof(Encas_MeshInfoPart));
+    info->len = num_of_parts;
+    info->part_num_lookup = Encas_CreateHashTable();
+    info->node_id_mode = node_id;
+    info->element_id_mode = element_id;
+
+    u64 topology_hash = _encas_fingerprint_u64(ENCAS_FINGERPRINT_SEED, ((u64)node_id << 32) | (u64)element_id);
+    u64 coords_hash = ENCAS_FINGERPRINT_SEED;
+
+    u32 part_idx = 0;
+    // Parts
+    while (Encas_Str_StartsWith(line, Encas_Str_Lit("part"))) {
+        s32 part_number = Encas_ReadS32(f);
+        topology_hash = _encas_fingerprint_u64(topology_hash, (u32)part_number);
+
+        // Skip description line
+        Encas_FileAdvace(f, 80);
+
+        u64 begin = f->cur;
+        u32 num_of_elemtypes = 0;
+
+        // First only count the size of the memory to be allocated
+        while (!IS_ENCAS_EOF(f)) {
+            line = Encas_ReadBinaryLine(f);
+            bool is_ghost = false;
+            Encas_Elem_Type elem_type;
+
+            if (Encas_Str_StartsWith(line, Encas_Str_Lit("coordinates"))) {
+                s32 num_of_nodes = Encas_ReadS32(f);
+
+                // Skip node ids
+                if (node_id == ENCAS_MODE_GIVEN || node_id == ENCAS_MODE_IGNORE)
+                    Encas_FileAdvace(f, num_of_nodes * sizeof(s32));
+
+                Encas_FileAdvace(f, 3 * num_of_nodes * sizeof(float));
+
+            }
+
+            // A block part is a single element block
+            else if (Encas_Str_StartsWith(line, Encas_Str_Lit("block"))) {
+                Encas_Block block;
+                _encas_skip_block(f, line, node_id, element_id, &block);
+                num_of_elemtypes++;
+            }
+
+            // Element type
+            else if ((elem_type = Encas_ReadElemType(line, &is_ghost)) != ENCAS_ELEM_UNKNOWN) {
+                s32 num_of_elements = Encas_ReadS32(f);
+
+                // Skip element ids
+                if (element_id == ENCAS_MODE_GIVEN || element_id == ENCAS_MODE_IGNORE)
+                    Encas_FileAdvace(f, num_of_elements * sizeof(s32));
+
+
+                num_of_elemtypes++;
+                Encas_FileAdvace(f, _encas_elem_block_size(f, elem_type, num_of_elements));
+            }
+
+            else {
+                break;
+            }
+        }
+
+        f->cur = begin;
+
+        info->parts[part_idx].len = num_of_elemtypes;
+        info->parts[part_idx].elem_sizes = (s32 *)ENCAS_MALLOC(num_of_elemtypes * sizeof(s32));
+        info->parts[part_idx].elem_offsets = (u32 *)ENCAS_MALLOC(num_of_elemtypes * sizeof(u32));
+        info->parts[part_idx].elem_ghost = (bool *)ENCAS_MALLOC(num_of_elemtypes * sizeof(bool));
+        if (info->parts[part_idx].elem_sizes == NULL) {
+            Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Couldn't allocate memory!");
+            Encas_FreeFile(f);
+            return false;
+        }
+        info->parts[part_idx].elem_vert_map_array_size = 0;
+        info->parts[part_idx].ghost_elem_vert_map_array_size = 0;
+        info->parts[part_idx].num_ghost_elemtypes = 0;
+        info->parts[part_idx].num_of_coords = 0;
+        memset(info->parts[part_idx].block_dims, 0, sizeof(info->parts[part_idx].block_dims));
+
+        // Then store the data
+
+        u32 elem_idx = 0;
+
+        while (!IS_ENCAS_EOF(f)) {
+            line = Encas_ReadBinaryLine(f);
+            bool is_ghost = false;
+            Encas_Elem_Type elem_type;
+
+            if (Encas_Str_StartsWith(line, Encas_Str_Lit("coordinates"))) {
+                s32 num_of_nodes = Encas_ReadS32(f);
+                topology_hash = _encas_fingerprint_u64(topology_hash, (u32)num_of_nodes);
+
+                // Skip node ids, they are topology: a renumbered step cannot be loaded as coordinates only
+                u64 node_ids_begin = f->cur;
+                if (node_id == ENCAS_MODE_GIVEN || node_id == ENCAS_MODE_IGNORE)
+                    Encas_FileAdvace(f, num_of_nodes * sizeof(s32));
+                topology_hash = _encas_fingerprint_file(topology_hash, f, node_ids_begin, f->cur);
+
+                u64 coords_begin = f->cur;
+                info->parts[part_idx].num_of_coords = num_of_nodes;
+                Encas_FileAdvace(f, 3 * num_of_nodes * sizeof(float));
+                coords_hash = _encas_fingerprint_file(coords_hash, f, coords_begin, f->cur);
+            }
+
+            // The connectivity of a block is implicit, elem_vert_map_array_size stays 0.
+            // Its iblanks and ghost flags are mixed with the coordinates, so the whole
+            // block counts as topology.
+            else if (Encas_Str_StartsWith(line, Encas_Str_Lit("block"))) {
+                Encas_Block block;
+                u64 block_begin = f->cur;
+                _encas_skip_block(f, line, node_id, element_id, &block);
+
+                topology_hash = _encas_fingerprint_u64(topology_hash, ((u64)block.type << 2) | ((u64)block.iblanked << 1) | (u64)block.with_ghost);
+                topology_hash = _encas_fingerprint_file(topology_hash, f, block_begin, f->cur);
+
+                info->parts[part_idx].num_of_coords = (s32)Encas_BlockNumNodes(&block);
+                memcpy(info->parts[part_idx].block_dims, block.dims, sizeof(block.dims));
+                info->parts[part_idx].elem_sizes[elem_idx] = (s32)Encas_BlockNumCells(&block);
+                info->parts[part_idx].elem_offsets[elem_idx] = 0;
+                info->parts[part_idx].elem_ghost[elem_idx] = false;
+                ++elem_idx;
+            }
+
+            // Element type
+            else if ((elem_type = Encas_ReadElemType(line, &is_ghost)) != ENCAS_ELEM_UNKNOWN) {
+                s32 num_of_elements = Encas_ReadS32(f);
+                u64 elems_begin = f->cur;
+
+                // Skip element ids
+                if (element_id == ENCAS_MODE_GIVEN || element_id == ENCAS_MODE_IGNORE)
+                    Encas_FileAdvace(f, num_of_elements * sizeof(s32));
+
+                u32 elem_vert_count = _get_elem_vert_count(elem_type);
+
+                // ghost elems
+                if (!is_ghost) {
+                    info->parts[part_idx].elem_vert_map_array_size += num_of_elements * elem_vert_count;
+                } else {
+                    info->parts[part_idx].ghost_elem_vert_map_array_size += num_of_elements * elem_vert_count;
+                    info->parts[part_idx].num_ghost_elemtypes++;
+                }
+
+                info->parts[part_idx].elem_ghost[elem_idx] = is_ghost;
+                info->parts[part_idx].elem_sizes[elem_idx] = num_of_elements;
+                info->parts[part_idx].elem_offsets[elem_idx] = (elem_idx == 0) ? 0 : info->parts[part_idx].elem_offsets[elem_idx - 1] + info->parts[part_idx].elem_sizes[elem_idx - 1];
+                Encas_FileAdvace(f, _encas_elem_block_size(f, elem_type, num_of_elements));
+                ++elem_idx;
+
+                topology_hash = _encas_fingerprint_u64(topology_hash, ((u64)elem_type << 33) | ((u64)is_ghost << 32) | (u32)num_of_elements);
+                topology_hash = _encas_fingerprint_file(topology_hash, f, elems_begin, f->cur);
+            }
+
+            else {
+                break;
+            }
+        }
+
+        // Part end
+        Encas_InsertHashTable(info->part_num_lookup, part_number, part_idx);
+        part_idx++;
+    }
+
+    info->topology_hash = topology_hash;
+    info->coords_hash = coords_hash;
+
+    Encas_FreeFile(f);
+    return true;
+
+    Encas_FreeFile(f);
+    Encas_DeleteMeshInfo(info);
+    return false;
+}
+
+// Reads a geometry file then parse the part numbers into a hashtable
+ENCAS_API Encas_HashTable *Encas_ParseGeoFileLookup(char *filename) {
+    Encas_File *f = _encas_open_gold_file(filename, true);
+    if (!f)
+        return NULL;
+    Encas_Mode node_id, element_id;
+
+    Encas_Str line = Encas_ReadBinaryLine(f);
+
+    if (!Encas_Str_StartsWith(line, Encas_Str_Lit("C Binary"))) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' is not in C Binary form!\n", filename);
+        Encas_FreeFile(f);
+        return NULL;
+    }
+
+    // Skip the two description line
+    if (!Encas_FileAdvace(f, 160)) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file is not contains description!\n", filename);
+        Encas_FreeFile(f);
+        return NULL;
+    }
+
+    line = Encas_ReadBinaryLine(f);
+    // node id
+    if (!Encas_Str_StartsWith(line, Encas_Str_Lit("node id "))) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file is not contains node id!\n", filename);
+        Encas_FreeFile(f);
+        return NULL;
+    }
+
+    // Substring in a hacky way :)
+    line.buffer += 8;
+    line.len -= 8;
+
+    if ((node_id = _get_mode(line)) == ENCAS_MODE_UNKNOWN) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: Unkown mode found! (not in: <off/given/assign/ignore>) at node id\n", filename);
+        Encas_FreeFile(f);
+        return NULL;
+    }
+
+    // element id
+    line = Encas_ReadBinaryLine(f);
+    if (!Encas_Str_StartsWith(line, Encas_Str_Lit("element id "))) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file is not contains element id!\n", filename);
+        Encas_FreeFile(f);
+        return NULL;
+    }
+
+    // Substring in a hacky way :)
+    line.buffer += 11;
+    line.len -= 11;
+
+    if ((element_id = _get_mode(line)) == ENCAS_MODE_UNKNOWN) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: Unkown mode found! (not in: <off/given/assign/ignore>) at element id\n", filename);
+        Encas_FreeFile(f);
+        return NULL;
+    }
+
+    _encas_detect_byte_order(f, NULL);
+
+    // extents?
+    line = Encas_ReadBinaryLine(f);
+    if (Encas_Str_StartsWith(line, Encas_Str_Lit("extents"))) {
+        // Not needed for the lookup
+        Encas_FileAdvace(f, 6 * sizeof(float));
+        line = Encas_ReadBinaryLine(f);
+    }
+
+    // Parts
+    u32 part_count = 0;
+    Encas_HashTable *h = Encas_CreateHashTable();
+
+    while (Encas_Str_StartsWith(line, Encas_Str_Lit("part"))) {
+        s32 part_num = Encas_ReadS32(f);
+        Encas_InsertHashTable(h, part_num, part_count);
+        part_count++;
 
         // Skip description line
         Encas_FileAdvace(f, 80);
@@ -1716,9 +3280,13 @@ ENCAS_API Encas_HashTable *Encas_ParseGeoFileLookup(char *filename) {
             }
 
             else if (Encas_Str_StartsWith(line, Encas_Str_Lit("block"))) {
-                Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Structured data is not implemented yet! (block keyword)\n");
-                Encas_FreeFile(f);
-                return NULL;
+                Encas_Block block;
+                if (!_encas_skip_block(f, line, node_id, element_id, &block)) {
+                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: invalid block part!\n", filename);
+                    Encas_DeleteHashTable(h);
+                    Encas_FreeFile(f);
+                    return NULL;
+                }
             }
 
             // Element type
@@ -1729,9 +3297,7 @@ ENCAS_API Encas_HashTable *Encas_ParseGeoFileLookup(char *filename) {
                 if (element_id == ENCAS_MODE_GIVEN || element_id == ENCAS_MODE_IGNORE)
                     Encas_FileAdvace(f, num_of_elements * sizeof(s32));
 
-                u32 elem_vert_count = _get_elem_vert_count(elem_type);
-
-                Encas_FileAdvace(f, num_of_elements * elem_vert_count * sizeof(s32));
+                Encas_FileAdvace(f, _encas_elem_block_size(f, elem_type, num_of_elements));
             }
 
             else {
@@ -1777,6 +3343,38 @@ ENCAS_API void Encas_Dirname(char *path, char *dest) {
     }
 }
 
+static bool _encas_same_mesh_info_parts(const Encas_MeshInfo *a, const Encas_MeshInfo *b) {
+    if (a->topology_hash != b->topology_hash || a->len != b->len)
+        return false;
+
+    for (u32 part_idx = 0; part_idx < a->len; ++part_idx) {
+        const Encas_MeshInfoPart *pa = &a->parts[part_idx];
+        const Encas_MeshInfoPart *pb = &b->parts[part_idx];
+        if (pa->len != pb->len
+            || pa->num_of_coords != pb->num_of_coords
+            || pa->elem_vert_map_array_size != pb->elem_vert_map_array_size
+            || pa->ghost_elem_vert_map_array_size != pb->ghost_elem_vert_map_array_size
+            || memcmp(pa->block_dims, pb->block_dims, sizeof(pa->block_dims)) != 0
+            || memcmp(pa->elem_sizes, pb->elem_sizes, pa->len * sizeof(s32)) != 0
+            || memcmp(pa->elem_ghost, pb->elem_ghost, pa->len * sizeof(bool)) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+// Time steps whose geometry file has the same topology as the previous step's share its
+// parts and part_num_lookup. Extents and fingerprints stay per step.
+static void _encas_share_mesh_info_parts(Encas_MeshInfo *info, Encas_MeshInfo *prev) {
+    if (!_encas_same_mesh_info_parts(info, prev))
+        return;
+
+    Encas_DeleteMeshInfo(info);
+    info->parts = prev->parts;
+    info->part_num_lookup = prev->part_num_lookup;
+    info->shares_parts = true;
+}
+
 ENCAS_API Encas_Case *Encas_ReadCase(char *filename) {
     if (!check_if_file_exists(filename)) {
         Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Couldn't open '%s' case file!\n", filename);
@@ -1868,7 +3466,7 @@ ENCAS_API Encas_Case *Encas_ReadCase(char *filename) {
                         else {
                             Encas_Copy_Str_To_MutStr(arr->elems[0], &geometry_elem->filename);
                             geometry_elem->change_coords_only_set = true;
-                            geometry_elem->change_coords_only = Encas_Str_to_S32(arr->elems[1]);
+                            geometry_elem->change_coords_only = Encas_Str_Equals(arr->elems[1], Encas_Str_Lit("change_coords_only"));
                         }
                         break;
                     }
@@ -1894,7 +3492,7 @@ ENCAS_API Encas_Case *Encas_ReadCase(char *filename) {
                             Encas_Copy_Str_To_MutStr(arr->elems[1], &geometry_elem->filename);
 
                             geometry_elem->change_coords_only_set = true;
-                            geometry_elem->change_coords_only = Encas_Str_to_S32(arr->elems[2]);
+                            geometry_elem->change_coords_only = Encas_Str_Equals(arr->elems[2], Encas_Str_Lit("change_coords_only"));
                         }
                         break;
                     }
@@ -1910,7 +3508,7 @@ ENCAS_API Encas_Case *Encas_ReadCase(char *filename) {
                         Encas_Copy_Str_To_MutStr(arr->elems[2], &geometry_elem->filename);
 
                         geometry_elem->change_coords_only_set = true;
-                        geometry_elem->change_coords_only = Encas_Str_to_S32(arr->elems[3]);
+                        geometry_elem->change_coords_only = Encas_Str_Equals(arr->elems[3], Encas_Str_Lit("change_coords_only"));
                         break;
                     }
                     default: {
@@ -1944,7 +3542,11 @@ ENCAS_API Encas_Case *Encas_ReadCase(char *filename) {
                 if (encase->variable == NULL)
                     encase->variable = Encas_CreateVariableArray();
 
-                if (arr->len > 4 || arr->len < 2) {
+                // Complex variables end with Re_fn Im_fn freq instead of a single filename
+                const bool is_complex = Encas_Str_StartsWith(key, Encas_Str_Lit("complex"));
+                const u32 num_of_trailing = is_complex ? 3 : 1;
+
+                if (arr->len > 3 + num_of_trailing || arr->len < 1 + num_of_trailing) {
                     Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Invalid variable parameter: %.*s\n", value.len, value.buffer);
                     _free_case_and_file(encase, f);
                     return NULL;
@@ -1952,35 +3554,22 @@ ENCAS_API Encas_Case *Encas_ReadCase(char *filename) {
 
                 Encas_DescFile *df = Encas_CreateDescFile();
 
-                switch (arr->len) {
-                    // description filename
-                    case 2: {
-                        Encas_Copy_Str_To_MutStr(arr->elems[0], &df->description);
-                        Encas_Copy_Str_To_MutStr(arr->elems[1], &df->filename);
-                        break;
-                    }
-                    // [ts] description filename
-                    case 3: {
-                        df->ts_set = true;
-                        df->ts = Encas_Str_to_S32(arr->elems[0]);
-                        Encas_Copy_Str_To_MutStr(arr->elems[1], &df->description);
-                        Encas_Copy_Str_To_MutStr(arr->elems[2], &df->filename);
-                        break;
-                    }
-                    // [ts] [fs] description filename
-                    case 4: {
-                        df->ts_set = true;
-                        df->ts = Encas_Str_to_S32(arr->elems[0]);
-                        df->fs_set = true;
-                        df->fs = Encas_Str_to_S32(arr->elems[1]);
-                        Encas_Copy_Str_To_MutStr(arr->elems[2], &df->description);
-                        Encas_Copy_Str_To_MutStr(arr->elems[3], &df->filename);
-                        break;
-                    }
-                    default: {
-                        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Invalid variable parameter: %.*s\n", value.len, value.buffer);
-                        break;
-                    }
+                // [ts] [fs] description filename
+                u32 num_of_optional = arr->len - 1 - num_of_trailing;
+                if (num_of_optional >= 1) {
+                    df->ts_set = true;
+                    df->ts = Encas_Str_to_S32(arr->elems[0]);
+                }
+                if (num_of_optional == 2) {
+                    df->fs_set = true;
+                    df->fs = Encas_Str_to_S32(arr->elems[1]);
+                }
+
+                Encas_Copy_Str_To_MutStr(arr->elems[num_of_optional], &df->description);
+                Encas_Copy_Str_To_MutStr(arr->elems[num_of_optional + 1], &df->filename);
+                if (is_complex) {
+                    Encas_Copy_Str_To_MutStr(arr->elems[num_of_optional + 2], &df->im_filename);
+                    df->frequency = Encas_Str_to_F32(arr->elems[num_of_optional + 3]);
                 }
 
                 // [ts] description const_value(s)
@@ -2011,17 +3600,13 @@ ENCAS_API Encas_Case *Encas_ReadCase(char *filename) {
                 }
                 // [ts] [fs] description filename
                 else if (Encas_Str_Equals(key, Encas_Str_Lit("tensor symm per node"))) {
-                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'tensor symm per node' is not implemented yet\n");
-                    Encas_DeleteDescFile(df);
-                    _free_case_and_file(encase, f);
-                    return NULL;
+                    df->type = ENCAS_VARIABLE_TENSOR_SYMM_PER_NODE;
+                    Encas_PushVariableArray(encase->variable, df);
                 }
                 // [ts] [fs] description filename
                 else if (Encas_Str_Equals(key, Encas_Str_Lit("tensor asymm per node"))) {
-                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'tensor asymm per node' is not implemented yet\n");
-                    Encas_DeleteDescFile(df);
-                    _free_case_and_file(encase, f);
-                    return NULL;
+                    df->type = ENCAS_VARIABLE_TENSOR_ASYMM_PER_NODE;
+                    Encas_PushVariableArray(encase->variable, df);
                 }
                 // [ts] [fs] description filename
                 else if (Encas_Str_Equals(key, Encas_Str_Lit("scalar per element"))) {
@@ -2035,61 +3620,45 @@ ENCAS_API Encas_Case *Encas_ReadCase(char *filename) {
                 }
                 // [ts] [fs] description filename
                 else if (Encas_Str_Equals(key, Encas_Str_Lit("tensor symm per element"))) {
-                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'tensor symm per element' is not implemented yet\n");
-                    Encas_DeleteDescFile(df);
-                    _free_case_and_file(encase, f);
-                    return NULL;
+                    df->type = ENCAS_VARIABLE_TENSOR_SYMM_PER_ELEMENT;
+                    Encas_PushVariableArray(encase->variable, df);
                 }
                 // [ts] [fs] description filename
                 else if (Encas_Str_Equals(key, Encas_Str_Lit("tensor asymm per element"))) {
-                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'tensor asymm per element' is not implemented yet\n");
-                    Encas_DeleteDescFile(df);
-                    _free_case_and_file(encase, f);
-                    return NULL;
+                    df->type = ENCAS_VARIABLE_TENSOR_ASYMM_PER_ELEMENT;
+                    Encas_PushVariableArray(encase->variable, df);
                 }
                 // [ts] [fs] description filename
                 else if (Encas_Str_Equals(key, Encas_Str_Lit("scalar per measured node"))) {
-                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'scalar per measured node' is not implemented yet\n");
-                    Encas_DeleteDescFile(df);
-                    _free_case_and_file(encase, f);
-                    return NULL;
+                    df->type = ENCAS_VARIABLE_SCALAR_PER_MEASURED_NODE;
+                    Encas_PushVariableArray(encase->variable, df);
                 }
                 // [ts] [fs] description filename
                 else if (Encas_Str_Equals(key, Encas_Str_Lit("vector per measured node"))) {
-                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'vector per measured node' is not implemented yet\n");
-                    Encas_DeleteDescFile(df);
-                    _free_case_and_file(encase, f);
-                    return NULL;
+                    df->type = ENCAS_VARIABLE_VECTOR_PER_MEASURED_NODE;
+                    Encas_PushVariableArray(encase->variable, df);
                 }
                 // ----------------------------
 
                 // [ts] [fs] description Re_fn Im_fn freq
                 else if (Encas_Str_Equals(key, Encas_Str_Lit("complex scalar per node"))) {
-                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'complex scalar per node' is not implemented yet\n");
-                    Encas_DeleteDescFile(df);
-                    _free_case_and_file(encase, f);
-                    return NULL;
+                    df->type = ENCAS_VARIABLE_COMPLEX_SCALAR_PER_NODE;
+                    Encas_PushVariableArray(encase->variable, df);
                 }
                 // [ts] [fs] description Re_fn Im_fn freq
                 else if (Encas_Str_Equals(key, Encas_Str_Lit("complex vector per node"))) {
-                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'complex vector per node' is not implemented yet\n");
-                    Encas_DeleteDescFile(df);
-                    _free_case_and_file(encase, f);
-                    return NULL;
+                    df->type = ENCAS_VARIABLE_COMPLEX_VECTOR_PER_NODE;
+                    Encas_PushVariableArray(encase->variable, df);
                 }
                 // [ts] [fs] description Re_fn Im_fn freq
                 else if (Encas_Str_Equals(key, Encas_Str_Lit("complex scalar per element"))) {
-                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'complex scalar per element' is not implemented yet\n");
-                    Encas_DeleteDescFile(df);
-                    _free_case_and_file(encase, f);
-                    return NULL;
+                    df->type = ENCAS_VARIABLE_COMPLEX_SCALAR_PER_ELEMENT;
+                    Encas_PushVariableArray(encase->variable, df);
                 }
                 // [ts] [fs] description Re_fn Im_fn freq
                 else if (Encas_Str_Equals(key, Encas_Str_Lit("complex vector per element"))) {
-                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'complex vector per element' is not implemented yet\n");
-                    Encas_DeleteDescFile(df);
-                    _free_case_and_file(encase, f);
-                    return NULL;
+                    df->type = ENCAS_VARIABLE_COMPLEX_VECTOR_PER_ELEMENT;
+                    Encas_PushVariableArray(encase->variable, df);
                 }
                 else {
                     Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Invalid key in VARIABLE section: %.*s\n", key.len, key.buffer);
@@ -2270,10 +3839,14 @@ ENCAS_API Encas_Case *Encas_ReadCase(char *filename) {
             memcpy(geo_filename + filename_length + asterisk_idx, tmp, tmp_len);
 
             //printf("filename: %s\n", filename);
-            if(!Encas_ParseMeshInfo(&gelem->mesh_info_array.elems[idx++], geo_filename)) {
+            if(!Encas_ParseMeshInfo(&gelem->mesh_info_array.elems[idx], geo_filename)) {
                 Encas_DeleteCase(encase);
                 return NULL;
             }
+
+            if (idx > 0)
+                _encas_share_mesh_info_parts(&gelem->mesh_info_array.elems[idx], &gelem->mesh_info_array.elems[idx - 1]);
+            ++idx;
         }
     }
     // Only one geometry file
@@ -2313,12 +3886,47 @@ ENCAS_API Encas_Mesh *Encas_CreateMesh() {
     return mesh;
 }
 
+// A mesh of a slab only frees what was allocated on its own (poly elements, the block,
+// the expanded block connectivity, the id indices and the u16 connectivity), the rest goes with the slab.
 ENCAS_API void Encas_DeleteMesh(Encas_Mesh *mesh) {
+    for (u32 elem_idx = 0; elem_idx < mesh->elem_array_size; ++elem_idx)
+        if (mesh->elem_array[elem_idx].poly)
+            _encas_delete_poly_elem(mesh->elem_array[elem_idx].poly);
+    for (u32 elem_idx = 0; elem_idx < mesh->ghost_elem_array_size; ++elem_idx)
+        if (mesh->ghost_elem_array[elem_idx].poly)
+            _encas_delete_poly_elem(mesh->ghost_elem_array[elem_idx].poly);
+    if (mesh->block)
+        _encas_delete_block(mesh->block);
+
+    if (mesh->node_id_index) {
+        Encas_DeleteIdIndex(mesh->node_id_index);
+        ENCAS_FREE(mesh->node_id_index);
+    }
+    if (mesh->elem_id_index) {
+        Encas_DeleteIdIndex(mesh->elem_id_index);
+        ENCAS_FREE(mesh->elem_id_index);
+    }
+    // The u32 connectivity views elem_vert_map_array, the u16 one is a copy unless the slab holds it
+    if (mesh->connectivity.type == ENCAS_INDEX_U16 && !mesh->narrow_connectivity)
+        ENCAS_FREE(mesh->connectivity.data);
+
+    if (mesh->in_slab) {
+        // Built by Encas_ExpandConnectivity, the slab has no room for it
+        if (mesh->block || mesh->narrow_connectivity)
+            ENCAS_FREE(mesh->elem_vert_map_array);
+        return;
+    }
+
     ENCAS_FREE(mesh->vert_array.x);
     ENCAS_FREE(mesh->vert_array.y);
     ENCAS_FREE(mesh->vert_array.z);
+    ENCAS_FREE(mesh->vertices);
     ENCAS_FREE(mesh->elem_array);
     ENCAS_FREE(mesh->elem_vert_map_array);
+    ENCAS_FREE(mesh->ghost_elem_array);
+    ENCAS_FREE(mesh->ghost_elem_vert_map_array);
+    ENCAS_FREE(mesh->node_ids);
+    ENCAS_FREE(mesh->elem_ids);
 
     ENCAS_FREE(mesh);
 }
@@ -2379,10 +3987,265 @@ ENCAS_API void Encas_DeleteMeshArray(Encas_MeshArray *arr) {
     for(u32 mesh_idx = 0; mesh_idx < arr->len; ++mesh_idx)
         Encas_DeleteMesh(arr->elems[mesh_idx]);
 
+    ENCAS_FREE(arr->slab);
     ENCAS_FREE(arr->elems);
     ENCAS_FREE(arr);
 }
 
+force_inline u32 next_power_of_two(u32 x) {
+    if (x == 0) return 1;
+    --x;
+    x |= x >> 1;
+    x |= x >> 2;
+    x |= x >> 4;
+    x |= x >> 8;
+    x |= x >> 16;
+    return x + 1;
+}
+
+force_inline u32 _encas_id_hash(s32 id) {
+    return (u32)id * 0x9E3779B1u;
+}
+
+// Builds the id -> index lookup of ids[0 .. count). The ids are expected to be unique,
+// for a repeated id the first index is kept. Ids spanning at most twice their count
+// get a dense array, other ids a flat hash.
+ENCAS_API bool Encas_BuildIdIndex(Encas_IdIndex *index, const s32 *ids, u64 count) {
+    memset(index, 0, sizeof(Encas_IdIndex));
+    if (count == 0)
+        return true;
+
+    if (count >= UINT32_MAX) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Encas_BuildIdIndex: too many ids!\n");
+        return false;
+    }
+
+    s32 min_id = ids[0], max_id = ids[0];
+    ENCAS_OMP(parallel for reduction(min:min_id) reduction(max:max_id))
+    for (u64 i = 0; i < count; ++i) {
+        if (ids[i] < min_id) min_id = ids[i];
+        if (ids[i] > max_id) max_id = ids[i];
+    }
+
+    const u64 range = (u64)((s64)max_id - (s64)min_id) + 1;
+    if (range <= 2 * count) {
+        index->min_id = min_id;
+        index->dense_size = range;
+        index->dense = (u32 *)ENCAS_MALLOC(range * sizeof(u32));
+        if (!index->dense) {
+            Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Couldn't allocate memory!");
+            return false;
+        }
+
+        memset(index->dense, 0xFF, range * sizeof(u32));
+        for (u64 i = 0; i < count; ++i) {
+            u32 *slot = index->dense + ((s64)ids[i] - min_id);
+            if (*slot == ENCAS_INVALID_INDEX)
+                *slot = (u32)i;
+        }
+        return true;
+    }
+
+    index->cap = next_power_of_two((u32)(2 * count));
+    index->keys = (s32 *)ENCAS_MALLOC(index->cap * sizeof(s32));
+    index->values = (u32 *)ENCAS_MALLOC(index->cap * sizeof(u32));
+    if (!index->keys || !index->values) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Couldn't allocate memory!");
+        Encas_DeleteIdIndex(index);
+        return false;
+    }
+
+    memset(index->values, 0xFF, index->cap * sizeof(u32));
+    for (u64 i = 0; i < count; ++i) {
+        u32 slot = _encas_id_hash(ids[i]) & (index->cap - 1);
+        while (index->values[slot] != ENCAS_INVALID_INDEX && index->keys[slot] != ids[i])
+            slot = (slot + 1) & (index->cap - 1);
+
+        if (index->values[slot] == ENCAS_INVALID_INDEX) {
+            index->keys[slot] = ids[i];
+            index->values[slot] = (u32)i;
+        }
+    }
+    return true;
+}
+
+ENCAS_API void Encas_DeleteIdIndex(Encas_IdIndex *index) {
+    ENCAS_FREE(index->dense);
+    ENCAS_FREE(index->keys);
+    ENCAS_FREE(index->values);
+    memset(index, 0, sizeof(Encas_IdIndex));
+}
+
+// Returns the index of id or ENCAS_INVALID_INDEX
+ENCAS_API u32 Encas_LookupId(const Encas_IdIndex *index, s32 id) {
+    if (index->dense) {
+        u64 offset = (u64)((s64)id - (s64)index->min_id);
+        return offset < index->dense_size ? index->dense[offset] : ENCAS_INVALID_INDEX;
+    }
+
+    if (!index->cap)
+        return ENCAS_INVALID_INDEX;
+
+    u32 slot = _encas_id_hash(id) & (index->cap - 1);
+    while (index->values[slot] != ENCAS_INVALID_INDEX) {
+        if (index->keys[slot] == id)
+            return index->values[slot];
+        slot = (slot + 1) & (index->cap - 1);
+    }
+    return ENCAS_INVALID_INDEX;
+}
+
+// Translates count ids to indices in parallel, unknown ids become ENCAS_INVALID_INDEX.
+// Returns the number of ids found.
+ENCAS_API u64 Encas_TranslateIds(const Encas_IdIndex *index, const s32 *ids, u64 count, u32 *indices) {
+    u64 found = 0;
+
+    ENCAS_OMP(parallel for reduction(+:found))
+    for (u64 i = 0; i < count; ++i) {
+        indices[i] = Encas_LookupId(index, ids[i]);
+        found += indices[i] != ENCAS_INVALID_INDEX;
+    }
+
+    return found;
+}
+
+// Node id -> vertex index of the part, NULL without 'node id given'.
+// The index is built on the first call, which must not race with other calls on the same part.
+ENCAS_API const Encas_IdIndex *Encas_GetNodeIdIndex(Encas_Mesh *mesh) {
+    if (!mesh->node_ids)
+        return NULL;
+
+    if (!mesh->node_id_index) {
+        mesh->node_id_index = (Encas_IdIndex *)ENCAS_MALLOC(sizeof(Encas_IdIndex));
+        if (!Encas_BuildIdIndex(mesh->node_id_index, mesh->node_ids, mesh->vert_array_size)) {
+            ENCAS_FREE(mesh->node_id_index);
+            mesh->node_id_index = NULL;
+        }
+    }
+
+    return mesh->node_id_index;
+}
+
+// Element id -> cell index of the part (cells numbered in element order), NULL without
+// 'element id given'. Built on the first call like Encas_GetNodeIdIndex.
+ENCAS_API const Encas_IdIndex *Encas_GetElementIdIndex(Encas_Mesh *mesh) {
+    if (!mesh->elem_ids)
+        return NULL;
+
+    if (!mesh->elem_id_index) {
+        u64 num_cells = 0;
+        for (u32 elem_idx = 0; elem_idx < mesh->elem_array_size; ++elem_idx)
+            num_cells += mesh->elem_array[elem_idx].num_cells;
+        // Indices past the owned cells are kept ghost cells
+        for (u32 elem_idx = 0; elem_idx < mesh->ghost_elem_array_size; ++elem_idx)
+            num_cells += mesh->ghost_elem_array[elem_idx].num_cells;
+
+        mesh->elem_id_index = (Encas_IdIndex *)ENCAS_MALLOC(sizeof(Encas_IdIndex));
+        if (!Encas_BuildIdIndex(mesh->elem_id_index, mesh->elem_ids, num_cells)) {
+            ENCAS_FREE(mesh->elem_id_index);
+            mesh->elem_id_index = NULL;
+        }
+    }
+
+    return mesh->elem_id_index;
+}
+
+// Writes count vertex indices shifted by vert_offset to dst starting at dst_offset,
+// narrowed to dst->type. The caller makes sure every shifted index fits.
+static void _encas_store_indices(Encas_IndexArray *dst, u64 dst_offset, const u32 *src, u64 count, u64 vert_offset) {
+    if (dst->type == ENCAS_INDEX_U16) {
+        u16 *out = (u16 *)dst->data + dst_offset;
+        const u32 offset = (u32)vert_offset;
+        u64 i = 0;
+
+#ifdef ENCAS_SSE2
+        // Saturating packs are signed: move [0, 65535] to [-32768, 32767], pack, move back
+        const u64 num_blocks = count / 8;
+        ENCAS_OMP(parallel for if(count > ENCAS_PARALLEL_MIN))
+        for (u64 b = 0; b < num_blocks; ++b) {
+            const __m128i bias = _mm_set1_epi32((int)(offset - 0x8000u));
+            const __m128i v0 = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(src + b * 8)), bias);
+            const __m128i v1 = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(src + b * 8 + 4)), bias);
+            _mm_storeu_si128((__m128i *)(out + b * 8), _mm_xor_si128(_mm_packs_epi32(v0, v1), _mm_set1_epi16((short)0x8000)));
+        }
+        i = num_blocks * 8;
+#endif
+        for (; i < count; ++i)
+            out[i] = (u16)(src[i] + offset);
+    } else if (dst->type == ENCAS_INDEX_U32) {
+        u32 *out = (u32 *)dst->data + dst_offset;
+        const u32 offset = (u32)vert_offset;
+        ENCAS_OMP(parallel for if(count > ENCAS_PARALLEL_MIN))
+        for (u64 i = 0; i < count; ++i)
+            out[i] = src[i] + offset;
+    } else {
+        u64 *out = (u64 *)dst->data + dst_offset;
+        ENCAS_OMP(parallel for if(count > ENCAS_PARALLEL_MIN))
+        for (u64 i = 0; i < count; ++i)
+            out[i] = (u64)src[i] + vert_offset;
+    }
+}
+
+// Owned cell connectivity of the part in the narrowest index type for its vertex count, NULL on failure.
+// Parts of at most 65536 vertices get a u16 copy built on the first call, larger parts a u32 view of
+// elem_vert_map_array. Blocks are expanded first. Parts loaded with Encas_GeometryOptions.narrow_connectivity
+// already have their u16 one. Like Encas_GetNodeIdIndex the first call must not race.
+ENCAS_API const Encas_IndexArray *Encas_GetConnectivity(Encas_Mesh *mesh) {
+    if (mesh->connectivity.data || mesh->narrow_connectivity)
+        return &mesh->connectivity;
+
+    if (!Encas_ExpandBlockConnectivity(mesh))
+        return NULL;
+
+    u64 len = 0;
+    for (u32 elem_idx = 0; elem_idx < mesh->elem_array_size; ++elem_idx)
+        len += mesh->elem_array[elem_idx].elem_vert_map_size;
+
+    Encas_IndexArray *conn = &mesh->connectivity;
+    conn->len = len;
+    conn->type = Encas_IndexTypeFor(mesh->vert_array_size);
+    if (conn->type != ENCAS_INDEX_U16) {
+        conn->type = ENCAS_INDEX_U32;
+        conn->data = mesh->elem_vert_map_array;
+        return conn;
+    }
+
+    conn->data = ENCAS_MALLOC((len ? len : 1) * sizeof(u16));
+    if (conn->data == NULL) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Cannot allocate memory for part connectivity!\n");
+        return NULL;
+    }
+    _encas_store_indices(conn, 0, mesh->elem_vert_map_array, len, 0);
+
+    return conn;
+}
+
+// _encas_decode_conn into a u16 connectivity, decoded to u32 on the stack first
+static u64 _encas_decode_conn16(u16 *dst, const u8 *src, u64 n, u32 num_nodes, bool swap) {
+    const s64 chunk = 1024;
+    const s64 num_chunks = ((s64)n + chunk - 1) / chunk;
+    Encas_IndexArray conn = { ENCAS_INDEX_U16, dst, n };
+    bool valid = true;
+
+    ENCAS_OMP(parallel for reduction(&&:valid) if(n > ENCAS_PARALLEL_MIN))
+    for (s64 k = 0; k < num_chunks; ++k) {
+        u32 indices[1024];
+        u64 begin = (u64)(k * chunk);
+        u64 count = n - begin < (u64)chunk ? n - begin : (u64)chunk;
+        valid = _encas_decode_conn_range(indices, src + begin * sizeof(u32), count, num_nodes, swap) && valid;
+        _encas_store_indices(&conn, begin, indices, count, 0);
+    }
+
+    if (valid)
+        return n;
+
+    // Rare: find the first bad one in the file, the u16 copy cannot hold it
+    u64 i = 0;
+    while (i < n && _encas_load_u32(src + i * sizeof(u32), swap) - 1 < num_nodes)
+        ++i;
+    return i;
+}
+
 ENCAS_API const char *Encas_ElemToCstr(Encas_Elem_Type elem) {
     switch (elem) {
     case ENCAS_ELEM_POINT:
@@ -2428,173 +4291,687 @@ ENCAS_API const char *Encas_ElemToCstr(Encas_Elem_Type elem) {
     return "(null)";
 }
 
-ENCAS_API Encas_MeshArray *Encas_ReadGeometry(Encas_MeshInfo *mesh_info, char *filename) {
-    if (!check_if_file_exists(filename)) {
-        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Cannot open %s geometry file\n", filename);
-        return NULL;
-    }
+ENCAS_API u64 Encas_BlockNumNodes(const Encas_Block *block) {
+    return (u64)block->dims[0] * block->dims[1] * block->dims[2];
+}
 
-    Encas_File *f = Encas_SlurpFile(filename);
-    Encas_Mode node_id, element_id;
-    Encas_MeshArray *mesh_arr = Encas_CreateMeshArrayWithCap(mesh_info->len); // Geometry
+// Flat axes (1 node) have 1 cell layer, so a 2D block has quad4 cells
+ENCAS_API void Encas_BlockCellDims(const Encas_Block *block, u32 cell_dims[3]) {
+    for (u32 c = 0; c < 3; ++c)
+        cell_dims[c] = block->dims[c] > 1 ? block->dims[c] - 1 : 1;
+}
 
-    Encas_Str line = Encas_ReadBinaryLine(f);
+ENCAS_API u64 Encas_BlockNumCells(const Encas_Block *block) {
+    u32 cell_dims[3];
+    Encas_BlockCellDims(block, cell_dims);
+    return (u64)cell_dims[0] * cell_dims[1] * cell_dims[2];
+}
 
-    if (!Encas_Str_StartsWith(line, Encas_Str_Lit("C Binary"))) {
-        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' is not in C Binary form!\n", filename);
-        Encas_DeleteMeshArray(mesh_arr);
-        Encas_FreeFile(f);
-        return NULL;
+static Encas_Elem_Type _encas_block_elem_type(const Encas_Block *block) {
+    u32 num_axes = (block->dims[0] > 1) + (block->dims[1] > 1) + (block->dims[2] > 1);
+    switch (num_axes) {
+        case 3: return ENCAS_ELEM_HEXA8;
+        case 2: return ENCAS_ELEM_QUAD4;
+        case 1: return ENCAS_ELEM_BAR2;
+        default: return ENCAS_ELEM_POINT;
     }
+}
 
-    // Skip the two description line
-    if (!Encas_FileAdvace(f, 160)) {
-        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file is not contains description!\n", filename);
-        Encas_DeleteMeshArray(mesh_arr);
-        Encas_FreeFile(f);
-        return NULL;
+// Fills the vertices of a rectilinear or uniform block from its axes
+static void _encas_block_fill_coords(Encas_Mesh *mesh) {
+    const Encas_Block *block = mesh->block;
+    const u32 ni = block->dims[0], nj = block->dims[1], nk = block->dims[2];
+    const bool uniform = block->type == ENCAS_BLOCK_UNIFORM;
+
+    ENCAS_OMP(parallel for if((u64)nj * nk * ni > ENCAS_PARALLEL_MIN))
+    for (u64 row = 0; row < (u64)nj * nk; ++row) {
+        const u32 j = (u32)(row % nj), k = (u32)(row / nj);
+        const float y = uniform ? block->origin[1] + j * block->delta[1] : block->axis[1][j];
+        const float z = uniform ? block->origin[2] + k * block->delta[2] : block->axis[2][k];
+        float *xs = mesh->vert_array.x + row * ni;
+        float *ys = mesh->vert_array.y + row * ni;
+        float *zs = mesh->vert_array.z + row * ni;
+
+        for (u32 i = 0; i < ni; ++i) {
+            xs[i] = uniform ? block->origin[0] + i * block->delta[0] : block->axis[0][i];
+            ys[i] = y;
+            zs[i] = z;
+        }
     }
+}
 
-    line = Encas_ReadBinaryLine(f);
-    // node id
-    if (!Encas_Str_StartsWith(line, Encas_Str_Lit("node id "))) {
-        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file is not contains node id!\n", filename);
-        Encas_DeleteMeshArray(mesh_arr);
-        Encas_FreeFile(f);
-        return NULL;
+// Reads a block part after the 'block' line: header, coordinates, iblanks and ids.
+// The part gets a single element block whose connectivity is left for Encas_ExpandBlockConnectivity.
+// The coordinate and id arrays of mesh are sized by the slab layout from the mesh info,
+// for mesh->vert_array_size nodes and num_of_cells cells.
+static bool _encas_read_block(Encas_File *f, Encas_Str line, Encas_Mode node_id, Encas_Mode element_id, Encas_Mesh *mesh, u64 num_of_cells) {
+    Encas_Block *block = (Encas_Block *)ENCAS_MALLOC(sizeof(Encas_Block));
+    if (!_encas_read_block_header(f, line, block) || f->cur + _encas_block_data_size(block, node_id, element_id) > f->size
+        || Encas_BlockNumNodes(block) != mesh->vert_array_size || Encas_BlockNumCells(block) != num_of_cells) {
+        ENCAS_FREE(block);
+        return false;
     }
+    mesh->block = block;
 
-    // Substring in a hacky way :)
-    line.buffer += 8;
-    line.len -= 8;
+    const u64 num_nodes = Encas_BlockNumNodes(block);
+    const u64 num_cells = Encas_BlockNumCells(block);
+    u64 pos = f->cur;
 
-    if ((node_id = _get_mode(line)) == ENCAS_MODE_UNKNOWN) {
-        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: Unkown mode found! (not in: <off/given/assign/ignore>) at node id\n", filename);
-        Encas_DeleteMeshArray(mesh_arr);
-        Encas_FreeFile(f);
-        return NULL;
+    if (block->type == ENCAS_BLOCK_CURVILINEAR) {
+        float *dst[3] = { mesh->vert_array.x, mesh->vert_array.y, mesh->vert_array.z };
+        for (u32 c = 0; c < 3; ++c) {
+            _encas_copy_minmax(dst[c], _encas_file_at(f, pos, num_nodes * sizeof(float)), num_nodes, f->swap,
+                               &mesh->bounds.min[c], &mesh->bounds.max[c]);
+            pos += num_nodes * sizeof(float);
+        }
+    } else {
+        if (block->type == ENCAS_BLOCK_RECTILINEAR) {
+            // The bounds of a rectilinear block are the bounds of its axes
+            for (u32 c = 0; c < 3; ++c) {
+                block->axis[c] = (float *)ENCAS_MALLOC(block->dims[c] * sizeof(float));
+                _encas_copy_minmax(block->axis[c], _encas_file_at(f, pos, block->dims[c] * sizeof(float)), block->dims[c], f->swap,
+                                   &mesh->bounds.min[c], &mesh->bounds.max[c]);
+                pos += block->dims[c] * sizeof(float);
+            }
+        } else {
+            _encas_copy32(block->origin, _encas_file_at(f, pos, sizeof(block->origin)), 3, f->swap);
+            pos += sizeof(block->origin);
+            _encas_copy32(block->delta, _encas_file_at(f, pos, sizeof(block->delta)), 3, f->swap);
+            pos += sizeof(block->delta);
+
+            for (u32 c = 0; c < 3; ++c) {
+                float end = block->origin[c] + (block->dims[c] - 1) * block->delta[c];
+                mesh->bounds.min[c] = block->origin[c] < end ? block->origin[c] : end;
+                mesh->bounds.max[c] = block->origin[c] < end ? end : block->origin[c];
+            }
+        }
+
+        _encas_block_fill_coords(mesh);
     }
 
-    // element id
-    line = Encas_ReadBinaryLine(f);
-    if (!Encas_Str_StartsWith(line, Encas_Str_Lit("element id "))) {
-        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file is not contains element id!\n", filename);
-        Encas_DeleteMeshArray(mesh_arr);
-        Encas_FreeFile(f);
-        return NULL;
+    if (block->iblanked) {
+        block->iblank = (s32 *)ENCAS_MALLOC(num_nodes * sizeof(s32));
+        _encas_copy32(block->iblank, _encas_file_at(f, pos, num_nodes * sizeof(s32)), num_nodes, f->swap);
+        pos += num_nodes * sizeof(s32);
     }
 
-    // Substring in a hacky way :)
-    line.buffer += 11;
-    line.len -= 11;
+    // Ghost flags are not used, the ghost cells stay in the block
+    if (block->with_ghost)
+        pos += 80 + num_cells * sizeof(s32);
 
-    if ((element_id = _get_mode(line)) == ENCAS_MODE_UNKNOWN) {
-        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: Unkown mode found! (not in: <off/given/assign/ignore>) at element id\n", filename);
-        Encas_DeleteMeshArray(mesh_arr);
-        Encas_FreeFile(f);
-        return NULL;
-    }
+    if (node_id == ENCAS_MODE_GIVEN)
+        _encas_copy32(mesh->node_ids, _encas_file_at(f, pos + 80, num_nodes * sizeof(s32)), num_nodes, f->swap);
+    if (node_id == ENCAS_MODE_GIVEN || node_id == ENCAS_MODE_IGNORE)
+        pos += 80 + num_nodes * sizeof(s32);
 
-    // extents?
-    line = Encas_ReadBinaryLine(f);
-    if (Encas_Str_StartsWith(line, Encas_Str_Lit("extents"))) {
-        // Skips extents for now
-        // maybe implement later
-        Encas_FileAdvace(f, 6 * sizeof(float));
-        line = Encas_ReadBinaryLine(f);
-    }
+    if (element_id == ENCAS_MODE_GIVEN)
+        _encas_copy32(mesh->elem_ids, _encas_file_at(f, pos + 80, num_cells * sizeof(s32)), num_cells, f->swap);
+    if (element_id == ENCAS_MODE_GIVEN || element_id == ENCAS_MODE_IGNORE)
+        pos += 80 + num_cells * sizeof(s32);
 
-    u32 part_idx = 0;
-    while (Encas_Str_StartsWith(line, Encas_Str_Lit("part"))) {
-        Encas_Mesh *mesh = Encas_CreateMesh();
+    Encas_Elem *elem = &mesh->elem_array[0];
+    elem->type = _encas_block_elem_type(block);
+    elem->elem_size = _get_elem_vert_count(elem->type);
+    elem->elem_vert_map_size = (u32)(num_cells * elem->elem_size);
+    elem->elem_vert_map_entry = 0;
+    elem->num_cells = (u32)num_cells;
+    elem->poly = NULL;
 
-        mesh->part_number = Encas_ReadS32(f);
+    f->cur = pos;
+    return true;
+}
 
-        // Skip description line
-        Encas_FileAdvace(f, 80);
+// Writes the connectivity of the cells [cell_begin, cell_begin + num_cells) of a block
+// (vert_cnt corners each) to conn, cells numbered i fastest
+static void _encas_block_cells(const Encas_Block *block, u32 vert_cnt, u64 cell_begin, u64 num_cells, u32 *conn) {
+    // Node offsets of the cell corners from the first node of the cell,
+    // in hexa8 order over the axes that are not flat
+    static const u8 corners[8][3] = {
+        {0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0},
+        {0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1},
+    };
+    const u64 strides[3] = { 1, block->dims[0], (u64)block->dims[0] * block->dims[1] };
+    u64 axis_strides[3];
+    u32 num_axes = 0;
+    for (u32 c = 0; c < 3; ++c)
+        if (block->dims[c] > 1)
+            axis_strides[num_axes++] = strides[c];
+
+    u64 corner_offsets[8];
+    for (u32 v = 0; v < vert_cnt; ++v) {
+        corner_offsets[v] = 0;
+        for (u32 a = 0; a < num_axes; ++a)
+            corner_offsets[v] += corners[v][a] * axis_strides[a];
+    }
+
+    u32 cell_dims[3];
+    Encas_BlockCellDims(block, cell_dims);
+    u64 i = cell_begin % cell_dims[0], row = cell_begin / cell_dims[0];
+
+    for (u64 cell = 0; cell < num_cells; ++cell) {
+        const u64 j = row % cell_dims[1], k = row / cell_dims[1];
+        const u64 first_node = (j + k * block->dims[1]) * block->dims[0] + i;
+        for (u32 v = 0; v < vert_cnt; ++v)
+            conn[v] = (u32)(first_node + corner_offsets[v]);
+        conn += vert_cnt;
+
+        if (++i == cell_dims[0]) {
+            i = 0;
+            ++row;
+        }
+    }
+}
 
-        mesh->elem_array_size = mesh_info->parts[part_idx].len;
-        u64 elem_vert_map_array_size = mesh_info->parts[part_idx].elem_vert_map_array_size;
+// Builds the cell connectivity of a block part, once. Unstructured parts are left alone.
+// Until this is called the block costs no connectivity memory, the shell builder does not need it.
+ENCAS_API bool Encas_ExpandBlockConnectivity(Encas_Mesh *mesh) {
+    if (mesh->block == NULL || mesh->elem_vert_map_array != NULL)
+        return true;
 
-        // Then store the data
-        mesh->elem_array          = (Encas_Elem *)ENCAS_MALLOC(mesh->elem_array_size * sizeof(Encas_Elem));
-        mesh->elem_vert_map_array = (u32 *)ENCAS_MALLOC(elem_vert_map_array_size * sizeof(u32));
+    const Encas_Block *block = mesh->block;
+    const Encas_Elem *elem = &mesh->elem_array[0];
+    const u32 vert_cnt = elem->elem_size;
 
-        u32 elem_idx = 0;
-        u32 elem_vert_map_entry_ptr = 0;
+    mesh->elem_vert_map_array = (u32 *)ENCAS_MALLOC((u64)elem->elem_vert_map_size * sizeof(u32));
+    if (mesh->elem_vert_map_array == NULL) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Cannot allocate memory for block connectivity!\n");
+        return false;
+    }
 
-        while (!IS_ENCAS_EOF(f)) {
-            line = Encas_ReadBinaryLine(f);
-            bool is_ghost = false;
-            Encas_Elem_Type elem_type;
+    u32 cell_dims[3];
+    Encas_BlockCellDims(block, cell_dims);
+    const u64 num_rows = (u64)cell_dims[1] * cell_dims[2];
 
-            if (Encas_Str_StartsWith(line, Encas_Str_Lit("coordinates"))) {
-                s32 num_of_nodes = Encas_ReadS32(f);
+    ENCAS_OMP(parallel for if(elem->num_cells > ENCAS_PARALLEL_MIN))
+    for (u64 row = 0; row < num_rows; ++row)
+        _encas_block_cells(block, vert_cnt, row * cell_dims[0], cell_dims[0], mesh->elem_vert_map_array + row * cell_dims[0] * vert_cnt);
 
-                // Skip node ids
-                if (node_id == ENCAS_MODE_GIVEN || node_id == ENCAS_MODE_IGNORE)
-                    Encas_FileAdvace(f, num_of_nodes * sizeof(s32));
+    return true;
+}
 
-                mesh->vert_array_size = num_of_nodes;
-                mesh->vert_array.x = (float *)ENCAS_MALLOC(mesh->vert_array_size * sizeof(float));
-                mesh->vert_array.y = (float *)ENCAS_MALLOC(mesh->vert_array_size * sizeof(float));
-                mesh->vert_array.z = (float *)ENCAS_MALLOC(mesh->vert_array_size * sizeof(float));
+// The count u32 indices of the owned connectivity from entry on. Parts without elem_vert_map_array
+// build them in *cells, which the caller frees: blocks from their dims, the others from the
+// u16 connectivity. NULL if that allocation fails.
+static u32 *_encas_cells_u32(const Encas_Mesh *mesh, u64 entry, u64 count, u32 **cells) {
+    *cells = NULL;
+    if (mesh->elem_vert_map_array)
+        return mesh->elem_vert_map_array + entry;
 
-                // Store coordinates
-/* DEPRECATED
-                for (u32 vert_idx = 0; vert_idx < num_of_nodes; ++vert_idx) {
-                    mesh->vert_array[vert_idx].x = *(float *)(f->buffer + f->cur + vert_idx * sizeof(float));
+    *cells = (u32 *)ENCAS_MALLOC((count ? count : 1) * sizeof(u32));
+    if (*cells == NULL)
+        return NULL;
+
+    if (mesh->block) {
+        const u32 vert_cnt = mesh->elem_array[0].elem_size;
+        _encas_block_cells(mesh->block, vert_cnt, entry / vert_cnt, count / vert_cnt, *cells);
+    } else {
+        const u16 *src = (const u16 *)mesh->connectivity.data + entry;
+        u32 *dst = *cells;
+        ENCAS_OMP(parallel for if(count > ENCAS_PARALLEL_MIN))
+        for (u64 i = 0; i < count; ++i)
+            dst[i] = src[i];
+    }
+
+    return *cells;
+}
+
+// Builds the u32 elem_vert_map_array of a block or of a part loaded with only its u16
+// connectivity, once. Everything else already has it.
+ENCAS_API bool Encas_ExpandConnectivity(Encas_Mesh *mesh) {
+    if (mesh->elem_vert_map_array != NULL)
+        return true;
+    if (mesh->block)
+        return Encas_ExpandBlockConnectivity(mesh);
+    if (!mesh->narrow_connectivity)
+        return true;
+
+    u32 *cells;
+    if (_encas_cells_u32(mesh, 0, mesh->connectivity.len, &cells) == NULL) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Cannot allocate memory for part connectivity!\n");
+        return false;
+    }
+    mesh->elem_vert_map_array = cells;
+
+    return true;
+}
+
+ENCAS_API Encas_MeshArray *Encas_ReadGeometry(Encas_MeshInfo *mesh_info, char *filename) {
+    return Encas_ReadGeometryEx(mesh_info, filename, NULL);
+}
+
+// Every array of a slab starts ENCAS_SLAB_ALIGN aligned
+#define ENCAS_SLAB_ALIGN 16
+
+static inline u64 _encas_slab_align(u64 size) {
+    return (size + ENCAS_SLAB_ALIGN - 1) & ~(u64)(ENCAS_SLAB_ALIGN - 1);
+}
+
+// Takes size bytes at *offset of the slab, NULL for empty arrays or while only measuring (slab == NULL)
+static inline void *_encas_slab_take(u8 *slab, u64 *offset, u64 size) {
+    if (size == 0)
+        return NULL;
+
+    void *ptr = slab ? slab + *offset : NULL;
+    *offset += _encas_slab_align(size);
+    return ptr;
+}
+
+// Cells of the owned (ghost == false) or the ghost element blocks of a part
+static u64 _encas_part_num_cells(const Encas_MeshInfoPart *minfo_part, bool ghost) {
+    u64 num_cells = 0;
+    for (s32 i = 0; i < minfo_part->len; ++i)
+        if (minfo_part->elem_ghost[i] == ghost)
+            num_cells += minfo_part->elem_sizes[i];
+    return num_cells;
+}
+
+// SoA -> AoS transpose of count vertices into dst, 3 (xyz) or 4 (xyzw, w = 1) floats per vertex
+ENCAS_API void Encas_InterleaveVertices(const Encas_Vertices *src, u64 count, float *dst, Encas_VertexLayout layout) {
+    const u32 stride = Encas_VertexStride(layout);
+    const float *x = src->x, *y = src->y, *z = src->z;
+    u64 i = 0;
+
+    if (stride == 0)
+        return;
+
+#ifdef ENCAS_SSE2
+    // Transpose 4 vertices at a time, xyz drops w by shifting the rows into 3 registers
+    const u64 num_blocks = count / 4;
+    ENCAS_OMP(parallel for if(count > ENCAS_PARALLEL_MIN))
+    for (u64 b = 0; b < num_blocks; ++b) {
+        __m128 r0 = _mm_loadu_ps(x + b * 4);
+        __m128 r1 = _mm_loadu_ps(y + b * 4);
+        __m128 r2 = _mm_loadu_ps(z + b * 4);
+        __m128 r3 = _mm_set1_ps(1.0f);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+        float *out = dst + b * 4 * stride;
+        if (stride == 4) {
+            _mm_storeu_ps(out + 0, r0);
+            _mm_storeu_ps(out + 4, r1);
+            _mm_storeu_ps(out + 8, r2);
+            _mm_storeu_ps(out + 12, r3);
+        } else {
+            const __m128 t0 = _mm_shuffle_ps(r0, r1, _MM_SHUFFLE(0, 0, 2, 2)); // z0 z0 x1 x1
+            const __m128 t2 = _mm_shuffle_ps(r2, r3, _MM_SHUFFLE(0, 0, 2, 2)); // z2 z2 x3 x3
+            _mm_storeu_ps(out + 0, _mm_shuffle_ps(r0, t0, _MM_SHUFFLE(2, 0, 1, 0))); // x0 y0 z0 x1
+            _mm_storeu_ps(out + 4, _mm_shuffle_ps(r1, r2, _MM_SHUFFLE(1, 0, 2, 1))); // y1 z1 x2 y2
+            _mm_storeu_ps(out + 8, _mm_shuffle_ps(t2, r3, _MM_SHUFFLE(2, 1, 2, 0))); // z2 x3 y3 z3
+        }
+    }
+    i = num_blocks * 4;
+#endif
+
+    for (; i < count; ++i) {
+        float *out = dst + i * stride;
+        out[0] = x[i];
+        out[1] = y[i];
+        out[2] = z[i];
+        if (stride == 4)
+            out[3] = 1.0f;
+    }
+}
+
+// Lays the meshes of a geometry file out in one slab: for every part its Encas_Mesh, the
+// coordinates (and their interleaved copy), the element arrays, the connectivity and the ids, one after the other, all
+// sized from the mesh info. Returns the size of the slab. With slab == NULL only measures,
+// otherwise carves meshes[part_idx] out of it with their arrays set and vert_array_size
+// holding the expected number of nodes.
+static u64 _encas_layout_mesh_slab(const Encas_MeshInfo *mesh_info, bool keep_ghosts, Encas_VertexLayout vertex_layout, bool narrow_connectivity, u8 *slab, Encas_Mesh **meshes) {
+    const u32 vertex_stride = Encas_VertexStride(vertex_layout);
+    u64 offset = 0;
+
+    for (u32 part_idx = 0; part_idx < mesh_info->len; ++part_idx) {
+        const Encas_MeshInfoPart *minfo_part = &mesh_info->parts[part_idx];
+        const u64 num_nodes = minfo_part->num_of_coords > 0 ? (u64)minfo_part->num_of_coords : 0;
+        const u64 elem_array_size = minfo_part->len - minfo_part->num_ghost_elemtypes;
+        const bool ghosts = keep_ghosts && minfo_part->num_ghost_elemtypes;
+        const u64 num_cells = _encas_part_num_cells(minfo_part, false) + (keep_ghosts ? _encas_part_num_cells(minfo_part, true) : 0);
+
+        Encas_Mesh *mesh = (Encas_Mesh *)_encas_slab_take(slab, &offset, sizeof(Encas_Mesh));
+        float *x = (float *)_encas_slab_take(slab, &offset, num_nodes * sizeof(float));
+        float *y = (float *)_encas_slab_take(slab, &offset, num_nodes * sizeof(float));
+        float *z = (float *)_encas_slab_take(slab, &offset, num_nodes * sizeof(float));
+        float *vertices = (float *)_encas_slab_take(slab, &offset, num_nodes * vertex_stride * sizeof(float));
+        Encas_Elem *elem_array = (Encas_Elem *)_encas_slab_take(slab, &offset, elem_array_size * sizeof(Encas_Elem));
+        // If asked, parts that u16 can address keep only the u16 connectivity
+        const bool narrow = narrow_connectivity && Encas_IndexTypeFor(num_nodes) == ENCAS_INDEX_U16;
+        u32 *elem_vert_map_array = narrow ? NULL : (u32 *)_encas_slab_take(slab, &offset, minfo_part->elem_vert_map_array_size * sizeof(u32));
+        u16 *connectivity = narrow ? (u16 *)_encas_slab_take(slab, &offset, minfo_part->elem_vert_map_array_size * sizeof(u16)) : NULL;
+        Encas_Elem *ghost_elem_array = NULL;
+        u32 *ghost_elem_vert_map_array = NULL;
+        if (ghosts) {
+            ghost_elem_array = (Encas_Elem *)_encas_slab_take(slab, &offset, minfo_part->num_ghost_elemtypes * sizeof(Encas_Elem));
+            ghost_elem_vert_map_array = (u32 *)_encas_slab_take(slab, &offset, minfo_part->ghost_elem_vert_map_array_size * sizeof(u32));
+        }
+        s32 *node_ids = mesh_info->node_id_mode == ENCAS_MODE_GIVEN ? (s32 *)_encas_slab_take(slab, &offset, num_nodes * sizeof(s32)) : NULL;
+        s32 *elem_ids = mesh_info->element_id_mode == ENCAS_MODE_GIVEN ? (s32 *)_encas_slab_take(slab, &offset, num_cells * sizeof(s32)) : NULL;
+
+        if (slab == NULL)
+            continue;
+
+        memset(mesh, 0, sizeof(Encas_Mesh));
+        mesh->in_slab = true;
+        _encas_empty_aabb(&mesh->bounds);
+        mesh->vert_array.x = x;
+        mesh->vert_array.y = y;
+        mesh->vert_array.z = z;
+        mesh->vert_array_size = num_nodes;
+        mesh->vertices = vertices;
+        mesh->vertex_layout = vertex_layout;
+        mesh->elem_array = elem_array;
+        mesh->elem_array_size = elem_array_size;
+        mesh->elem_vert_map_array = elem_vert_map_array;
+        if (narrow) {
+            mesh->narrow_connectivity = true;
+            mesh->connectivity.type = ENCAS_INDEX_U16;
+            mesh->connectivity.data = connectivity;
+            mesh->connectivity.len = minfo_part->elem_vert_map_array_size;
+        }
+        if (ghosts) {
+            mesh->ghost_elem_array = ghost_elem_array;
+            mesh->ghost_elem_array_size = minfo_part->num_ghost_elemtypes;
+            mesh->ghost_elem_vert_map_array = ghost_elem_vert_map_array;
+            memset(ghost_elem_array, 0, mesh->ghost_elem_array_size * sizeof(Encas_Elem));
+        }
+        mesh->node_ids = node_ids;
+        mesh->elem_ids = elem_ids;
+        if (elem_array)
+            memset(elem_array, 0, elem_array_size * sizeof(Encas_Elem));
+
+        meshes[part_idx] = mesh;
+    }
+
+    return offset;
+}
+
+// options may be NULL for the defaults
+ENCAS_API Encas_MeshArray *Encas_ReadGeometryEx(Encas_MeshInfo *mesh_info, char *filename, const Encas_GeometryOptions *options) {
+    const bool keep_ghosts = options && options->keep_ghosts;
+    const Encas_VertexLayout vertex_layout = options ? options->vertex_layout : ENCAS_VERTEX_SOA;
+    const bool narrow_connectivity = options && options->narrow_connectivity;
+
+    if (!check_if_file_exists(filename)) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Cannot open %s geometry file\n", filename);
+        return NULL;
+    }
+
+    Encas_File *f = _encas_open_gold_file(filename, true);
+    if (!f)
+        return NULL;
+    Encas_Mode node_id, element_id;
+    Encas_MeshArray *mesh_arr = Encas_CreateMeshArrayWithCap(mesh_info->len); // Geometry
+    mesh_arr->topology_hash = mesh_info->topology_hash;
+    mesh_arr->coords_hash = mesh_info->coords_hash;
+
+    // The meshes are carved into elems[0 .. mesh_info->len), they are pushed once read
+    mesh_arr->slab = ENCAS_MALLOC(_encas_layout_mesh_slab(mesh_info, keep_ghosts, vertex_layout, narrow_connectivity, NULL, NULL));
+    if (mesh_arr->slab == NULL) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Cannot allocate memory for the meshes of '%s'!\n", filename);
+        Encas_DeleteMeshArray(mesh_arr);
+        Encas_FreeFile(f);
+        return NULL;
+    }
+    _encas_layout_mesh_slab(mesh_info, keep_ghosts, vertex_layout, narrow_connectivity, (u8 *)mesh_arr->slab, mesh_arr->elems);
+
+    Encas_Str line = Encas_ReadBinaryLine(f);
+
+    if (!Encas_Str_StartsWith(line, Encas_Str_Lit("C Binary"))) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' is not in C Binary form!\n", filename);
+        Encas_DeleteMeshArray(mesh_arr);
+        Encas_FreeFile(f);
+        return NULL;
+    }
+
+    // Skip the two description line
+    if (!Encas_FileAdvace(f, 160)) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file is not contains description!\n", filename);
+        Encas_DeleteMeshArray(mesh_arr);
+        Encas_FreeFile(f);
+        return NULL;
+    }
+
+    line = Encas_ReadBinaryLine(f);
+    // node id
+    if (!Encas_Str_StartsWith(line, Encas_Str_Lit("node id "))) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file is not contains node id!\n", filename);
+        Encas_DeleteMeshArray(mesh_arr);
+        Encas_FreeFile(f);
+        return NULL;
+    }
+
+    // Substring in a hacky way :)
+    line.buffer += 8;
+    line.len -= 8;
+
+    if ((node_id = _get_mode(line)) == ENCAS_MODE_UNKNOWN) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: Unkown mode found! (not in: <off/given/assign/ignore>) at node id\n", filename);
+        Encas_DeleteMeshArray(mesh_arr);
+        Encas_FreeFile(f);
+        return NULL;
+    }
+
+    // element id
+    line = Encas_ReadBinaryLine(f);
+    if (!Encas_Str_StartsWith(line, Encas_Str_Lit("element id "))) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file is not contains element id!\n", filename);
+        Encas_DeleteMeshArray(mesh_arr);
+        Encas_FreeFile(f);
+        return NULL;
+    }
+
+    // Substring in a hacky way :)
+    line.buffer += 11;
+    line.len -= 11;
+
+    if ((element_id = _get_mode(line)) == ENCAS_MODE_UNKNOWN) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: Unkown mode found! (not in: <off/given/assign/ignore>) at element id\n", filename);
+        Encas_DeleteMeshArray(mesh_arr);
+        Encas_FreeFile(f);
+        return NULL;
+    }
+
+    _encas_detect_byte_order(f, NULL);
+
+    // extents?
+    line = Encas_ReadBinaryLine(f);
+    if (Encas_Str_StartsWith(line, Encas_Str_Lit("extents"))) {
+        mesh_arr->has_extents = true;
+        _encas_read_extents(f, &mesh_arr->extents);
+        line = Encas_ReadBinaryLine(f);
+    }
+
+    _encas_empty_aabb(&mesh_arr->bounds);
+
+    u32 part_idx = 0;
+    while (Encas_Str_StartsWith(line, Encas_Str_Lit("part")) && part_idx < mesh_info->len) {
+        Encas_Mesh *mesh = mesh_arr->elems[part_idx];
+
+        mesh->part_number = Encas_ReadS32(f);
+
+        // Skip description line
+        Encas_FileAdvace(f, 80);
+
+        Encas_MeshInfoPart *minfo_part = &mesh_info->parts[part_idx];
+
+        // The ids of the kept ghost cells follow the ids of the owned cells
+        const u64 num_owned_cells = _encas_part_num_cells(minfo_part, false);
+        const u64 num_ghost_cells = keep_ghosts ? _encas_part_num_cells(minfo_part, true) : 0;
+        u64 elem_ids_ptr = 0, ghost_elem_ids_ptr = num_owned_cells;
+
+        u32 elem_idx = 0, ghost_elem_idx = 0;
+        u32 elem_vert_map_entry_ptr = 0, ghost_elem_vert_map_entry_ptr = 0;
+
+        while (!IS_ENCAS_EOF(f)) {
+            line = Encas_ReadBinaryLine(f);
+            bool is_ghost = false;
+            Encas_Elem_Type elem_type;
+
+            if (Encas_Str_StartsWith(line, Encas_Str_Lit("coordinates"))) {
+                s32 num_of_nodes = Encas_ReadS32(f);
+
+                // The slab is sized from the mesh info
+                if ((u64)num_of_nodes != mesh->vert_array_size) {
+                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: part %d has %d nodes, its mesh info has %llu!\n",
+                              filename, mesh->part_number, num_of_nodes, (unsigned long long)mesh->vert_array_size);
+                    Encas_DeleteMesh(mesh);
+                    Encas_DeleteMeshArray(mesh_arr);
+                    Encas_FreeFile(f);
+                    return NULL;
+                }
+
+                const u64 ids_size = node_id == ENCAS_MODE_GIVEN || node_id == ENCAS_MODE_IGNORE ? (u64)num_of_nodes * sizeof(s32) : 0;
+                if (f->cur + ids_size + 3 * (u64)num_of_nodes * sizeof(float) > f->size) {
+                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: part %d: coordinates are truncated!\n", filename, mesh->part_number);
+                    Encas_DeleteMesh(mesh);
+                    Encas_DeleteMeshArray(mesh_arr);
+                    Encas_FreeFile(f);
+                    return NULL;
+                }
+
+                // Keep given node ids, skip ignored ones
+                if (node_id == ENCAS_MODE_GIVEN)
+                    _encas_copy32(mesh->node_ids, _encas_file_at(f, f->cur, ids_size), num_of_nodes, f->swap);
+                if (node_id == ENCAS_MODE_GIVEN || node_id == ENCAS_MODE_IGNORE)
+                    Encas_FileAdvace(f, num_of_nodes * sizeof(s32));
+
+                // Store coordinates
+/* DEPRECATED
+                for (u32 vert_idx = 0; vert_idx < num_of_nodes; ++vert_idx) {
+                    mesh->vert_array[vert_idx].x = *(float *)(f->buffer + f->cur + vert_idx * sizeof(float));
                     mesh->vert_array[vert_idx].y = *(float *)(f->buffer + f->cur + num_of_nodes * sizeof(float) + vert_idx * sizeof(float));
                     mesh->vert_array[vert_idx].z = *(float *)(f->buffer + f->cur + 2 * num_of_nodes * sizeof(float) + vert_idx * sizeof(float));
                 }
 */
 
-                memcpy(mesh->vert_array.x, f->buffer + f->cur, num_of_nodes * sizeof(float));
-                memcpy(mesh->vert_array.y, f->buffer + f->cur + num_of_nodes * sizeof(float), num_of_nodes * sizeof(float));
-                memcpy(mesh->vert_array.z, f->buffer + f->cur + 2 * num_of_nodes * sizeof(float), num_of_nodes * sizeof(float));
+                float *dst[3] = { mesh->vert_array.x, mesh->vert_array.y, mesh->vert_array.z };
+                for (u32 c = 0; c < 3; ++c)
+                    _encas_copy_minmax(dst[c], _encas_file_at(f, f->cur + c * num_of_nodes * sizeof(float), num_of_nodes * sizeof(float)), num_of_nodes, f->swap,
+                                       &mesh->bounds.min[c], &mesh->bounds.max[c]);
+                if (mesh->vertices)
+                    Encas_InterleaveVertices(&mesh->vert_array, mesh->vert_array_size, mesh->vertices, mesh->vertex_layout);
 
                 Encas_FileAdvace(f, 3 * num_of_nodes * sizeof(float));
             }
 
             else if (Encas_Str_StartsWith(line, Encas_Str_Lit("block"))) {
-                Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Structured data is not implemented yet! (block keyword)\n");
-                Encas_DeleteMeshArray(mesh_arr);
-                Encas_FreeFile(f);
-                return NULL;
+                if (mesh->elem_array_size != 1 || !_encas_read_block(f, line, node_id, element_id, mesh, (u64)minfo_part->elem_sizes[0])) {
+                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: invalid block part!\n", filename);
+                    Encas_DeleteMesh(mesh);
+                    Encas_DeleteMeshArray(mesh_arr);
+                    Encas_FreeFile(f);
+                    return NULL;
+                }
+                if (mesh->vertices)
+                    Encas_InterleaveVertices(&mesh->vert_array, mesh->vert_array_size, mesh->vertices, mesh->vertex_layout);
             }
 
             // Element type
             else if ((elem_type = Encas_ReadElemType(line, &is_ghost)) != ENCAS_ELEM_UNKNOWN) {
                 s32 num_of_elements = Encas_ReadS32(f);
 
-                // Skip element ids
+                // Ghost elems are dropped unless they are kept in their own array
+                bool keep = !is_ghost || keep_ghosts;
+
+                if (num_of_elements < 0 || ((element_id == ENCAS_MODE_GIVEN || element_id == ENCAS_MODE_IGNORE)
+                                            && f->cur + (u64)num_of_elements * sizeof(s32) > f->size)) {
+                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: %s block is truncated!\n", filename, Encas_ElemToCstr(elem_type));
+                    Encas_DeleteMesh(mesh);
+                    Encas_DeleteMeshArray(mesh_arr);
+                    Encas_FreeFile(f);
+                    return NULL;
+                }
+
+                // The slab is sized from the mesh info: the element array, the connectivity and
+                // the ids of a kept block have to fit before anything is written
+                if (keep) {
+                    const u64 num_entries = (u64)num_of_elements * _get_elem_vert_count(elem_type);
+                    const bool fits = (is_ghost ? ghost_elem_idx < mesh->ghost_elem_array_size : elem_idx < mesh->elem_array_size)
+                        && (is_ghost ? ghost_elem_vert_map_entry_ptr + num_entries <= minfo_part->ghost_elem_vert_map_array_size
+                                     : elem_vert_map_entry_ptr + num_entries <= minfo_part->elem_vert_map_array_size)
+                        && (element_id != ENCAS_MODE_GIVEN
+                            || (is_ghost ? ghost_elem_ids_ptr + num_of_elements <= num_owned_cells + num_ghost_cells
+                                         : elem_ids_ptr + num_of_elements <= num_owned_cells));
+                    if (!fits) {
+                        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: part %d: %s block does not match its mesh info!\n",
+                                  filename, mesh->part_number, Encas_ElemToCstr(elem_type));
+                        Encas_DeleteMesh(mesh);
+                        Encas_DeleteMeshArray(mesh_arr);
+                        Encas_FreeFile(f);
+                        return NULL;
+                    }
+                }
+
+                // Keep given element ids of the kept cells, skip ignored ones
+                if (element_id == ENCAS_MODE_GIVEN && keep) {
+                    u64 *ids_ptr = is_ghost ? &ghost_elem_ids_ptr : &elem_ids_ptr;
+                    _encas_copy32(mesh->elem_ids + *ids_ptr, _encas_file_at(f, f->cur, num_of_elements * sizeof(s32)), num_of_elements, f->swap);
+                    *ids_ptr += num_of_elements;
+                }
                 if (element_id == ENCAS_MODE_GIVEN || element_id == ENCAS_MODE_IGNORE)
                     Encas_FileAdvace(f, num_of_elements * sizeof(s32));
 
                 u32 elem_vert_count = _get_elem_vert_count(elem_type);
+                u64 block_size = 0;
+
+                if (keep) {
+                    Encas_Elem *elem = is_ghost ? &mesh->ghost_elem_array[ghost_elem_idx] : &mesh->elem_array[elem_idx];
+                    u32 *vert_map = is_ghost ? mesh->ghost_elem_vert_map_array : mesh->elem_vert_map_array;
+                    u32 *entry_ptr = is_ghost ? &ghost_elem_vert_map_entry_ptr : &elem_vert_map_entry_ptr;
+
+                    elem->type = elem_type;
+                    elem->elem_size = elem_vert_count;
+                    elem->elem_vert_map_size = num_of_elements * elem_vert_count;
+                    elem->elem_vert_map_entry = *entry_ptr;
+                    elem->num_cells = num_of_elements;
+                    elem->is_ghost = is_ghost;
+                    elem->poly = NULL;
+                    *entry_ptr += num_of_elements * elem_vert_count;
+
+                    if (elem_type == ENCAS_ELEM_NSIDED || elem_type == ENCAS_ELEM_NFACED) {
+                        elem->poly = _encas_read_poly_elem(f, filename, elem_type, num_of_elements, (u32)mesh->vert_array_size);
+                        if (elem->poly == NULL) {
+                            Encas_DeleteMesh(mesh);
+                            Encas_DeleteMeshArray(mesh_arr);
+                            Encas_FreeFile(f);
+                            return NULL;
+                        }
+                        block_size = _encas_poly_block_size(elem->poly, num_of_elements);
+                    }
 
-                // ghost elems
-                if (!is_ghost) {
-                    mesh->elem_array[elem_idx].type = elem_type;
-                    mesh->elem_array[elem_idx].elem_size = elem_vert_count;
-                    mesh->elem_array[elem_idx].elem_vert_map_size = num_of_elements * elem_vert_count;
-                    mesh->elem_array[elem_idx].elem_vert_map_entry = elem_vert_map_entry_ptr;
-                    elem_vert_map_entry_ptr += num_of_elements * elem_vert_count;
-
-                    /*
-                    memcpy(mesh->elem_vert_map_array + mesh->elem_array[elem_idx].elem_vert_map_entry,
-                           f->buffer + f->cur,
-                           mesh->elem_array[elem_idx].elem_vert_map_size * sizeof(u32));
-                           */
-
-                    for (u32 i = 0; i < num_of_elements * elem_vert_count; ++i) {
-                        mesh->elem_vert_map_array[mesh->elem_array[elem_idx].elem_vert_map_entry + i] = *((u32 *)(f->buffer + f->cur + sizeof(u32) * i)) - 1;
+                    // 1 based -> 0 based, every index is checked against the nodes of the part
+                    u64 num_entries = (u64)num_of_elements * elem_vert_count;
+                    if (f->cur + num_entries * sizeof(u32) > f->size) {
+                        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: %s block is truncated!\n", filename, Encas_ElemToCstr(elem_type));
+                        Encas_DeleteMesh(mesh);
+                        Encas_DeleteMeshArray(mesh_arr);
+                        Encas_FreeFile(f);
+                        return NULL;
+                    }
+
+                    // Owned cells of narrow parts go straight to the u16 connectivity
+                    const u8 *src = _encas_file_at(f, f->cur, num_entries * sizeof(u32));
+                    u64 bad = vert_map ? _encas_decode_conn(vert_map + elem->elem_vert_map_entry, src, num_entries, (u32)mesh->vert_array_size, f->swap)
+                                       : _encas_decode_conn16((u16 *)mesh->connectivity.data + elem->elem_vert_map_entry, src, num_entries, (u32)mesh->vert_array_size, f->swap);
+                    if (bad < num_entries) {
+                        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: part %d: %s element %llu references node %d, the part has %u nodes!\n",
+                                  filename, mesh->part_number, Encas_ElemToCstr(elem_type), (unsigned long long)(bad / elem_vert_count) + 1,
+                                  (s32)_encas_load_u32(src + bad * sizeof(u32), f->swap), (u32)mesh->vert_array_size);
+                        Encas_DeleteMesh(mesh);
+                        Encas_DeleteMeshArray(mesh_arr);
+                        Encas_FreeFile(f);
+                        return NULL;
                     }
 
-                    ++elem_idx;
+                    if (is_ghost)
+                        ++ghost_elem_idx;
+                    else
+                        ++elem_idx;
                 }
 
-                Encas_FileAdvace(f, num_of_elements * elem_vert_count * sizeof(s32));
+                if (!block_size)
+                    block_size = _encas_elem_block_size(f, elem_type, num_of_elements);
+                Encas_FileAdvace(f, block_size);
             }
 
             else {
@@ -2604,6 +4981,7 @@ ENCAS_API Encas_MeshArray *Encas_ReadGeometry(Encas_MeshInfo *mesh_info, char *f
         // Part end
         //u32 part_idx = mesh_arr->len;
         //Encas_InsertHashTable(mesh_arr->part_num_lookup, mesh->part_number, part_idx);
+        _encas_merge_aabb(&mesh_arr->bounds, &mesh->bounds);
         Encas_PushMeshArray(mesh_arr, mesh);
         part_idx++;
     }
@@ -2613,6 +4991,12 @@ ENCAS_API Encas_MeshArray *Encas_ReadGeometry(Encas_MeshInfo *mesh_info, char *f
 }
 
 ENCAS_API Encas_MeshArray *Encas_LoadGeometry(Encas_Case *encase, u32 time_value_idx) {
+    return Encas_LoadGeometryEx(encase, time_value_idx, NULL);
+}
+
+// Builds the path of the model geometry file of the time step into geo_filename (PATH_MAX + 1 bytes),
+// returns its mesh info or NULL
+static Encas_MeshInfo *_encas_model_geometry_filename(Encas_Case *encase, u32 time_value_idx, char *geo_filename) {
     if (time_value_idx > encase->geometry->model->num_of_files - 1)
         time_value_idx = 0;
 
@@ -2620,7 +5004,6 @@ ENCAS_API Encas_MeshArray *Encas_LoadGeometry(Encas_Case *encase, u32 time_value
     Encas_MeshInfo *mesh_info = NULL;
 
     u32 dirname_length = strlen(encase->dirname);
-    char geo_filename[PATH_MAX + 1];
     memcpy(geo_filename, encase->dirname, dirname_length);
     memcpy(geo_filename + dirname_length, "/", 1);
 
@@ -2633,7 +5016,7 @@ ENCAS_API Encas_MeshArray *Encas_LoadGeometry(Encas_Case *encase, u32 time_value
             geo_filename[dirname_length + 1 + gelem->filename.len] = '\0';
             mesh_info = &gelem->mesh_info_array.elems[0];
             Encas_Log(ENCAS_LOG_LEVEL_INFO, "Geometry filename: %s\n", geo_filename);
-            return Encas_ReadGeometry(mesh_info, geo_filename);
+            return mesh_info;
         }
     }
 
@@ -2663,7 +5046,7 @@ ENCAS_API Encas_MeshArray *Encas_LoadGeometry(Encas_Case *encase, u32 time_value
         memcpy(geo_filename + dirname_length + 1, gelem->filename.buffer, gelem->filename.len);
         geo_filename[dirname_length + 1 + gelem->filename.len] = '\0';
         mesh_info = &gelem->mesh_info_array.elems[0];
-        return Encas_ReadGeometry(mesh_info, geo_filename);
+        return mesh_info;
     }
 
     u32 asterisk_count = 1;
@@ -2687,285 +5070,2055 @@ ENCAS_API Encas_MeshArray *Encas_LoadGeometry(Encas_Case *encase, u32 time_value
 
     memcpy(geo_filename + dirname_length + 1 + asterisk_idx, tmp, tmp_len);
 
-    return Encas_ReadGeometry(mesh_info, geo_filename);
+    return mesh_info;
 }
 
-ENCAS_API u32 Encas_GetCellTrianglesCount(Encas_Elem_Type cell_type) {
-    switch (cell_type) {
-        case ENCAS_ELEM_TRIA3:
-            return 1;
-        case ENCAS_ELEM_TRIA6:
-            return 4;
-        case ENCAS_ELEM_QUAD4:
-            return 2;
-        case ENCAS_ELEM_QUAD8:
-            return 6;
-        case ENCAS_ELEM_TETRA4:
-            return 4;
-        case ENCAS_ELEM_TETRA10:
-            return 16;
-        case ENCAS_ELEM_PYRAMID5:
-            return 6;
-        case ENCAS_ELEM_PYRAMID13:
-            return 22;
-        case ENCAS_ELEM_PENTA6:
-            return 8;
-        case ENCAS_ELEM_PENTA15:
-            return 26;
-        case ENCAS_ELEM_HEXA8:
-            return 12;
-        case ENCAS_ELEM_HEXA20:
-            return 36;
+ENCAS_API Encas_MeshArray *Encas_LoadGeometryEx(Encas_Case *encase, u32 time_value_idx, const Encas_GeometryOptions *options) {
+    char geo_filename[PATH_MAX + 1];
+    Encas_MeshInfo *mesh_info = _encas_model_geometry_filename(encase, time_value_idx, geo_filename);
+    if (mesh_info == NULL)
+        return NULL;
 
-        case ENCAS_ELEM_NSIDED:
-        case ENCAS_ELEM_NFACED:
-        case ENCAS_ELEM_UNKNOWN:
-        default:
-            return 0;
-    }
+    return Encas_ReadGeometryEx(mesh_info, geo_filename, options);
 }
 
-ENCAS_API void Encas_TriangulateTria3s(u32 *elem_vert_map_array, u32 num_cells, u32 *faces, u64 *faces_offset, u64 vert_offset) {
-    u64 local_faces_offset = *faces_offset;
+// Compares the fingerprints of the model geometry files of two time steps, so a caller
+// moving between them only reloads what differs. Like Encas_LoadGeometry, out of range
+// steps fall back to the first file.
+ENCAS_API Encas_GeometryChange Encas_GeometryStepChange(Encas_Case *encase, u32 from_time_value_idx, u32 to_time_value_idx) {
+    Encas_MeshInfoArray *arr = &encase->geometry->model->mesh_info_array;
+    if (from_time_value_idx >= arr->len)
+        from_time_value_idx = 0;
+    if (to_time_value_idx >= arr->len)
+        to_time_value_idx = 0;
+
+    const Encas_MeshInfo *from = &arr->elems[from_time_value_idx];
+    const Encas_MeshInfo *to = &arr->elems[to_time_value_idx];
+    if (from == to)
+        return ENCAS_GEOMETRY_UNCHANGED;
+
+    if (!_encas_same_mesh_info_parts(from, to))
+        return ENCAS_GEOMETRY_CHANGED;
+
+    if (from->coords_hash != to->coords_hash
+        || from->has_extents != to->has_extents
+        || (from->has_extents && memcmp(&from->extents, &to->extents, sizeof(Encas_AABB)) != 0))
+        return ENCAS_GEOMETRY_COORDS_CHANGED;
+
+    return ENCAS_GEOMETRY_UNCHANGED;
+}
 
-    for (u32 cell_idx = 0; cell_idx < num_cells; ++cell_idx) {
-        faces[local_faces_offset + 0] = elem_vert_map_array[cell_idx * 3 + 0] + vert_offset;
-        faces[local_faces_offset + 1] = elem_vert_map_array[cell_idx * 3 + 1] + vert_offset;
-        faces[local_faces_offset + 2] = elem_vert_map_array[cell_idx * 3 + 2] + vert_offset;
+// Overwrites the coordinates of mesh with the ones of a geometry file that has the same
+// topology (see Encas_GeometryStepChange). The vertex arrays are reused, connectivity and
+// element arrays are left alone, nothing is allocated. Given node ids are copied as well
+// (Encas_GetNodeIdIndex is rebuilt on its next call if they differ), element ids are kept.
+// Block parts are part of the topology fingerprint, so they never change here.
+// On a truncated file the coordinates of mesh are left partially updated.
+ENCAS_API bool Encas_ReadGeometryCoords(Encas_MeshInfo *mesh_info, char *filename, Encas_MeshArray *mesh) {
+    if (mesh->len != mesh_info->len || mesh->topology_hash == 0 || mesh->topology_hash != mesh_info->topology_hash) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' has a different topology than the mesh, it has to be loaded with Encas_LoadGeometry!\n", filename);
+        return false;
+    }
+
+    if (!check_if_file_exists(filename)) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Cannot open %s geometry file\n", filename);
+        return false;
+    }
+
+    Encas_File *f = _encas_open_gold_file(filename, true);
+    if (!f)
+        return false;
+
+    const Encas_Mode node_id = mesh_info->node_id_mode;
+    const Encas_Mode element_id = mesh_info->element_id_mode;
+
+    // C Binary, the two description lines, node id and element id
+    if (!Encas_Str_StartsWith(Encas_ReadBinaryLine(f), Encas_Str_Lit("C Binary")) || !Encas_FileAdvace(f, 4 * 80)) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' is not in C Binary form!\n", filename);
+        Encas_FreeFile(f);
+        return false;
+    }
+    _encas_detect_byte_order(f, NULL);
+
+    Encas_Str line = Encas_ReadBinaryLine(f);
+    mesh->has_extents = false;
+    if (Encas_Str_StartsWith(line, Encas_Str_Lit("extents"))) {
+        mesh->has_extents = true;
+        _encas_read_extents(f, &mesh->extents);
+        line = Encas_ReadBinaryLine(f);
+    }
+
+    _encas_empty_aabb(&mesh->bounds);
+
+    u32 part_idx = 0;
+    while (Encas_Str_StartsWith(line, Encas_Str_Lit("part")) && part_idx < mesh->len) {
+        Encas_Mesh *mesh_part = mesh->elems[part_idx];
+        Encas_ReadS32(f);
+        Encas_FileAdvace(f, 80);
+
+        while (!IS_ENCAS_EOF(f)) {
+            line = Encas_ReadBinaryLine(f);
+            bool is_ghost = false;
+            Encas_Elem_Type elem_type;
+
+            if (Encas_Str_StartsWith(line, Encas_Str_Lit("coordinates"))) {
+                s32 num_of_nodes = Encas_ReadS32(f);
+                const u64 ids_size = node_id == ENCAS_MODE_GIVEN || node_id == ENCAS_MODE_IGNORE ? (u64)num_of_nodes * sizeof(s32) : 0;
+
+                if ((u64)num_of_nodes != mesh_part->vert_array_size || f->cur + ids_size + 3 * (u64)num_of_nodes * sizeof(float) > f->size) {
+                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file: part %d: cannot read %d coordinates!\n", filename, mesh_part->part_number, num_of_nodes);
+                    Encas_FreeFile(f);
+                    return false;
+                }
+
+                // Given ids are taken from the file too, the cached id index is dropped if they changed
+                if (node_id == ENCAS_MODE_GIVEN && mesh_part->node_ids) {
+                    const u8 *ids = _encas_file_at(f, f->cur, ids_size);
+                    u64 i = 0;
+                    while (i < (u64)num_of_nodes && (s32)_encas_load_u32(ids + i * sizeof(s32), f->swap) == mesh_part->node_ids[i])
+                        ++i;
+                    if (i < (u64)num_of_nodes) {
+                        _encas_copy32(mesh_part->node_ids, ids, num_of_nodes, f->swap);
+                        if (mesh_part->node_id_index) {
+                            Encas_DeleteIdIndex(mesh_part->node_id_index);
+                            ENCAS_FREE(mesh_part->node_id_index);
+                            mesh_part->node_id_index = NULL;
+                        }
+                    }
+                }
+                Encas_FileAdvace(f, ids_size);
+
+                float *dst[3] = { mesh_part->vert_array.x, mesh_part->vert_array.y, mesh_part->vert_array.z };
+                for (u32 c = 0; c < 3; ++c)
+                    _encas_copy_minmax(dst[c], _encas_file_at(f, f->cur + c * num_of_nodes * sizeof(float), num_of_nodes * sizeof(float)), num_of_nodes, f->swap,
+                                       &mesh_part->bounds.min[c], &mesh_part->bounds.max[c]);
+                if (mesh_part->vertices)
+                    Encas_InterleaveVertices(&mesh_part->vert_array, mesh_part->vert_array_size, mesh_part->vertices, mesh_part->vertex_layout);
+
+                Encas_FileAdvace(f, 3 * num_of_nodes * sizeof(float));
+            }
+
+            else if (Encas_Str_StartsWith(line, Encas_Str_Lit("block"))) {
+                Encas_Block block;
+                _encas_skip_block(f, line, node_id, element_id, &block);
+            }
+
+            else if ((elem_type = Encas_ReadElemType(line, &is_ghost)) != ENCAS_ELEM_UNKNOWN) {
+                s32 num_of_elements = Encas_ReadS32(f);
+                if (element_id == ENCAS_MODE_GIVEN || element_id == ENCAS_MODE_IGNORE)
+                    Encas_FileAdvace(f, num_of_elements * sizeof(s32));
+                Encas_FileAdvace(f, _encas_elem_block_size(f, elem_type, num_of_elements));
+            }
+
+            else {
+                break;
+            }
+        }
+
+        _encas_merge_aabb(&mesh->bounds, &mesh_part->bounds);
+        part_idx++;
+    }
+
+    Encas_FreeFile(f);
+    mesh->coords_hash = mesh_info->coords_hash;
+    return true;
+}
+
+// Moves mesh, loaded from an other time step, to time_value_idx by overwriting its coordinates
+// in place. Fails without touching mesh if the topology of the two steps differs.
+ENCAS_API bool Encas_UpdateGeometryCoords(Encas_Case *encase, Encas_MeshArray *mesh, u32 time_value_idx) {
+    char geo_filename[PATH_MAX + 1];
+    Encas_MeshInfo *mesh_info = _encas_model_geometry_filename(encase, time_value_idx, geo_filename);
+    if (mesh_info == NULL)
+        return false;
+
+    // Same file content, nothing to copy
+    if (mesh->topology_hash != 0 && mesh->topology_hash == mesh_info->topology_hash && mesh->coords_hash == mesh_info->coords_hash
+        && mesh->has_extents == mesh_info->has_extents
+        && (!mesh->has_extents || memcmp(&mesh->extents, &mesh_info->extents, sizeof(Encas_AABB)) == 0))
+        return true;
+
+    return Encas_ReadGeometryCoords(mesh_info, geo_filename, mesh);
+}
+
+ENCAS_API u32 Encas_GetCellTrianglesCount(Encas_Elem_Type cell_type) {
+    switch (cell_type) {
+        case ENCAS_ELEM_TRIA3:
+            return 1;
+        case ENCAS_ELEM_TRIA6:
+            return 4;
+        case ENCAS_ELEM_QUAD4:
+            return 2;
+        case ENCAS_ELEM_QUAD8:
+            return 6;
+        case ENCAS_ELEM_TETRA4:
+            return 4;
+        case ENCAS_ELEM_TETRA10:
+            return 16;
+        case ENCAS_ELEM_PYRAMID5:
+            return 6;
+        case ENCAS_ELEM_PYRAMID13:
+            return 22;
+        case ENCAS_ELEM_PENTA6:
+            return 8;
+        case ENCAS_ELEM_PENTA15:
+            return 26;
+        case ENCAS_ELEM_HEXA8:
+            return 12;
+        case ENCAS_ELEM_HEXA20:
+            return 36;
+
+        case ENCAS_ELEM_NSIDED:
+        case ENCAS_ELEM_NFACED:
+        case ENCAS_ELEM_UNKNOWN:
+        default:
+            return 0;
+    }
+}
+
+ENCAS_API void Encas_TriangulateTria3s(u32 *elem_vert_map_array, u32 num_cells, u32 *faces, u64 *faces_offset, u64 vert_offset) {
+    u64 local_faces_offset = *faces_offset;
+
+    for (u32 cell_idx = 0; cell_idx < num_cells; ++cell_idx) {
+        faces[local_faces_offset + 0] = elem_vert_map_array[cell_idx * 3 + 0] + vert_offset;
+        faces[local_faces_offset + 1] = elem_vert_map_array[cell_idx * 3 + 1] + vert_offset;
+        faces[local_faces_offset + 2] = elem_vert_map_array[cell_idx * 3 + 2] + vert_offset;
+
+        local_faces_offset += 3;
+    }
+
+    *faces_offset = local_faces_offset;
+}
+
+ENCAS_API void Encas_TriangulateTetra4s(u32 *elem_vert_map_array, u32 num_cells, u32 *faces, u64 *faces_offset, u64 vert_offset) {
+    u64 local_faces_offset = *faces_offset;
+
+    for (u32 cell_idx = 0; cell_idx < num_cells; ++cell_idx) {
+        faces[local_faces_offset + 0] = elem_vert_map_array[cell_idx * 4 + 0] + vert_offset;
+        faces[local_faces_offset + 1] = elem_vert_map_array[cell_idx * 4 + 1] + vert_offset;
+        faces[local_faces_offset + 2] = elem_vert_map_array[cell_idx * 4 + 2] + vert_offset;
+
+        local_faces_offset += 3;
+
+        faces[local_faces_offset + 0] = elem_vert_map_array[cell_idx * 4 + 0] + vert_offset;
+        faces[local_faces_offset + 1] = elem_vert_map_array[cell_idx * 4 + 1] + vert_offset;
+        faces[local_faces_offset + 2] = elem_vert_map_array[cell_idx * 4 + 3] + vert_offset;
+
+        local_faces_offset += 3;
+
+        faces[local_faces_offset + 0] = elem_vert_map_array[cell_idx * 4 + 1] + vert_offset;
+        faces[local_faces_offset + 1] = elem_vert_map_array[cell_idx * 4 + 2] + vert_offset;
+        faces[local_faces_offset + 2] = elem_vert_map_array[cell_idx * 4 + 3] + vert_offset;
+
+        local_faces_offset += 3;
+
+        faces[local_faces_offset + 0] = elem_vert_map_array[cell_idx * 4 + 0] + vert_offset;
+        faces[local_faces_offset + 1] = elem_vert_map_array[cell_idx * 4 + 2] + vert_offset;
+        faces[local_faces_offset + 2] = elem_vert_map_array[cell_idx * 4 + 3] + vert_offset;
+
+        local_faces_offset += 3;
+    }
+
+    *faces_offset = local_faces_offset;
+}
+
+// Faces of the linear cells in EnSight node order (outward normals).
+// A quad face covers two consecutive triangles of Encas_GetCellTrianglesCount,
+// so the global triangle indices are the same in every shell mode.
+typedef struct Encas_CellFace {
+    u8 count; // 3 or 4
+    u8 v[4];
+} Encas_CellFace;
+
+static const Encas_CellFace _encas_quad4_faces[] = {
+    { 4, { 0, 1, 2, 3 } },
+};
+
+static const Encas_CellFace _encas_pyramid5_faces[] = {
+    { 4, { 0, 3, 2, 1 } },
+    { 3, { 0, 1, 4, 0 } },
+    { 3, { 1, 2, 4, 0 } },
+    { 3, { 2, 3, 4, 0 } },
+    { 3, { 3, 0, 4, 0 } },
+};
+
+static const Encas_CellFace _encas_penta6_faces[] = {
+    { 3, { 0, 2, 1, 0 } },
+    { 3, { 3, 4, 5, 0 } },
+    { 4, { 0, 1, 4, 3 } },
+    { 4, { 1, 2, 5, 4 } },
+    { 4, { 2, 0, 3, 5 } },
+};
+
+static const Encas_CellFace _encas_hexa8_faces[] = {
+    { 4, { 0, 3, 2, 1 } },
+    { 4, { 4, 5, 6, 7 } },
+    { 4, { 0, 1, 5, 4 } },
+    { 4, { 1, 2, 6, 5 } },
+    { 4, { 2, 3, 7, 6 } },
+    { 4, { 3, 0, 4, 7 } },
+};
+
+static const Encas_CellFace *_encas_get_cell_faces(Encas_Elem_Type cell_type, u32 *num_faces) {
+    switch (cell_type) {
+        case ENCAS_ELEM_QUAD4:
+            *num_faces = sizeof(_encas_quad4_faces) / sizeof(Encas_CellFace);
+            return _encas_quad4_faces;
+        case ENCAS_ELEM_PYRAMID5:
+            *num_faces = sizeof(_encas_pyramid5_faces) / sizeof(Encas_CellFace);
+            return _encas_pyramid5_faces;
+        case ENCAS_ELEM_PENTA6:
+            *num_faces = sizeof(_encas_penta6_faces) / sizeof(Encas_CellFace);
+            return _encas_penta6_faces;
+        case ENCAS_ELEM_HEXA8:
+            *num_faces = sizeof(_encas_hexa8_faces) / sizeof(Encas_CellFace);
+            return _encas_hexa8_faces;
+        default:
+            *num_faces = 0;
+            return NULL;
+    }
+}
+
+// Splits the quad a b c d into two triangles along the diagonal through its smallest vertex index,
+// so the two cells sharing a quad face emit the same triangles whatever node they start it from
+force_inline void _encas_split_quad(u32 *dst, u32 a, u32 b, u32 c, u32 d) {
+    if ((a < c ? a : c) <= (b < d ? b : d)) {
+        dst[0] = a; dst[1] = b; dst[2] = c;
+        dst[3] = a; dst[4] = c; dst[5] = d;
+    } else {
+        dst[0] = b; dst[1] = c; dst[2] = d;
+        dst[3] = b; dst[4] = d; dst[5] = a;
+    }
+}
+
+// Splits every face of the cells into triangles, quads with _encas_split_quad
+static void _encas_triangulate_cells(Encas_Elem_Type cell_type, u32 *elem_vert_map_array, u32 num_cells, u32 *faces, u64 *faces_offset, u64 vert_offset) {
+    u64 local_faces_offset = *faces_offset;
+    u32 vert_count = _get_elem_vert_count(cell_type);
+    u32 num_cell_faces;
+    const Encas_CellFace *cell_faces = _encas_get_cell_faces(cell_type, &num_cell_faces);
+
+    for (u32 cell_idx = 0; cell_idx < num_cells; ++cell_idx) {
+        const u32 *cell = elem_vert_map_array + (u64)cell_idx * vert_count;
+
+        for (u32 face_idx = 0; face_idx < num_cell_faces; ++face_idx) {
+            const Encas_CellFace *face = cell_faces + face_idx;
+
+            if (face->count == 4) {
+                _encas_split_quad(faces + local_faces_offset, (u32)(cell[face->v[0]] + vert_offset), (u32)(cell[face->v[1]] + vert_offset),
+                                  (u32)(cell[face->v[2]] + vert_offset), (u32)(cell[face->v[3]] + vert_offset));
+                local_faces_offset += 6;
+                continue;
+            }
+
+            faces[local_faces_offset + 0] = cell[face->v[0]] + vert_offset;
+            faces[local_faces_offset + 1] = cell[face->v[1]] + vert_offset;
+            faces[local_faces_offset + 2] = cell[face->v[2]] + vert_offset;
+            local_faces_offset += 3;
+        }
+    }
+
+    *faces_offset = local_faces_offset;
+}
+
+ENCAS_API void Encas_TriangulateQuad4s(u32 *elem_vert_map_array, u32 num_cells, u32 *faces, u64 *faces_offset, u64 vert_offset) {
+    _encas_triangulate_cells(ENCAS_ELEM_QUAD4, elem_vert_map_array, num_cells, faces, faces_offset, vert_offset);
+}
+
+ENCAS_API void Encas_TriangulatePyramid5s(u32 *elem_vert_map_array, u32 num_cells, u32 *faces, u64 *faces_offset, u64 vert_offset) {
+    _encas_triangulate_cells(ENCAS_ELEM_PYRAMID5, elem_vert_map_array, num_cells, faces, faces_offset, vert_offset);
+}
+
+ENCAS_API void Encas_TriangulatePenta6s(u32 *elem_vert_map_array, u32 num_cells, u32 *faces, u64 *faces_offset, u64 vert_offset) {
+    _encas_triangulate_cells(ENCAS_ELEM_PENTA6, elem_vert_map_array, num_cells, faces, faces_offset, vert_offset);
+}
+
+ENCAS_API void Encas_TriangulateHexa8s(u32 *elem_vert_map_array, u32 num_cells, u32 *faces, u64 *faces_offset, u64 vert_offset) {
+    _encas_triangulate_cells(ENCAS_ELEM_HEXA8, elem_vert_map_array, num_cells, faces, faces_offset, vert_offset);
+}
+
+// Number of triangle and quad faces of a cell in ENCAS_SHELL_MODE_QUADS
+// (num_trias + 2 * num_quads == Encas_GetCellTrianglesCount for the supported types)
+ENCAS_API void Encas_GetCellFacesCount(Encas_Elem_Type cell_type, u32 *num_trias, u32 *num_quads) {
+    *num_trias = 0;
+    *num_quads = 0;
+
+    switch (cell_type) {
+        case ENCAS_ELEM_TRIA3:
+            *num_trias = 1;
+            break;
+        case ENCAS_ELEM_TETRA4:
+            *num_trias = 4;
+            break;
+        case ENCAS_ELEM_QUAD4:
+        case ENCAS_ELEM_PYRAMID5:
+        case ENCAS_ELEM_PENTA6:
+        case ENCAS_ELEM_HEXA8: {
+            u32 num_cell_faces;
+            const Encas_CellFace *cell_faces = _encas_get_cell_faces(cell_type, &num_cell_faces);
+            for (u32 face_idx = 0; face_idx < num_cell_faces; ++face_idx) {
+                if (cell_faces[face_idx].count == 4)
+                    ++*num_quads;
+                else
+                    ++*num_trias;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// Emits the faces of the cells into separate triangle and quad lists, keeping
+// the global triangle index of every face (a quad stores its first triangle's index)
+static void _encas_extract_cell_faces(Encas_Elem_Type cell_type, u32 *elem_vert_map_array, u32 num_cells, u64 vert_offset, u64 global_offset,
+                                      u32 *trias, u32 *tria_global_idx, u64 *trias_offset,
+                                      u32 *quads, u32 *quad_global_idx, u64 *quads_offset) {
+    u64 local_trias_offset = *trias_offset;
+    u64 local_quads_offset = *quads_offset;
+    u32 vert_count = _get_elem_vert_count(cell_type);
+
+    if (cell_type == ENCAS_ELEM_TRIA3 || cell_type == ENCAS_ELEM_TETRA4) {
+        u64 tria_offset = 3 * local_trias_offset;
+        if (cell_type == ENCAS_ELEM_TRIA3)
+            Encas_TriangulateTria3s(elem_vert_map_array, num_cells, trias, &tria_offset, vert_offset);
+        else
+            Encas_TriangulateTetra4s(elem_vert_map_array, num_cells, trias, &tria_offset, vert_offset);
+
+        u64 num_trias = tria_offset / 3 - local_trias_offset;
+        for (u64 i = 0; i < num_trias; ++i)
+            tria_global_idx[local_trias_offset + i] = global_offset + i;
+
+        *trias_offset = local_trias_offset + num_trias;
+        return;
+    }
+
+    u32 num_cell_faces;
+    const Encas_CellFace *cell_faces = _encas_get_cell_faces(cell_type, &num_cell_faces);
+    if (cell_faces == NULL)
+        return;
+
+    u64 global_idx = global_offset;
+    for (u32 cell_idx = 0; cell_idx < num_cells; ++cell_idx) {
+        const u32 *cell = elem_vert_map_array + (u64)cell_idx * vert_count;
+
+        for (u32 face_idx = 0; face_idx < num_cell_faces; ++face_idx) {
+            const Encas_CellFace *face = cell_faces + face_idx;
+
+            if (face->count == 4) {
+                quads[4 * local_quads_offset + 0] = cell[face->v[0]] + vert_offset;
+                quads[4 * local_quads_offset + 1] = cell[face->v[1]] + vert_offset;
+                quads[4 * local_quads_offset + 2] = cell[face->v[2]] + vert_offset;
+                quads[4 * local_quads_offset + 3] = cell[face->v[3]] + vert_offset;
+                quad_global_idx[local_quads_offset++] = global_idx;
+                global_idx += 2;
+            } else {
+                trias[3 * local_trias_offset + 0] = cell[face->v[0]] + vert_offset;
+                trias[3 * local_trias_offset + 1] = cell[face->v[1]] + vert_offset;
+                trias[3 * local_trias_offset + 2] = cell[face->v[2]] + vert_offset;
+                tria_global_idx[local_trias_offset++] = global_idx;
+                global_idx += 1;
+            }
+        }
+    }
+
+    *trias_offset = local_trias_offset;
+    *quads_offset = local_quads_offset;
+}
+
+force_inline void sort3(u32 *a, u32 *b, u32 *c) {
+    if (*a > *b) { u32 t = *a; *a = *b; *b = t; }
+    if (*b > *c) { u32 t = *b; *b = *c; *c = t; }
+    if (*a > *b) { u32 t = *a; *a = *b; *b = t; }
+}
+
+force_inline void sort4(u32 *v) {
+    if (v[0] > v[1]) { u32 t = v[0]; v[0] = v[1]; v[1] = t; }
+    if (v[2] > v[3]) { u32 t = v[2]; v[2] = v[3]; v[3] = t; }
+    if (v[0] > v[2]) { u32 t = v[0]; v[0] = v[2]; v[2] = t; }
+    if (v[1] > v[3]) { u32 t = v[1]; v[1] = v[3]; v[3] = t; }
+    if (v[1] > v[2]) { u32 t = v[1]; v[1] = v[2]; v[2] = t; }
+}
+
+ENCAS_API void Encas_LoadGeometryShell(Encas_Case *encase, Encas_MeshArray *mesh, Encas_ShellParams *params) {
+    Encas_ShellOptions options;
+    memset(&options, 0, sizeof(Encas_ShellOptions));
+
+    Encas_LoadGeometryShellEx(encase, mesh, params, &options);
+}
+
+#define ENCAS_SHELL_CHUNK_CELLS 16384
+#define ENCAS_SHELL_PARTITIONS 64 // Power of two, the face map is split into this many independent maps
+
+// A run of cells of one element block, the unit of work of the shell builder.
+// Every output offset is known up front from the per-cell face counts, so the
+// chunks can be triangulated independently.
+typedef struct Encas_ShellChunk {
+    u32 part_idx;
+    u32 elem_idx;
+    u32 cell_begin;
+    u32 num_cells;
+    u32 cell_offset;   // First cell of the chunk within its part
+    u64 vert_offset;   // First global vertex index of the part
+    u64 global_offset; // First global triangle index of the chunk
+    u64 trias_offset;  // First triangle face of the chunk in ENCAS_SHELL_MODE_QUADS
+    u64 quads_offset;  // First quad face of the chunk in ENCAS_SHELL_MODE_QUADS
+} Encas_ShellChunk;
+
+// Splits every element block into chunks and prefix-sums the face counts
+static Encas_ShellChunk *_encas_create_shell_chunks(Encas_MeshArray *mesh, u32 *num_chunks_out, u64 *num_faces_out, u64 *num_trias_out, u64 *num_quads_out) {
+    u32 num_chunks = 0;
+    for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx) {
+        Encas_Mesh *mesh_part = mesh->elems[part_idx];
+
+        for (u32 elem_idx = 0; elem_idx < mesh_part->elem_array_size; ++elem_idx) {
+            u32 num_of_cells = mesh_part->elem_array[elem_idx].num_cells;
+            num_chunks += (num_of_cells + ENCAS_SHELL_CHUNK_CELLS - 1) / ENCAS_SHELL_CHUNK_CELLS;
+        }
+    }
+
+    Encas_ShellChunk *chunks = (Encas_ShellChunk *)ENCAS_MALLOC((num_chunks + 1) * sizeof(Encas_ShellChunk));
+
+    u32 chunk_idx = 0;
+    u64 vert_offset = 0, global_offset = 0, trias_offset = 0, quads_offset = 0;
+    for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx) {
+        Encas_Mesh *mesh_part = mesh->elems[part_idx];
+        u32 part_cell_offset = 0;
+
+        for (u32 elem_idx = 0; elem_idx < mesh_part->elem_array_size; ++elem_idx) {
+            Encas_Elem_Type type = mesh_part->elem_array[elem_idx].type;
+            u32 num_of_cells = mesh_part->elem_array[elem_idx].num_cells;
+            u32 cell_triangles = Encas_GetCellTrianglesCount(type);
+            u32 cell_trias, cell_quads;
+            Encas_GetCellFacesCount(type, &cell_trias, &cell_quads);
+
+            for (u32 cell_begin = 0; cell_begin < num_of_cells; cell_begin += ENCAS_SHELL_CHUNK_CELLS) {
+                Encas_ShellChunk *chunk = chunks + chunk_idx++;
+                chunk->part_idx = part_idx;
+                chunk->elem_idx = elem_idx;
+                chunk->cell_begin = cell_begin;
+                chunk->num_cells = num_of_cells - cell_begin < ENCAS_SHELL_CHUNK_CELLS ? num_of_cells - cell_begin : ENCAS_SHELL_CHUNK_CELLS;
+                chunk->cell_offset = part_cell_offset + cell_begin;
+                chunk->vert_offset = vert_offset;
+                chunk->global_offset = global_offset;
+                chunk->trias_offset = trias_offset;
+                chunk->quads_offset = quads_offset;
+
+                global_offset += (u64)chunk->num_cells * cell_triangles;
+                trias_offset += (u64)chunk->num_cells * cell_trias;
+                quads_offset += (u64)chunk->num_cells * cell_quads;
+            }
+
+            part_cell_offset += num_of_cells;
+        }
+
+        vert_offset += mesh_part->vert_array_size;
+    }
+
+    *num_chunks_out = num_chunks;
+    *num_faces_out = global_offset;
+    *num_trias_out = trias_offset;
+    *num_quads_out = quads_offset;
+    return chunks;
+}
+
+// u32 connectivity of the cells [cell_begin, cell_begin + num_cells) of an element block. Blocks and
+// u16 parts that were not expanded get only those cells, in *block_cells, which the caller frees.
+static u32 *_encas_elem_cells(const Encas_Mesh *mesh_part, const Encas_Elem *elem, u32 cell_begin, u32 num_cells, u32 **block_cells) {
+    return _encas_cells_u32(mesh_part, elem->elem_vert_map_entry + (u64)cell_begin * elem->elem_size, (u64)num_cells * elem->elem_size, block_cells);
+}
+
+static u32 *_encas_shell_chunk_cells(Encas_MeshArray *mesh, Encas_ShellChunk *chunk, u32 **block_cells) {
+    Encas_Mesh *mesh_part = mesh->elems[chunk->part_idx];
+    return _encas_elem_cells(mesh_part, &mesh_part->elem_array[chunk->elem_idx], chunk->cell_begin, chunk->num_cells, block_cells);
+}
+
+// Invalidates the faces a hexa8 block chunk shares between two of its cells, only the six
+// i/j/k sheets of a block can be on the boundary. faces holds face_size indices per cell face,
+// six per cell in _encas_hexa8_faces order.
+static void _encas_drop_block_interior_faces(Encas_MeshArray *mesh, const Encas_ShellChunk *chunk, u32 *faces, u32 face_size) {
+    const Encas_Mesh *mesh_part = mesh->elems[chunk->part_idx];
+    if (mesh_part->block == NULL || mesh_part->elem_array[chunk->elem_idx].type != ENCAS_ELEM_HEXA8)
+        return;
+
+    // Axis and side of the neighbour cell behind every hexa8 face
+    static const s8 face_sides[6][2] = { {2, -1}, {2, 1}, {1, -1}, {0, 1}, {1, 1}, {0, -1} };
+    u32 cell_dims[3];
+    Encas_BlockCellDims(mesh_part->block, cell_dims);
+
+    for (u32 cell = 0; cell < chunk->num_cells; ++cell) {
+        const u64 cell_idx = (u64)chunk->cell_begin + cell;
+        const u32 ijk[3] = {
+            (u32)(cell_idx % cell_dims[0]),
+            (u32)(cell_idx / cell_dims[0] % cell_dims[1]),
+            (u32)(cell_idx / cell_dims[0] / cell_dims[1]),
+        };
+
+        for (u32 face = 0; face < 6; ++face) {
+            const u32 axis = face_sides[face][0];
+            const bool interior = face_sides[face][1] < 0 ? ijk[axis] > 0 : ijk[axis] + 1 < cell_dims[axis];
+            if (interior)
+                memset(faces + ((u64)cell * 6 + face) * face_size, 0xFF, face_size * sizeof(u32));
+        }
+    }
+}
+
+// Returns the chunk whose global triangle range holds global_idx
+static u32 _encas_find_shell_chunk(const Encas_ShellChunk *chunks, u32 num_chunks, u64 global_idx) {
+    u32 lo = 0, hi = num_chunks;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (chunks[mid].global_offset <= global_idx)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo - 1;
+}
+
+// Records the cell every shell triangle comes from (part local, in element order) and the
+// triangle range of every part. The shell keeps the chunk order, so the triangles of one
+// part are contiguous.
+static void _encas_shell_triangle_cells(Encas_MeshArray *mesh, const Encas_ShellChunk *chunks, u32 num_chunks, Encas_ShellParams *params) {
+    const u32 tria_count = params->ebo_size / 3;
+    u32 *tria_cell_idx = (u32 *)ENCAS_MALLOC(tria_count * sizeof(u32));
+    u32 *ebo_part_offsets = (u32 *)ENCAS_MALLOC((mesh->len + 1) * sizeof(u32));
+
+    ENCAS_OMP(parallel for)
+    for (u32 tria_idx = 0; tria_idx < tria_count; ++tria_idx) {
+        u32 global_idx = params->tria_global_idx[tria_idx];
+        const Encas_ShellChunk *chunk = chunks + _encas_find_shell_chunk(chunks, num_chunks, global_idx);
+        Encas_Elem_Type type = mesh->elems[chunk->part_idx]->elem_array[chunk->elem_idx].type;
+        tria_cell_idx[tria_idx] = chunk->cell_offset + (u32)((global_idx - chunk->global_offset) / Encas_GetCellTrianglesCount(type));
+    }
+
+    // First triangle of every part
+    for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx) {
+        u32 lo = 0, hi = tria_count;
+        while (lo < hi) {
+            u32 mid = lo + (hi - lo) / 2;
+            if (chunks[_encas_find_shell_chunk(chunks, num_chunks, params->tria_global_idx[mid])].part_idx < part_idx)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        ebo_part_offsets[part_idx] = lo;
+    }
+    ebo_part_offsets[mesh->len] = tria_count;
+
+    params->tria_cell_idx = tria_cell_idx;
+    params->ebo_part_offsets = ebo_part_offsets;
+}
+
+// Picks the face map partition of a sorted face from the top bits of a multiplicative hash
+force_inline u32 _encas_face_partition(const u32 *v, u32 face_size) {
+    u64 h = (u64)v[0] * 0x9E3779B97F4A7C15ULL;
+    h ^= (u64)v[1] * 0xC2B2AE3D27D4EB4FULL;
+    h ^= (u64)v[2] * 0x165667B19E3779F9ULL;
+    if (face_size == 4)
+        h ^= (u64)v[3] * 0x27D4EB2F165667C5ULL;
+    h ^= h >> 31;
+    h *= 0x94D049BB133111EBULL;
+    return (u32)(h >> 58) & (ENCAS_SHELL_PARTITIONS - 1);
+}
+
+force_inline void _encas_sorted_face(const u32 *face, u32 face_size, u32 *out) {
+    out[0] = face[0];
+    out[1] = face[1];
+    out[2] = face[2];
+    if (face_size == 4) {
+        out[3] = face[3];
+        sort4(out);
+    } else {
+        sort3(out, out + 1, out + 2);
+    }
+}
+
+// Sets boundary[i] to 1 for the faces that occur only once.
+// faces holds num_faces faces of face_size (3 or 4) vertices, faces starting with
+// UINT32_MAX are skipped. The faces are bucketed by hash into ENCAS_SHELL_PARTITIONS
+// partitions, then every partition is deduplicated in its own small face map.
+static void _encas_mark_boundary_faces(const u32 *faces, u32 face_size, u64 num_faces, u8 *boundary) {
+    const u32 num_chunks = _encas_max_threads();
+    const u64 chunk_size = (num_faces + num_chunks - 1) / num_chunks;
+
+    u8  *partition = (u8 *)ENCAS_MALLOC(num_faces * sizeof(u8));
+    u32 *sorted_faces = (u32 *)ENCAS_MALLOC(num_faces * sizeof(u32));
+    u64 *counts = (u64 *)ENCAS_MALLOC((u64)num_chunks * ENCAS_SHELL_PARTITIONS * sizeof(u64));
+    u64 partition_offsets[ENCAS_SHELL_PARTITIONS + 1];
+
+    memset(counts, 0, (u64)num_chunks * ENCAS_SHELL_PARTITIONS * sizeof(u64));
+    memset(boundary, 0, num_faces * sizeof(u8));
+
+    ENCAS_OMP(parallel for)
+    for (u32 chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+        u64 begin = chunk_idx * chunk_size;
+        u64 end = begin + chunk_size < num_faces ? begin + chunk_size : num_faces;
+        u64 *chunk_counts = counts + (u64)chunk_idx * ENCAS_SHELL_PARTITIONS;
+
+        for (u64 face_idx = begin; face_idx < end; ++face_idx) {
+            const u32 *face = faces + face_idx * face_size;
+            if (face[0] == UINT32_MAX) {
+                partition[face_idx] = 0xFF;
+                continue;
+            }
+
+            u32 v[4];
+            _encas_sorted_face(face, face_size, v);
+            partition[face_idx] = (u8)_encas_face_partition(v, face_size);
+            ++chunk_counts[partition[face_idx]];
+        }
+    }
+
+    // Exclusive prefix sum in partition-major order, counts become the write cursors
+    u64 sum = 0;
+    for (u32 p = 0; p < ENCAS_SHELL_PARTITIONS; ++p) {
+        partition_offsets[p] = sum;
+        for (u32 chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+            u64 n = counts[(u64)chunk_idx * ENCAS_SHELL_PARTITIONS + p];
+            counts[(u64)chunk_idx * ENCAS_SHELL_PARTITIONS + p] = sum;
+            sum += n;
+        }
+    }
+    partition_offsets[ENCAS_SHELL_PARTITIONS] = sum;
+
+    ENCAS_OMP(parallel for)
+    for (u32 chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+        u64 begin = chunk_idx * chunk_size;
+        u64 end = begin + chunk_size < num_faces ? begin + chunk_size : num_faces;
+        u64 *chunk_counts = counts + (u64)chunk_idx * ENCAS_SHELL_PARTITIONS;
+
+        for (u64 face_idx = begin; face_idx < end; ++face_idx)
+            if (partition[face_idx] != 0xFF)
+                sorted_faces[chunk_counts[partition[face_idx]]++] = face_idx;
+    }
+
+    ENCAS_OMP(parallel for schedule(dynamic))
+    for (u32 p = 0; p < ENCAS_SHELL_PARTITIONS; ++p) {
+        u64 begin = partition_offsets[p];
+        u64 end = partition_offsets[p + 1];
+        if (begin == end)
+            continue;
+
+        if (face_size == 3) {
+            Encas_FaceKeyMap m;
+            Encas_CreateFaceKeyMap(&m, next_power_of_two(2 * (end - begin)));
+
+            for (u64 i = begin; i < end; ++i) {
+                u32 face_idx = sorted_faces[i];
+                Encas_FaceKey f;
+                _encas_sorted_face(faces + (u64)face_idx * 3, 3, f.v);
+
+                u8 num_tria;
+                if (Encas_GetFaceKeyMap(&m, f, &num_tria))
+                    Encas_SetFaceKeyMap(&m, f, num_tria + 1, face_idx);
+                else
+                    Encas_SetFaceKeyMap(&m, f, 1, face_idx);
+            }
+
+            for (u32 i = 0; i < m.cap; ++i)
+                if (m.values[i] == 1)
+                    boundary[m.global_indices[i]] = 1;
+
+            Encas_DeleteFaceKeyMap(&m);
+        } else {
+            Encas_QuadKeyMap m;
+            Encas_CreateQuadKeyMap(&m, next_power_of_two(2 * (end - begin)));
+
+            for (u64 i = begin; i < end; ++i) {
+                u32 face_idx = sorted_faces[i];
+                Encas_QuadKey q;
+                _encas_sorted_face(faces + (u64)face_idx * 4, 4, q.v);
+
+                u8 num_quad;
+                if (Encas_GetQuadKeyMap(&m, q, &num_quad))
+                    Encas_SetQuadKeyMap(&m, q, num_quad + 1, face_idx);
+                else
+                    Encas_SetQuadKeyMap(&m, q, 1, face_idx);
+            }
+
+            for (u32 i = 0; i < m.cap; ++i)
+                if (m.values[i] == 1)
+                    boundary[m.global_indices[i]] = 1;
+
+            Encas_DeleteQuadKeyMap(&m);
+        }
+    }
+
+    ENCAS_FREE(partition);
+    ENCAS_FREE(sorted_faces);
+    ENCAS_FREE(counts);
+}
+
+// Merges the vertices sharing a node id, every vertex is mapped to the first vertex with its id.
+// Returns NULL if a part has no node ids.
+static u32 *_encas_weld_by_node_id(Encas_MeshArray *mesh, u64 vertices_size) {
+    for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx) {
+        if (mesh->elems[part_idx]->node_ids == NULL && mesh->elems[part_idx]->vert_array_size > 0) {
+            Encas_Log(ENCAS_LOG_LEVEL_WARNING, "Welding by node id needs 'node id given', the shell is not welded\n");
+            return NULL;
+        }
+    }
+
+    s32 *ids = (s32 *)ENCAS_MALLOC(vertices_size * sizeof(s32));
+    u64 vert_offset = 0;
+    for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx) {
+        Encas_Mesh *mesh_part = mesh->elems[part_idx];
+        if (mesh_part->vert_array_size)
+            memcpy(ids + vert_offset, mesh_part->node_ids, mesh_part->vert_array_size * sizeof(s32));
+        vert_offset += mesh_part->vert_array_size;
+    }
+
+    // Same scheme as the face matching: scatter the vertices to independent partitions
+    // by id, the scatter is stable so every partition sees its vertices in order
+    const u32 num_chunks = _encas_max_threads();
+    const u64 chunk_size = (vertices_size + num_chunks - 1) / num_chunks;
+
+    u8  *partition = (u8 *)ENCAS_MALLOC(vertices_size * sizeof(u8));
+    u32 *sorted = (u32 *)ENCAS_MALLOC(vertices_size * sizeof(u32));
+    u64 *counts = (u64 *)ENCAS_MALLOC((u64)num_chunks * ENCAS_SHELL_PARTITIONS * sizeof(u64));
+    u64 partition_offsets[ENCAS_SHELL_PARTITIONS + 1];
+
+    memset(counts, 0, (u64)num_chunks * ENCAS_SHELL_PARTITIONS * sizeof(u64));
+
+    ENCAS_OMP(parallel for)
+    for (u32 chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+        u64 begin = chunk_idx * chunk_size;
+        u64 end = begin + chunk_size < vertices_size ? begin + chunk_size : vertices_size;
+        u64 *chunk_counts = counts + (u64)chunk_idx * ENCAS_SHELL_PARTITIONS;
+
+        for (u64 i = begin; i < end; ++i) {
+            partition[i] = (u8)(((u32)ids[i] * 0x9E3779B1u) >> 26);
+            ++chunk_counts[partition[i]];
+        }
+    }
+
+    u64 sum = 0;
+    for (u32 p = 0; p < ENCAS_SHELL_PARTITIONS; ++p) {
+        partition_offsets[p] = sum;
+        for (u32 chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+            u64 n = counts[(u64)chunk_idx * ENCAS_SHELL_PARTITIONS + p];
+            counts[(u64)chunk_idx * ENCAS_SHELL_PARTITIONS + p] = sum;
+            sum += n;
+        }
+    }
+    partition_offsets[ENCAS_SHELL_PARTITIONS] = sum;
+
+    ENCAS_OMP(parallel for)
+    for (u32 chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+        u64 begin = chunk_idx * chunk_size;
+        u64 end = begin + chunk_size < vertices_size ? begin + chunk_size : vertices_size;
+        u64 *chunk_counts = counts + (u64)chunk_idx * ENCAS_SHELL_PARTITIONS;
+
+        for (u64 i = begin; i < end; ++i)
+            sorted[chunk_counts[partition[i]]++] = i;
+    }
+
+    u32 *weld_map = (u32 *)ENCAS_MALLOC(vertices_size * sizeof(u32));
+
+    ENCAS_OMP(parallel for schedule(dynamic))
+    for (u32 p = 0; p < ENCAS_SHELL_PARTITIONS; ++p) {
+        u64 begin = partition_offsets[p];
+        u64 end = partition_offsets[p + 1];
+        if (begin == end)
+            continue;
+
+        // Open addressing id -> first vertex
+        u32 cap = next_power_of_two(2 * (end - begin));
+        s32 *keys = (s32 *)ENCAS_MALLOC(cap * sizeof(s32));
+        u32 *first = (u32 *)ENCAS_MALLOC(cap * sizeof(u32));
+        memset(first, 0xFF, cap * sizeof(u32));
+
+        for (u64 i = begin; i < end; ++i) {
+            u32 vert_idx = sorted[i];
+            s32 id = ids[vert_idx];
+            u32 slot = ((u32)id * 0x9E3779B1u) & (cap - 1);
+
+            while (first[slot] != UINT32_MAX && keys[slot] != id)
+                slot = (slot + 1) & (cap - 1);
+
+            if (first[slot] == UINT32_MAX) {
+                keys[slot] = id;
+                first[slot] = vert_idx;
+            }
+            weld_map[vert_idx] = first[slot];
+        }
+
+        ENCAS_FREE(keys);
+        ENCAS_FREE(first);
+    }
+
+    ENCAS_FREE(counts);
+    ENCAS_FREE(sorted);
+    ENCAS_FREE(partition);
+    ENCAS_FREE(ids);
+    return weld_map;
+}
+
+// Grid cell of one coordinate, with exact set the cell is the coordinate itself (-0 == 0).
+// Cells are clamped to +-2^61 so the cast and the neighbour cells stay in range, NaN gets 2^62.
+force_inline s64 _encas_weld_cell(float v, bool exact, double inv_cell) {
+    if (exact) {
+        v += 0.f;
+        u32 bits;
+        memcpy(&bits, &v, sizeof(u32));
+        return bits;
+    }
+
+    const double limit = (double)((s64)1 << 61);
+    double cell = floor(v * inv_cell);
+    if (cell != cell)
+        return (s64)1 << 62;
+    if (cell > limit)
+        cell = limit;
+    else if (cell < -limit)
+        cell = -limit;
+    return (s64)cell;
+}
+
+force_inline u32 _encas_grid_hash(s64 cx, s64 cy, s64 cz) {
+    u64 h = (u64)cx * 0x9E3779B97F4A7C15ULL;
+    h ^= (u64)cy * 0xC2B2AE3D27D4EB4FULL;
+    h ^= (u64)cz * 0x165667B19E3779F9ULL;
+    h ^= h >> 29;
+    return (u32)h;
+}
+
+// Merges the vertices closer than tolerance with a uniform grid of tolerance sized cells.
+// Every vertex is mapped to the smallest vertex index within tolerance, then the chains are
+// collapsed, so the result doesn't depend on the thread schedule.
+static u32 *_encas_weld_by_position(Encas_MeshArray *mesh, u64 vertices_size, float tolerance) {
+    float *x = (float *)ENCAS_MALLOC(3 * vertices_size * sizeof(float));
+    float *y = x + vertices_size;
+    float *z = y + vertices_size;
+
+    u64 vert_offset = 0;
+    for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx) {
+        Encas_Mesh *mesh_part = mesh->elems[part_idx];
+        memcpy(x + vert_offset, mesh_part->vert_array.x, mesh_part->vert_array_size * sizeof(float));
+        memcpy(y + vert_offset, mesh_part->vert_array.y, mesh_part->vert_array_size * sizeof(float));
+        memcpy(z + vert_offset, mesh_part->vert_array.z, mesh_part->vert_array_size * sizeof(float));
+        vert_offset += mesh_part->vert_array_size;
+    }
+
+    // With zero tolerance the cells are the positions themselves
+    const bool exact = !(tolerance > 0.f);
+    const double inv_cell = exact ? 0.0 : 1.0 / tolerance;
+    const float tolerance2 = tolerance * tolerance;
+
+    const u32 cap = next_power_of_two(2 * (u32)vertices_size);
+    u32 *bucket_offsets = (u32 *)ENCAS_MALLOC((u64)(cap + 1) * sizeof(u32));
+    u32 *cell_hash = (u32 *)ENCAS_MALLOC(vertices_size * sizeof(u32));
+    memset(bucket_offsets, 0, (u64)(cap + 1) * sizeof(u32));
+
+    ENCAS_OMP(parallel for)
+    for (u64 i = 0; i < vertices_size; ++i) {
+        cell_hash[i] = _encas_grid_hash(_encas_weld_cell(x[i], exact, inv_cell),
+                                        _encas_weld_cell(y[i], exact, inv_cell),
+                                        _encas_weld_cell(z[i], exact, inv_cell)) & (cap - 1);
+        ENCAS_OMP(atomic)
+        ++bucket_offsets[cell_hash[i] + 1];
+    }
+
+    for (u32 b = 0; b < cap; ++b)
+        bucket_offsets[b + 1] += bucket_offsets[b];
+
+    u32 *bucket_cursor = (u32 *)ENCAS_MALLOC((u64)cap * sizeof(u32));
+    u32 *bucket_verts = (u32 *)ENCAS_MALLOC(vertices_size * sizeof(u32));
+    memcpy(bucket_cursor, bucket_offsets, (u64)cap * sizeof(u32));
+
+    ENCAS_OMP(parallel for)
+    for (u64 i = 0; i < vertices_size; ++i) {
+        u32 pos;
+        ENCAS_OMP(atomic capture)
+        pos = bucket_cursor[cell_hash[i]]++;
+        bucket_verts[pos] = (u32)i;
+    }
+
+    u32 *weld_map = (u32 *)ENCAS_MALLOC(vertices_size * sizeof(u32));
+    const s64 reach = exact ? 0 : 1;
+
+    ENCAS_OMP(parallel for schedule(dynamic, 4096))
+    for (u64 i = 0; i < vertices_size; ++i) {
+        const s64 cx = _encas_weld_cell(x[i], exact, inv_cell);
+        const s64 cy = _encas_weld_cell(y[i], exact, inv_cell);
+        const s64 cz = _encas_weld_cell(z[i], exact, inv_cell);
+        u32 best = (u32)i;
+
+        for (s64 dx = -reach; dx <= reach; ++dx)
+        for (s64 dy = -reach; dy <= reach; ++dy)
+        for (s64 dz = -reach; dz <= reach; ++dz) {
+            u32 b = _encas_grid_hash(cx + dx, cy + dy, cz + dz) & (cap - 1);
+
+            for (u32 k = bucket_offsets[b]; k < bucket_offsets[b + 1]; ++k) {
+                u32 j = bucket_verts[k];
+                if (j >= best)
+                    continue;
+
+                float ex = x[i] - x[j], ey = y[i] - y[j], ez = z[i] - z[j];
+                if (exact ? (ex == 0.f && ey == 0.f && ez == 0.f) : (ex * ex + ey * ey + ez * ez <= tolerance2))
+                    best = j;
+            }
+        }
+
+        weld_map[i] = best;
+    }
+
+    // weld_map[i] <= i, jump pointers until every vertex points to a root
+    bool changed = true;
+    while (changed) {
+        changed = false;
+
+        ENCAS_OMP(parallel for reduction(||:changed))
+        for (u64 i = 0; i < vertices_size; ++i) {
+            u32 next = weld_map[weld_map[i]];
+            if (next != weld_map[i]) {
+                weld_map[i] = next;
+                changed = true;
+            }
+        }
+    }
+
+    ENCAS_FREE(bucket_verts);
+    ENCAS_FREE(bucket_cursor);
+    ENCAS_FREE(cell_hash);
+    ENCAS_FREE(bucket_offsets);
+    ENCAS_FREE(x);
+    return weld_map;
+}
+
+// Maps the vertices of faces through the weld map, invalid faces are left alone
+static void _encas_weld_faces(u32 *faces, u64 num_indices, const u32 *weld_map) {
+    for (u64 i = 0; i < num_indices; ++i)
+        if (faces[i] != UINT32_MAX)
+            faces[i] = weld_map[faces[i]];
+}
+
+// Welds the triangulated faces of num_cells cells of cell_type and splits their quads again, the
+// smallest vertex of a quad can change once welded. A split quad a b c | a c d or b c d | b d a
+// is the quad t[0] t[1] t[2] t[5] either way.
+static void _encas_weld_cell_triangles(Encas_Elem_Type cell_type, u32 *faces, u32 num_cells, const u32 *weld_map) {
+    u32 num_cell_faces;
+    const Encas_CellFace *cell_faces = _encas_get_cell_faces(cell_type, &num_cell_faces);
+    if (cell_faces == NULL) {
+        _encas_weld_faces(faces, 3 * (u64)num_cells * Encas_GetCellTrianglesCount(cell_type), weld_map);
+        return;
+    }
+
+    for (u32 cell_idx = 0; cell_idx < num_cells; ++cell_idx) {
+        for (u32 face_idx = 0; face_idx < num_cell_faces; ++face_idx) {
+            if (cell_faces[face_idx].count == 3 || faces[0] == UINT32_MAX) {
+                _encas_weld_faces(faces, 3 * (cell_faces[face_idx].count - 2), weld_map);
+            } else {
+                _encas_split_quad(faces, weld_map[faces[0]], weld_map[faces[1]], weld_map[faces[2]], weld_map[faces[5]]);
+            }
+            faces += 3 * (cell_faces[face_idx].count - 2);
+        }
+    }
+}
+
+// Counts the set flags of every chunk of [0, n) and turns the counts into
+// exclusive offsets (offsets has num_chunks + 1 elements), returns the total
+static u64 _encas_count_flags(const u8 *flags, u64 n, u32 num_chunks, u64 *offsets) {
+    const u64 chunk_size = (n + num_chunks - 1) / num_chunks;
+
+    ENCAS_OMP(parallel for)
+    for (u32 chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+        u64 begin = chunk_idx * chunk_size;
+        u64 end = begin + chunk_size < n ? begin + chunk_size : n;
+        u64 count = 0;
+        for (u64 i = begin; i < end; ++i)
+            count += flags[i];
+        offsets[chunk_idx] = count;
+    }
+
+    u64 sum = 0;
+    for (u32 chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+        u64 count = offsets[chunk_idx];
+        offsets[chunk_idx] = sum;
+        sum += count;
+    }
+    offsets[num_chunks] = sum;
+
+    return sum;
+}
+
+// Boundary faces of the triangle mode: every face is split to triangles, then
+// triangles found only once are on the boundary.
+// Writes the boundary triangles to shell_faces and returns their count
+static u32 _encas_shell_triangles(Encas_MeshArray *mesh, Encas_ShellChunk *chunks, u32 num_chunks, u64 num_faces, const u32 *weld_map, u32 **shell_faces_out, u32 **shell_global_idx_out) {
+    u32 *faces = (u32 *)ENCAS_MALLOC(3 * num_faces * sizeof(u32));
+
+    // Fill the face array, the slots of a chunk start at its global triangle index
+    ENCAS_OMP(parallel for schedule(dynamic))
+    for (u32 chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+        Encas_ShellChunk *chunk = chunks + chunk_idx;
+        Encas_Elem_Type type = mesh->elems[chunk->part_idx]->elem_array[chunk->elem_idx].type;
+        u32 *block_cells;
+        u32 *elem_vert_map_array = _encas_shell_chunk_cells(mesh, chunk, &block_cells);
+        u64 face_offset = 3 * chunk->global_offset;
+
+        switch (type) {
+            case ENCAS_ELEM_TRIA3:
+                Encas_TriangulateTria3s(elem_vert_map_array, chunk->num_cells, faces, &face_offset, chunk->vert_offset);
+                break;
+            case ENCAS_ELEM_QUAD4:
+                Encas_TriangulateQuad4s(elem_vert_map_array, chunk->num_cells, faces, &face_offset, chunk->vert_offset);
+                break;
+            case ENCAS_ELEM_TETRA4:
+                Encas_TriangulateTetra4s(elem_vert_map_array, chunk->num_cells, faces, &face_offset, chunk->vert_offset);
+                break;
+            case ENCAS_ELEM_PYRAMID5:
+                Encas_TriangulatePyramid5s(elem_vert_map_array, chunk->num_cells, faces, &face_offset, chunk->vert_offset);
+                break;
+            case ENCAS_ELEM_PENTA6:
+                Encas_TriangulatePenta6s(elem_vert_map_array, chunk->num_cells, faces, &face_offset, chunk->vert_offset);
+                break;
+            case ENCAS_ELEM_HEXA8:
+                Encas_TriangulateHexa8s(elem_vert_map_array, chunk->num_cells, faces, &face_offset, chunk->vert_offset);
+                break;
+            default:
+                // Cell types that cannot be triangulated leave their slots invalid
+                memset(faces + face_offset, 0xFF, 3 * (u64)chunk->num_cells * Encas_GetCellTrianglesCount(type) * sizeof(u32));
+                break;
+        }
+
+        // Two triangles per hexa8 face
+        _encas_drop_block_interior_faces(mesh, chunk, faces + 3 * chunk->global_offset, 6);
+        ENCAS_FREE(block_cells);
+
+        if (weld_map)
+            _encas_weld_cell_triangles(type, faces + 3 * chunk->global_offset, chunk->num_cells, weld_map);
+    }
+
+    u8 *boundary = (u8 *)ENCAS_MALLOC(num_faces * sizeof(u8));
+    _encas_mark_boundary_faces(faces, 3, num_faces, boundary);
+
+    const u32 num_compact_chunks = _encas_max_threads();
+    const u64 compact_chunk_size = (num_faces + num_compact_chunks - 1) / num_compact_chunks;
+    u64 *offsets = (u64 *)ENCAS_MALLOC((num_compact_chunks + 1) * sizeof(u64));
+    u32 new_triangle_count = _encas_count_flags(boundary, num_faces, num_compact_chunks, offsets);
+
+    u32 *shell_faces = (u32 *)ENCAS_MALLOC(3 * new_triangle_count * sizeof(u32));
+    u32 *shell_global_idx = (u32 *)ENCAS_MALLOC(new_triangle_count * sizeof(u32));
+
+    ENCAS_OMP(parallel for)
+    for (u32 chunk_idx = 0; chunk_idx < num_compact_chunks; ++chunk_idx) {
+        u64 begin = chunk_idx * compact_chunk_size;
+        u64 end = begin + compact_chunk_size < num_faces ? begin + compact_chunk_size : num_faces;
+        u64 j = offsets[chunk_idx];
+
+        for (u64 tria_idx = begin; tria_idx < end; ++tria_idx) {
+            if (boundary[tria_idx]) {
+                shell_global_idx[j] = tria_idx;
+                shell_faces[3 * j + 0] = faces[3 * tria_idx + 0];
+                shell_faces[3 * j + 1] = faces[3 * tria_idx + 1];
+                shell_faces[3 * j + 2] = faces[3 * tria_idx + 2];
+                ++j;
+            }
+        }
+    }
+
+    ENCAS_FREE(offsets);
+    ENCAS_FREE(boundary);
+    ENCAS_FREE(faces);
+
+    *shell_faces_out = shell_faces;
+    *shell_global_idx_out = shell_global_idx;
+    return new_triangle_count;
+}
+
+// Boundary faces of the quad mode: triangle faces and quad faces are deduplicated
+// separately, then only the boundary quads are split into two triangles.
+// Writes the boundary triangles to shell_faces and returns their count
+static u32 _encas_shell_quads(Encas_MeshArray *mesh, Encas_ShellChunk *chunks, u32 num_chunks, u64 num_trias, u64 num_quads, const u32 *weld_map, u32 **shell_faces_out, u32 **shell_global_idx_out) {
+    u32 *trias = (u32 *)ENCAS_MALLOC(3 * num_trias * sizeof(u32));
+    u32 *tria_global_idx = (u32 *)ENCAS_MALLOC(num_trias * sizeof(u32));
+    u32 *quads = (u32 *)ENCAS_MALLOC(4 * num_quads * sizeof(u32));
+    u32 *quad_global_idx = (u32 *)ENCAS_MALLOC(num_quads * sizeof(u32));
+
+    ENCAS_OMP(parallel for schedule(dynamic))
+    for (u32 chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+        Encas_ShellChunk *chunk = chunks + chunk_idx;
+        Encas_Elem_Type type = mesh->elems[chunk->part_idx]->elem_array[chunk->elem_idx].type;
+        u64 trias_offset = chunk->trias_offset;
+        u64 quads_offset = chunk->quads_offset;
+
+        u32 *block_cells;
+        _encas_extract_cell_faces(type, _encas_shell_chunk_cells(mesh, chunk, &block_cells), chunk->num_cells,
+                                  chunk->vert_offset, chunk->global_offset,
+                                  trias, tria_global_idx, &trias_offset,
+                                  quads, quad_global_idx, &quads_offset);
+        _encas_drop_block_interior_faces(mesh, chunk, quads + 4 * chunk->quads_offset, 4);
+        ENCAS_FREE(block_cells);
+
+        if (weld_map) {
+            _encas_weld_faces(trias + 3 * chunk->trias_offset, 3 * (trias_offset - chunk->trias_offset), weld_map);
+            _encas_weld_faces(quads + 4 * chunk->quads_offset, 4 * (quads_offset - chunk->quads_offset), weld_map);
+        }
+    }
+
+    // Boundary flags, the quad flags follow the triangle flags
+    u8 *boundary = (u8 *)ENCAS_MALLOC((num_trias + num_quads) * sizeof(u8));
+    _encas_mark_boundary_faces(trias, 3, num_trias, boundary);
+    _encas_mark_boundary_faces(quads, 4, num_quads, boundary + num_trias);
+
+    // Compact chunk by chunk so the shell keeps the part order of the mesh
+    u64 *out_offsets = (u64 *)ENCAS_MALLOC((num_chunks + 1) * sizeof(u64));
+
+    ENCAS_OMP(parallel for)
+    for (u32 chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+        u64 trias_end = chunk_idx + 1 < num_chunks ? chunks[chunk_idx + 1].trias_offset : num_trias;
+        u64 quads_end = chunk_idx + 1 < num_chunks ? chunks[chunk_idx + 1].quads_offset : num_quads;
+        u64 count = 0;
+
+        for (u64 tria_idx = chunks[chunk_idx].trias_offset; tria_idx < trias_end; ++tria_idx)
+            count += boundary[tria_idx];
+        for (u64 quad_idx = chunks[chunk_idx].quads_offset; quad_idx < quads_end; ++quad_idx)
+            count += 2 * boundary[num_trias + quad_idx];
+
+        out_offsets[chunk_idx] = count;
+    }
+
+    u64 new_triangle_count = 0;
+    for (u32 chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+        u64 count = out_offsets[chunk_idx];
+        out_offsets[chunk_idx] = new_triangle_count;
+        new_triangle_count += count;
+    }
+
+    u32 *shell_faces = (u32 *)ENCAS_MALLOC(3 * new_triangle_count * sizeof(u32));
+    u32 *shell_global_idx = (u32 *)ENCAS_MALLOC(new_triangle_count * sizeof(u32));
+
+    ENCAS_OMP(parallel for schedule(dynamic))
+    for (u32 chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+        u64 trias_end = chunk_idx + 1 < num_chunks ? chunks[chunk_idx + 1].trias_offset : num_trias;
+        u64 quads_end = chunk_idx + 1 < num_chunks ? chunks[chunk_idx + 1].quads_offset : num_quads;
+        u64 j = out_offsets[chunk_idx];
+
+        for (u64 tria_idx = chunks[chunk_idx].trias_offset; tria_idx < trias_end; ++tria_idx) {
+            if (boundary[tria_idx]) {
+                shell_global_idx[j] = tria_global_idx[tria_idx];
+                shell_faces[3 * j + 0] = trias[3 * tria_idx + 0];
+                shell_faces[3 * j + 1] = trias[3 * tria_idx + 1];
+                shell_faces[3 * j + 2] = trias[3 * tria_idx + 2];
+                ++j;
+            }
+        }
+
+        for (u64 quad_idx = chunks[chunk_idx].quads_offset; quad_idx < quads_end; ++quad_idx) {
+            if (boundary[num_trias + quad_idx]) {
+                const u32 *q = quads + 4 * quad_idx;
+
+                shell_global_idx[j] = quad_global_idx[quad_idx];
+                shell_faces[3 * j + 0] = q[0];
+                shell_faces[3 * j + 1] = q[1];
+                shell_faces[3 * j + 2] = q[2];
+                ++j;
+
+                shell_global_idx[j] = quad_global_idx[quad_idx] + 1;
+                shell_faces[3 * j + 0] = q[0];
+                shell_faces[3 * j + 1] = q[2];
+                shell_faces[3 * j + 2] = q[3];
+                ++j;
+            }
+        }
+    }
+
+    ENCAS_FREE(out_offsets);
+    ENCAS_FREE(boundary);
+    ENCAS_FREE(trias);
+    ENCAS_FREE(tria_global_idx);
+    ENCAS_FREE(quads);
+    ENCAS_FREE(quad_global_idx);
+
+    *shell_faces_out = shell_faces;
+    *shell_global_idx_out = shell_global_idx;
+    return new_triangle_count;
+}
+
+// Returns the first index of the sorted arr where arr[idx] >= value
+static u32 _encas_lower_bound_u32(const u32 *arr, u32 n, u64 value) {
+    u32 lo = 0, hi = n;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (arr[mid] < value)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// vbo_orig_idx is sorted, so the shell vertices of every part are one contiguous range
+static void _encas_shell_part_offsets(Encas_MeshArray *mesh, Encas_ShellParams *params) {
+    params->num_parts = mesh->len;
+    params->vbo_part_offsets = (u32 *)ENCAS_MALLOC((mesh->len + 1) * sizeof(u32));
+
+    u64 vert_offset = 0;
+    for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx) {
+        params->vbo_part_offsets[part_idx] = _encas_lower_bound_u32(params->vbo_orig_idx, params->vbo_size, vert_offset);
+        vert_offset += mesh->elems[part_idx]->vert_array_size;
+    }
+    params->vbo_part_offsets[mesh->len] = params->vbo_size;
+}
+
+ENCAS_API void Encas_LoadGeometryShellEx(Encas_Case *encase, Encas_MeshArray *mesh, Encas_ShellParams *params, const Encas_ShellOptions *options) {
+    u64 vertices_size = 0;
+    for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx)
+        vertices_size += mesh->elems[part_idx]->vert_array_size;
+
+    u32 num_chunks;
+    u64 num_faces, num_trias, num_quads;
+    Encas_ShellChunk *chunks = _encas_create_shell_chunks(mesh, &num_chunks, &num_faces, &num_trias, &num_quads);
+
+    u32 *weld_map = NULL;
+    if (options->weld == ENCAS_WELD_NODE_ID)
+        weld_map = _encas_weld_by_node_id(mesh, vertices_size);
+    else if (options->weld == ENCAS_WELD_POSITION)
+        weld_map = _encas_weld_by_position(mesh, vertices_size, options->weld_tolerance);
+
+    u32 *shell_faces, *shell_global_idx;
+    u32 new_triangle_count;
+
+    if (options->mode == ENCAS_SHELL_MODE_QUADS)
+        new_triangle_count = _encas_shell_quads(mesh, chunks, num_chunks, num_trias, num_quads, weld_map, &shell_faces, &shell_global_idx);
+    else
+        new_triangle_count = _encas_shell_triangles(mesh, chunks, num_chunks, num_faces, weld_map, &shell_faces, &shell_global_idx);
+
+    u8 *used_vertices = (u8 *)ENCAS_MALLOC(vertices_size * sizeof(u8));
+    memset(used_vertices, 0, vertices_size * sizeof(u8));
+
+    // Racing writes store the same value
+    ENCAS_OMP(parallel for)
+    for (u64 i = 0; i < 3 * (u64)new_triangle_count; ++i)
+        used_vertices[shell_faces[i]] = 1;
+
+    const u32 num_compact_chunks = _encas_max_threads();
+    const u64 compact_chunk_size = (vertices_size + num_compact_chunks - 1) / num_compact_chunks;
+    u64 *offsets = (u64 *)ENCAS_MALLOC((num_compact_chunks + 1) * sizeof(u64));
+    u32 new_vertex_count = _encas_count_flags(used_vertices, vertices_size, num_compact_chunks, offsets);
+
+    u32 *remap = (u32 *)ENCAS_MALLOC(sizeof(u32) * vertices_size);
+    u32 *vbo_orig_idx = (u32 *)ENCAS_MALLOC(new_vertex_count * sizeof(u32));
+
+    ENCAS_OMP(parallel for)
+    for (u32 chunk_idx = 0; chunk_idx < num_compact_chunks; ++chunk_idx) {
+        u64 begin = chunk_idx * compact_chunk_size;
+        u64 end = begin + compact_chunk_size < vertices_size ? begin + compact_chunk_size : vertices_size;
+        u64 j = offsets[chunk_idx];
+
+        for (u64 i = begin; i < end; ++i) {
+            if (used_vertices[i]) {
+                remap[i] = j;
+                vbo_orig_idx[j++] = i;
+            }
+        }
+    }
+
+    // Gather the shell vertices straight from the SoA part arrays
+    float *vbo = (float *)ENCAS_MALLOC(3 * new_vertex_count * sizeof(float));
+    u64 vert_offset = 0;
+    for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx) {
+        Encas_Mesh *mesh_part = mesh->elems[part_idx];
+        const u8 *part_used = used_vertices + vert_offset;
+        const u32 *part_remap = remap + vert_offset;
+
+        ENCAS_OMP(parallel for)
+        for (u64 vert_idx = 0; vert_idx < mesh_part->vert_array_size; ++vert_idx) {
+            if (part_used[vert_idx]) {
+                u32 new_idx = part_remap[vert_idx];
+                vbo[3 * new_idx + 0] = mesh_part->vert_array.x[vert_idx];
+                vbo[3 * new_idx + 1] = mesh_part->vert_array.y[vert_idx];
+                vbo[3 * new_idx + 2] = mesh_part->vert_array.z[vert_idx];
+            }
+        }
+
+        vert_offset += mesh_part->vert_array_size;
+    }
+
+    // Remap the boundary triangles in place to the new vertex indices
+    u32 *visible_triangle_indices = shell_faces;
+    ENCAS_OMP(parallel for)
+    for (u64 i = 0; i < 3 * (u64)new_triangle_count; ++i)
+        visible_triangle_indices[i] = remap[shell_faces[i]];
+
+    params->tria_global_idx = shell_global_idx;
+
+    params->vbo = vbo;
+    params->vbo_size = new_vertex_count;
+    params->vbo_orig_idx = vbo_orig_idx;
+    params->ebo = visible_triangle_indices;
+    params->ebo_size = new_triangle_count * 3;
+    params->global_ebo_size = num_faces;
+    params->orig_vertices_size = vertices_size;
+    params->topology_hash = mesh->topology_hash;
+    params->weld_map = weld_map;
+    _encas_shell_part_offsets(mesh, params);
+    _encas_shell_triangle_cells(mesh, chunks, num_chunks, params);
+
+    ENCAS_FREE(chunks);
+    ENCAS_FREE(offsets);
+    ENCAS_FREE(used_vertices);
+    ENCAS_FREE(remap);
+}
+
+// Refreshes params->vbo from the coordinates of mesh, keeping the shell topology
+ENCAS_API void Encas_UpdateGeometryShellCoords(Encas_MeshArray *mesh, Encas_ShellParams *params) {
+    u64 vert_offset = 0;
+    for (u32 part_idx = 0; part_idx < mesh->len && part_idx < params->num_parts; ++part_idx) {
+        Encas_Mesh *mesh_part = mesh->elems[part_idx];
+        u32 begin = params->vbo_part_offsets[part_idx];
+        u32 end = params->vbo_part_offsets[part_idx + 1];
+
+        ENCAS_OMP(parallel for)
+        for (u32 i = begin; i < end; ++i) {
+            u64 vert_idx = params->vbo_orig_idx[i] - vert_offset;
+            params->vbo[3 * i + 0] = mesh_part->vert_array.x[vert_idx];
+            params->vbo[3 * i + 1] = mesh_part->vert_array.y[vert_idx];
+            params->vbo[3 * i + 2] = mesh_part->vert_array.z[vert_idx];
+        }
+
+        vert_offset += mesh_part->vert_array_size;
+    }
+}
+
+// Builds the shell on the first call. When the model geometry only changes its
+// coordinates (change_coords_only, or the topology fingerprint of mesh matches the
+// one the shell was built from) later calls keep ebo, vbo_orig_idx and
+// tria_global_idx and only gather the new coordinates into the vbo.
+// params must be zero initialized (or emptied by Encas_DeleteShellParams) before the first call.
+ENCAS_API void Encas_LoadGeometryShellCached(Encas_Case *encase, Encas_MeshArray *mesh, Encas_ShellParams *params, const Encas_ShellOptions *options) {
+    u64 vertices_size = 0;
+    for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx)
+        vertices_size += mesh->elems[part_idx]->vert_array_size;
+
+    if (params->ebo != NULL
+        && (encase->geometry->model->change_coords_only || (mesh->topology_hash != 0 && params->topology_hash == mesh->topology_hash))
+        && params->orig_vertices_size == vertices_size) {
+        Encas_UpdateGeometryShellCoords(mesh, params);
+        return;
+    }
+
+    Encas_DeleteShellParams(params);
+    Encas_LoadGeometryShellEx(encase, mesh, params, options);
+}
+
+ENCAS_API void Encas_DeleteShellParams(Encas_ShellParams *params) {
+    ENCAS_FREE(params->vbo);
+    ENCAS_FREE(params->vbo_orig_idx);
+    ENCAS_FREE(params->ebo);
+    ENCAS_FREE(params->tria_global_idx);
+    ENCAS_FREE(params->vbo_part_offsets);
+    ENCAS_FREE(params->tria_cell_idx);
+    ENCAS_FREE(params->ebo_part_offsets);
+    ENCAS_FREE(params->weld_map);
+    ENCAS_FREE(params->c2p_row_offsets);
+    ENCAS_FREE(params->c2p_cells);
+    ENCAS_FREE(params->c2p_weights);
+
+    memset(params, 0, sizeof(Encas_ShellParams));
+}
+
+// Buffered file writer of the exporters
+typedef struct Encas_Writer {
+    FILE *f;
+    u8 *buffer;
+    u64 len;
+    bool ok;
+} Encas_Writer;
+
+static void _encas_writer_flush(Encas_Writer *w) {
+    if (w->len && fwrite(w->buffer, 1, w->len, w->f) != w->len)
+        w->ok = false;
+    w->len = 0;
+}
+
+// Makes room for n bytes (n <= ENCAS_EXPORT_BUFFER_SIZE) and returns the write position
+static inline u8 *_encas_writer_reserve(Encas_Writer *w, u64 n) {
+    if (w->len + n > ENCAS_EXPORT_BUFFER_SIZE)
+        _encas_writer_flush(w);
+    return w->buffer + w->len;
+}
+
+static void _encas_writer_write(Encas_Writer *w, const void *data, u64 n) {
+    if (n > ENCAS_EXPORT_BUFFER_SIZE) {
+        // Large blocks go straight to the file
+        _encas_writer_flush(w);
+        if (fwrite(data, 1, n, w->f) != n)
+            w->ok = false;
+        return;
+    }
+
+    memcpy(_encas_writer_reserve(w, n), data, n);
+    w->len += n;
+}
+
+static const char _encas_digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Writes the decimal digits of value to dst, returns the number of characters (at most 20)
+static u32 _encas_format_u64(char *dst, u64 value) {
+    char tmp[20];
+    u32 pos = 20;
+
+    while (value >= 100) {
+        u32 pair = (u32)(value % 100) * 2;
+        value /= 100;
+        tmp[--pos] = _encas_digit_pairs[pair + 1];
+        tmp[--pos] = _encas_digit_pairs[pair];
+    }
+
+    if (value >= 10) {
+        u32 pair = (u32)value * 2;
+        tmp[--pos] = _encas_digit_pairs[pair + 1];
+        tmp[--pos] = _encas_digit_pairs[pair];
+    } else {
+        tmp[--pos] = (char)('0' + value);
+    }
+
+    memcpy(dst, tmp + pos, 20 - pos);
+    return 20 - pos;
+}
+
+// Writes value with at most 6 decimals (trailing zeros dropped), returns the number of
+// characters (at most 32). Values that would not read back as the same float (out of the
+// fixed point range, or needing more decimals) fall back to snprintf("%.9g").
+static u32 _encas_format_f32(char *dst, float value) {
+    double v = value < 0 ? -(double)value : value;
+    if (!(v < 1e12))
+        return (u32)snprintf(dst, 32, "%.9g", (double)value);
+
+    u64 scaled = (u64)(v * 1e6 + 0.5);
+    if ((float)((double)scaled / 1e6) != (float)v)
+        return (u32)snprintf(dst, 32, "%.9g", (double)value);
+
+    if (scaled == 0) {
+        dst[0] = '0';
+        return 1;
+    }
+
+    u32 len = 0;
+    if (value < 0)
+        dst[len++] = '-';
+
+    len += _encas_format_u64(dst + len, scaled / 1000000);
+
+    u32 frac = (u32)(scaled % 1000000);
+    if (frac) {
+        dst[len++] = '.';
+        for (u32 div = 100000; frac; div /= 10) {
+            dst[len++] = (char)('0' + frac / div);
+            frac %= div;
+        }
+    }
+
+    return len;
+}
+
+static void _encas_export_obj(Encas_Writer *w, const Encas_ShellParams *params) {
+    for (u32 vert_idx = 0; vert_idx < params->vbo_size; ++vert_idx) {
+        char *dst = (char *)_encas_writer_reserve(w, 2 + 3 * 33 + 1);
+        u32 len = 0;
+
+        dst[len++] = 'v';
+        for (u32 c = 0; c < 3; ++c) {
+            dst[len++] = ' ';
+            len += _encas_format_f32(dst + len, params->vbo[3 * vert_idx + c]);
+        }
+        dst[len++] = '\n';
+
+        w->len += len;
+    }
+
+    for (u32 tria_idx = 0; tria_idx < params->ebo_size / 3; ++tria_idx) {
+        char *dst = (char *)_encas_writer_reserve(w, 1 + 3 * 21 + 1);
+        u32 len = 0;
+
+        dst[len++] = 'f';
+        for (u32 c = 0; c < 3; ++c) {
+            dst[len++] = ' ';
+            len += _encas_format_u64(dst + len, (u64)params->ebo[3 * tria_idx + c] + 1);
+        }
+        dst[len++] = '\n';
+
+        w->len += len;
+    }
+}
+
+static void _encas_export_ply(Encas_Writer *w, const Encas_ShellParams *params) {
+    const u16 endian_probe = 1;
+    const bool little_endian = *(const u8 *)&endian_probe == 1;
+
+    char header[512];
+    int header_len = snprintf(header, sizeof(header),
+                              "ply\n"
+                              "format %s 1.0\n"
+                              "comment written by encas\n"
+                              "element vertex %u\n"
+                              "property float x\n"
+                              "property float y\n"
+                              "property float z\n"
+                              "element face %u\n"
+                              "property list uchar uint vertex_indices\n"
+                              "end_header\n",
+                              little_endian ? "binary_little_endian" : "binary_big_endian",
+                              params->vbo_size, params->ebo_size / 3);
+    _encas_writer_write(w, header, header_len);
+
+    // The vbo already has the layout of the vertex element
+    _encas_writer_write(w, params->vbo, 3 * (u64)params->vbo_size * sizeof(float));
+
+    const u8 face_size = 3;
+    for (u32 tria_idx = 0; tria_idx < params->ebo_size / 3; ++tria_idx) {
+        u8 *dst = _encas_writer_reserve(w, 1 + 3 * sizeof(u32));
+        dst[0] = face_size;
+        memcpy(dst + 1, params->ebo + 3 * tria_idx, 3 * sizeof(u32));
+        w->len += 1 + 3 * sizeof(u32);
+    }
+}
+
+// Copies count 32-bit values to dst, byte swapped if swap
+static void _encas_store32(u8 *dst, const void *src, u32 count, bool swap) {
+    memcpy(dst, src, count * sizeof(u32));
+    if (!swap)
+        return;
+
+    for (u32 i = 0; i < count; ++i) {
+        u32 v;
+        memcpy(&v, dst + i * sizeof(u32), sizeof(u32));
+        v = _encas_bswap32(v);
+        memcpy(dst + i * sizeof(u32), &v, sizeof(u32));
+    }
+}
+
+// STL is little endian by definition, big endian hosts swap every value
+static void _encas_export_stl(Encas_Writer *w, const Encas_ShellParams *params) {
+    const u16 endian_probe = 1;
+    const bool swap = *(const u8 *)&endian_probe != 1;
+
+    u8 header[80];
+    memset(header, 0, sizeof(header));
+    memcpy(header, "binary STL written by encas", 27);
+    _encas_writer_write(w, header, sizeof(header));
+
+    const u32 tria_count = params->ebo_size / 3;
+    u8 count[sizeof(u32)];
+    _encas_store32(count, &tria_count, 1, swap);
+    _encas_writer_write(w, count, sizeof(count));
+
+    for (u32 tria_idx = 0; tria_idx < tria_count; ++tria_idx) {
+        const float *a = params->vbo + 3 * params->ebo[3 * tria_idx + 0];
+        const float *b = params->vbo + 3 * params->ebo[3 * tria_idx + 1];
+        const float *c = params->vbo + 3 * params->ebo[3 * tria_idx + 2];
+
+        float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        float n[3] = {
+            e1[1] * e2[2] - e1[2] * e2[1],
+            e1[2] * e2[0] - e1[0] * e2[2],
+            e1[0] * e2[1] - e1[1] * e2[0],
+        };
+
+        float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length > 0.f) {
+            n[0] /= length;
+            n[1] /= length;
+            n[2] /= length;
+        }
+
+        u8 *dst = _encas_writer_reserve(w, 50);
+        _encas_store32(dst + 0, n, 3, swap);
+        _encas_store32(dst + 12, a, 3, swap);
+        _encas_store32(dst + 24, b, 3, swap);
+        _encas_store32(dst + 36, c, 3, swap);
+        memset(dst + 48, 0, 2);
+        w->len += 50;
+    }
+}
+
+// Writes the shell surface (vbo + ebo) to filename
+ENCAS_API bool Encas_ExportShell(const Encas_ShellParams *params, const char *filename, Encas_ExportFormat format) {
+    if (!params || !params->vbo || !params->ebo) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Encas_ExportShell: the shell is empty!\n");
+        return false;
+    }
+
+    Encas_Writer w;
+    w.f = fopen(filename, "wb");
+    if (!w.f) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Cannot open '%s' for writing!\n", filename);
+        return false;
+    }
+
+    w.buffer = (u8 *)ENCAS_MALLOC(ENCAS_EXPORT_BUFFER_SIZE);
+    w.len = 0;
+    w.ok = true;
+
+    switch (format) {
+        case ENCAS_EXPORT_OBJ: {
+            _encas_export_obj(&w, params);
+            break;
+        }
+        case ENCAS_EXPORT_PLY: {
+            _encas_export_ply(&w, params);
+            break;
+        }
+        case ENCAS_EXPORT_STL: {
+            _encas_export_stl(&w, params);
+            break;
+        }
+        default: {
+            Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Encas_ExportShell: unknown format!\n");
+            w.ok = false;
+            break;
+        }
+    }
+
+    _encas_writer_flush(&w);
+    if (fclose(w.f) != 0)
+        w.ok = false;
+    ENCAS_FREE(w.buffer);
+
+    if (!w.ok)
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Failed to write '%s'!\n", filename);
+
+    return w.ok;
+}
+
+// Builds the path of pattern (a variable or measured filename of time set *ts) for the given
+// time step into filename (PATH_MAX + 1 bytes). Without ts_set the first time set is used.
+static bool _encas_expand_filename(Encas_Case *encase, Encas_MutStr *pattern, bool ts_set, s32 *ts, u32 time_value_idx, char *filename) {
+    u32 dirname_length = strlen(encase->dirname);
+
+    u32 filename_length = 0;
+
+    memcpy(filename, encase->dirname, dirname_length);
+    filename[dirname_length] = '/';
+    filename_length += dirname_length + 1;
+
+    if (!ts_set && encase->times != NULL && encase->times->len > 0) {
+        *ts = encase->times->elems[0]->time_set_number;
+    }
+
+    Encas_Time *time = NULL;
+
+    if (encase->times != NULL)
+        for (u32 time_idx = 0; time_idx < encase->times->len && time == NULL; ++time_idx)
+            if (encase->times->elems[time_idx]->time_set_number == *ts)
+                time = encase->times->elems[time_idx];
+
+
+    s32 asterisk_idx = Encas_MutStr_FindChar(pattern, '*');
+    if (asterisk_idx == -1) {
+        memcpy(filename + filename_length, pattern->buffer, pattern->len);
+        filename[filename_length + pattern->len] = '\0';
+    } else {
+        if (time == NULL) {
+            Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Encas_LoadVariableData: Time with 'time set number = %d' not found!\n", *ts);
+            return false;
+        }
+
+        u32 asterisk_count = 1;
+        for (u32 i = asterisk_idx + 1; i < pattern->len && pattern->buffer[i] == '*'; ++i)
+            ++asterisk_count;
+
+        u32 file_num = time->filename_start_number + time->filename_increment * time_value_idx;
+
+        // Copy the first part of the filename (before the asterisks)
+        memcpy(filename + filename_length, pattern->buffer, asterisk_idx);
+
+        // Format the number with leading zeros based on asterisk count
+        char tmp[256];
+        snprintf(tmp, 256, "%0*d", asterisk_count, file_num);
+        u32 tmp_len = strlen(tmp);
+        if (tmp_len != asterisk_count) {
+            Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Pattern '*' is shorter than the generated number!\n");
+            return false;
+        }
+
+        // Copy the formatted number
+        memcpy(filename + filename_length + asterisk_idx, tmp, tmp_len);
+
+        // Copy the rest of the filename (after the asterisks)
+        u32 remaining_len = pattern->len - (asterisk_idx + asterisk_count);
+        if (remaining_len > 0) {
+            memcpy(filename + filename_length + asterisk_idx + tmp_len,
+                   pattern->buffer + asterisk_idx + asterisk_count,
+                   remaining_len);
+        }
+
+        // Null-terminate the filename
+        filename[filename_length + asterisk_idx + tmp_len + remaining_len] = '\0';
+    }
+
+    return true;
+}
+
+// Builds the path of the variable file of df for the given time step into filename (PATH_MAX + 1 bytes)
+static bool _encas_variable_filename(Encas_Case *encase, Encas_DescFile *df, u32 time_value_idx, char *filename) {
+    return _encas_expand_filename(encase, &df->filename, df->ts_set, &df->ts, time_value_idx, filename);
+}
+
+// Copies the values of the shell vertices of a per node variable file straight from
+// the mapped file into out (component c of vertex i is stored at i + vbo_size * c).
+// Only the values referenced by the shell are touched, nothing else is loaded.
+static bool _encas_gather_shell_node_variable(Encas_MeshInfo *mesh_info, char *filename, u32 num_of_data, Encas_ShellParams *params, float *out) {
+    if (params->num_parts != mesh_info->len) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Shell was built from a different geometry!\n");
+        return false;
+    }
+
+    if (!check_if_file_exists(filename)) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' variable file doesn't exists!\n", filename);
+        return false;
+    }
+
+    Encas_File *f = _encas_open_gold_file(filename, false);
+    if (!f)
+        return false;
+
+    u64 *coords_offset = (u64 *)ENCAS_MALLOC((mesh_info->len + 1) * sizeof(u64));
+    coords_offset[0] = 0;
+    for (u32 part_idx = 0; part_idx < mesh_info->len; ++part_idx)
+        coords_offset[part_idx + 1] = coords_offset[part_idx] + mesh_info->parts[part_idx].num_of_coords;
 
-        local_faces_offset += 3;
-    }
+    // Parts missing from the variable file stay zero
+    memset(out, 0, num_of_data * params->vbo_size * sizeof(float));
 
-    *faces_offset = local_faces_offset;
-}
+    bool ok = true;
 
-ENCAS_API void Encas_TriangulateTetra4s(u32 *elem_vert_map_array, u32 num_cells, u32 *faces, u64 *faces_offset, u64 vert_offset) {
-    u64 local_faces_offset = *faces_offset;
+    // Skip the description line
+    Encas_FileAdvace(f, 80);
 
-    for (u32 cell_idx = 0; cell_idx < num_cells; ++cell_idx) {
-        faces[local_faces_offset + 0] = elem_vert_map_array[cell_idx * 4 + 0] + vert_offset;
-        faces[local_faces_offset + 1] = elem_vert_map_array[cell_idx * 4 + 1] + vert_offset;
-        faces[local_faces_offset + 2] = elem_vert_map_array[cell_idx * 4 + 2] + vert_offset;
+    _encas_detect_byte_order(f, mesh_info);
 
-        local_faces_offset += 3;
+    // Parts
+    Encas_Str line = Encas_ReadBinaryLine(f);
+    while (ok && Encas_Str_StartsWith(line, Encas_Str_Lit("part"))) {
+        s32 part_num = Encas_ReadS32(f);
 
-        faces[local_faces_offset + 0] = elem_vert_map_array[cell_idx * 4 + 0] + vert_offset;
-        faces[local_faces_offset + 1] = elem_vert_map_array[cell_idx * 4 + 1] + vert_offset;
-        faces[local_faces_offset + 2] = elem_vert_map_array[cell_idx * 4 + 3] + vert_offset;
+        s32 part_num_idx;
+        if (!Encas_SearchHashTable(mesh_info->part_num_lookup, part_num, &part_num_idx)) {
+            Encas_Log(ENCAS_LOG_LEVEL_ERROR, "invalid part number found!\n");
+            ok = false;
+            break;
+        }
 
-        local_faces_offset += 3;
+        const u64 num_of_coords = mesh_info->parts[part_num_idx].num_of_coords;
+        const u64 part_size = num_of_coords * num_of_data * sizeof(float);
 
-        faces[local_faces_offset + 0] = elem_vert_map_array[cell_idx * 4 + 1] + vert_offset;
-        faces[local_faces_offset + 1] = elem_vert_map_array[cell_idx * 4 + 2] + vert_offset;
-        faces[local_faces_offset + 2] = elem_vert_map_array[cell_idx * 4 + 3] + vert_offset;
+        while (!IS_ENCAS_EOF(f)) {
+            line = Encas_ReadBinaryLine(f);
+            if (Encas_Str_StartsWith(line, Encas_Str_Lit("coordinates")) || Encas_Str_StartsWith(line, Encas_Str_Lit("block"))) {
+                if (f->cur + part_size > f->size) {
+                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Variable file '%s' is truncated!\n", filename);
+                    ok = false;
+                    break;
+                }
 
-        local_faces_offset += 3;
+                const bool swap = f->swap;
+                const u32 *orig_idx = params->vbo_orig_idx;
+                const u64 vert_offset = coords_offset[part_num_idx];
+                const u32 begin = params->vbo_part_offsets[part_num_idx];
+                const u32 end = params->vbo_part_offsets[part_num_idx + 1];
 
-        faces[local_faces_offset + 0] = elem_vert_map_array[cell_idx * 4 + 0] + vert_offset;
-        faces[local_faces_offset + 1] = elem_vert_map_array[cell_idx * 4 + 2] + vert_offset;
-        faces[local_faces_offset + 2] = elem_vert_map_array[cell_idx * 4 + 3] + vert_offset;
+                for (u32 c = 0; c < num_of_data; ++c) {
+                    const u8 *src_c = _encas_file_at(f, f->cur + c * num_of_coords * sizeof(float), num_of_coords * sizeof(float));
+                    float *out_c = out + (u64)c * params->vbo_size;
 
-        local_faces_offset += 3;
+                    ENCAS_OMP(parallel for)
+                    for (u32 i = begin; i < end; ++i)
+                        out_c[i] = _encas_load_f32(src_c + (orig_idx[i] - vert_offset) * sizeof(float), swap);
+                }
+
+                Encas_FileAdvace(f, part_size);
+            } else { break; }
+        }
     }
 
-    *faces_offset = local_faces_offset;
+    ENCAS_FREE(coords_offset);
+    Encas_FreeFile(f);
+    return ok;
 }
 
-force_inline void sort3(u32 *a, u32 *b, u32 *c) {
-    if (*a > *b) { u32 t = *a; *a = *b; *b = t; }
-    if (*b > *c) { u32 t = *b; *b = *c; *c = t; }
-    if (*a > *b) { u32 t = *a; *a = *b; *b = t; }
+static u64 _encas_part_cell_count(Encas_Mesh *mesh_part) {
+    u64 num_cells = 0;
+    for (u32 elem_idx = 0; elem_idx < mesh_part->elem_array_size; ++elem_idx)
+        num_cells += mesh_part->elem_array[elem_idx].num_cells;
+    return num_cells;
 }
 
-force_inline u32 next_power_of_two(u32 x) {
-    if (x == 0) return 1;
-    --x;
-    x |= x >> 1;
-    x |= x >> 2;
-    x |= x >> 4;
-    x |= x >> 8;
-    x |= x >> 16;
-    return x + 1;
+// Cell to point rows of an nsided/nfaced block: counts the cells of every row into
+// row_counts, or with cells != NULL writes them at the row cursors.
+// A node repeated on the faces of an nfaced cell adds the cell once.
+static void _encas_cell_to_point_poly(const Encas_Elem *elem, const u32 *part_row_of, u64 cell_offset, u32 *row_counts, u32 *cursor, u32 *cells) {
+    const Encas_PolyElem *poly = elem->poly;
+
+    ENCAS_OMP(parallel for schedule(dynamic, 1024))
+    for (u32 c = 0; c < elem->num_cells; ++c) {
+        u64 begin, end;
+        _encas_poly_cell_nodes(poly, elem->type, c, &begin, &end);
+
+        for (u64 k = begin; k < end; ++k) {
+            u32 row = part_row_of[poly->conn[k]];
+            if (row == UINT32_MAX)
+                continue;
+
+            bool seen = false;
+            for (u64 j = begin; j < k && !seen; ++j)
+                seen = poly->conn[j] == poly->conn[k];
+            if (seen)
+                continue;
+
+            if (cells == NULL) {
+                ENCAS_OMP(atomic)
+                ++row_counts[row];
+            } else {
+                u32 pos;
+                ENCAS_OMP(atomic capture)
+                pos = cursor[row]++;
+                cells[pos] = (u32)(cell_offset + c);
+            }
+        }
+    }
 }
 
-ENCAS_API void Encas_LoadGeometryShell(Encas_Case *encase, Encas_MeshArray *mesh, Encas_ShellParams *params) {
-    u32 *faces; // triangles
-    u64 num_faces = 0;
+// Builds the cell to point operator of the shell. Cells are numbered part by part
+// in element order, the same order as the per element variable data.
+static void _encas_build_cell_to_point(Encas_MeshArray *mesh, Encas_ShellParams *params) {
+    const u32 num_rows = params->vbo_size;
+    const u64 vertices_size = params->orig_vertices_size;
 
-    Encas_Vertex *vertices;
+    u32 *row_of = (u32 *)ENCAS_MALLOC(vertices_size * sizeof(u32));
+    memset(row_of, 0xFF, vertices_size * sizeof(u32));
 
-    u64 vertices_size = 0;
-    for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx)
-        vertices_size += mesh->elems[part_idx]->vert_array_size;
+    ENCAS_OMP(parallel for)
+    for (u32 i = 0; i < num_rows; ++i)
+        row_of[params->vbo_orig_idx[i]] = i;
 
-    vertices = (Encas_Vertex *)ENCAS_MALLOC(vertices_size * sizeof(Encas_Vertex));
+    // Welded vertices average the cells of every part they are shared by
+    if (params->weld_map) {
+        ENCAS_OMP(parallel for)
+        for (u64 i = 0; i < vertices_size; ++i)
+            row_of[i] = row_of[params->weld_map[i]];
+    }
 
+    u32 *row_offsets = (u32 *)ENCAS_MALLOC((num_rows + 1) * sizeof(u32));
+    memset(row_offsets, 0, (num_rows + 1) * sizeof(u32));
 
+    // Count the cells around every shell vertex
     u64 vert_offset = 0;
     for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx) {
         Encas_Mesh *mesh_part = mesh->elems[part_idx];
+        const u32 *part_row_of = row_of + vert_offset;
 
         for (u32 elem_idx = 0; elem_idx < mesh_part->elem_array_size; ++elem_idx) {
-            Encas_Elem_Type type = mesh_part->elem_array[elem_idx].type;
-            u32 num_of_cells = mesh_part->elem_array[elem_idx].elem_vert_map_size / (u32)mesh_part->elem_array[elem_idx].elem_size;
+            Encas_Elem *elem = &mesh_part->elem_array[elem_idx];
+            if (elem->poly) {
+                _encas_cell_to_point_poly(elem, part_row_of, 0, row_offsets + 1, NULL, NULL);
+                continue;
+            }
 
-            num_faces += num_of_cells * Encas_GetCellTrianglesCount(type);
-        }
+            u32 *block_cells;
+            const u32 *conn = _encas_elem_cells(mesh_part, elem, 0, elem->num_cells, &block_cells);
 
-        for (u64 vert_idx = 0; vert_idx < mesh_part->vert_array_size; ++vert_idx) {
-            Encas_Vertex *vs = vertices + vert_offset + vert_idx;
+            ENCAS_OMP(parallel for if(elem->elem_vert_map_size > ENCAS_PARALLEL_MIN))
+            for (u32 k = 0; k < elem->elem_vert_map_size; ++k) {
+                u32 row = part_row_of[conn[k]];
+                if (row != UINT32_MAX) {
+                    ENCAS_OMP(atomic)
+                    ++row_offsets[row + 1];
+                }
+            }
 
-            vs->x = mesh_part->vert_array.x[vert_idx];
-            vs->y = mesh_part->vert_array.y[vert_idx];
-            vs->z = mesh_part->vert_array.z[vert_idx];
+            ENCAS_FREE(block_cells);
         }
 
         vert_offset += mesh_part->vert_array_size;
     }
 
-    faces = (u32 *)ENCAS_MALLOC(3 * num_faces * sizeof(u32));
+    for (u32 i = 0; i < num_rows; ++i)
+        row_offsets[i + 1] += row_offsets[i];
 
-    // Fill the face array
-    vert_offset = 0;
+    u32 *cells = (u32 *)ENCAS_MALLOC((u64)row_offsets[num_rows] * sizeof(u32));
+    u32 *cursor = (u32 *)ENCAS_MALLOC(num_rows * sizeof(u32));
+    memcpy(cursor, row_offsets, num_rows * sizeof(u32));
 
-    u64 face_offset = 0;
+    // Fill the rows
+    vert_offset = 0;
+    u64 cell_offset = 0;
     for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx) {
         Encas_Mesh *mesh_part = mesh->elems[part_idx];
+        const u32 *part_row_of = row_of + vert_offset;
 
         for (u32 elem_idx = 0; elem_idx < mesh_part->elem_array_size; ++elem_idx) {
-            Encas_Elem_Type type = mesh_part->elem_array[elem_idx].type;
-            u32 num_of_cells = mesh_part->elem_array[elem_idx].elem_vert_map_size / (u32)mesh_part->elem_array[elem_idx].elem_size;
+            Encas_Elem *elem = &mesh_part->elem_array[elem_idx];
+            if (elem->poly)
+                _encas_cell_to_point_poly(elem, part_row_of, cell_offset, NULL, cursor, cells);
 
-            switch (type) {
-                case ENCAS_ELEM_TRIA3:
-                    Encas_TriangulateTria3s(mesh_part->elem_vert_map_array + mesh_part->elem_array[elem_idx].elem_vert_map_entry,
-                                             num_of_cells, faces, &face_offset, vert_offset);
-                    break;
-                case ENCAS_ELEM_TETRA4:
-                    Encas_TriangulateTetra4s(mesh_part->elem_vert_map_array + mesh_part->elem_array[elem_idx].elem_vert_map_entry,
-                                             num_of_cells, faces, &face_offset, vert_offset);
-                    break;
-                default:
-                    break;
+            if (!elem->elem_size) {
+                cell_offset += elem->num_cells;
+                continue;
             }
-        }
 
+            u32 *block_cells;
+            const u32 *conn = _encas_elem_cells(mesh_part, elem, 0, elem->num_cells, &block_cells);
+            const u32 vert_cnt = elem->elem_size;
+
+            ENCAS_OMP(parallel for if(elem->elem_vert_map_size > ENCAS_PARALLEL_MIN))
+            for (u32 k = 0; k < elem->elem_vert_map_size; ++k) {
+                u32 row = part_row_of[conn[k]];
+                if (row != UINT32_MAX) {
+                    u32 pos;
+                    ENCAS_OMP(atomic capture)
+                    pos = cursor[row]++;
+                    cells[pos] = (u32)(cell_offset + k / vert_cnt);
+                }
+            }
 
-        vert_offset += mesh_part->vert_array_size;
-    }
-
-    Encas_FaceKeyMap m;
-    Encas_CreateFaceKeyMap(&m, next_power_of_two(2 * num_faces));
-
-    for (u64 tria_idx = 0; tria_idx < num_faces; ++tria_idx) {
-        Encas_FaceKey f;
-        f.v[0] = faces[3 * tria_idx + 0];
-        f.v[1] = faces[3 * tria_idx + 1];
-        f.v[2] = faces[3 * tria_idx + 2];
-
-        sort3(f.v, f.v + 1, f.v + 2);
-
-        u8 num_tria;
-        if (Encas_GetFaceKeyMap(&m, f, &num_tria))
-            Encas_SetFaceKeyMap(&m, f, num_tria + 1, tria_idx);
-        else
-            Encas_SetFaceKeyMap(&m, f, 1, tria_idx);
-    }
-
-    u8 *used_vertices = (u8 *)ENCAS_MALLOC(vertices_size * sizeof(u8));
-    memset(used_vertices, 0, vertices_size * sizeof(u8));
-
-    u32 new_triangle_count = 0;
-
-    for (u32 i = 0; i < m.cap; ++i) {
-        if (m.values[i] == 1) {
-            Encas_FaceKey face = m.keys[i];
-            used_vertices[face.v[0]] = 1;
-            used_vertices[face.v[1]] = 1;
-            used_vertices[face.v[2]] = 1;
-            ++new_triangle_count;
+            ENCAS_FREE(block_cells);
+            cell_offset += elem->num_cells;
         }
-    }
 
-    u32 *remap = (u32 *)ENCAS_MALLOC(sizeof(u32) * vertices_size);
-    u32 new_vertex_count = 0;
-
-    for (u32 i = 0; i < vertices_size; ++i) {
-        if (used_vertices[i])
-            remap[i] = new_vertex_count++;
-    }
-
-    u32 *vbo_orig_idx = (u32 *)ENCAS_MALLOC(new_vertex_count * sizeof(u32));
-    new_vertex_count = 0;
-    for (u32 i = 0; i < vertices_size; ++i) {
-        if (used_vertices[i])
-            vbo_orig_idx[new_vertex_count++] = i;
+        vert_offset += mesh_part->vert_array_size;
     }
 
-    float *vbo = (float *)ENCAS_MALLOC(3 * new_vertex_count * sizeof(float));
-    for (u32 i = 0; i < vertices_size; ++i) {
-        if (used_vertices[i]) {
-            vbo[3 * remap[i] + 0] = vertices[i].x;
-            vbo[3 * remap[i] + 1] = vertices[i].y;
-            vbo[3 * remap[i] + 2] = vertices[i].z;
+    // Sort the rows so the sums don't depend on the thread schedule, rows are short
+    float *weights = (float *)ENCAS_MALLOC(num_rows * sizeof(float));
+    ENCAS_OMP(parallel for)
+    for (u32 i = 0; i < num_rows; ++i) {
+        u32 begin = row_offsets[i], end = row_offsets[i + 1];
+        for (u32 j = begin + 1; j < end; ++j) {
+            u32 cell = cells[j];
+            u32 k = j;
+            for (; k > begin && cells[k - 1] > cell; --k)
+                cells[k] = cells[k - 1];
+            cells[k] = cell;
         }
-    }
 
-    u32 *visible_triangle_indices = (u32 *)ENCAS_MALLOC(sizeof(u32) * 3 * new_triangle_count);
-    params->tria_global_idx = (u32 *)ENCAS_MALLOC(new_triangle_count * sizeof(u32));
-
-    u32 j = 0;
-
-    for (u32 i = 0; i < m.cap; ++i) {
-        if (m.values[i] == 1) {
-            Encas_FaceKey face = m.keys[i];
-            params->tria_global_idx[j / 3] = m.global_indices[i];
-            visible_triangle_indices[j++] = remap[face.v[0]];
-            visible_triangle_indices[j++] = remap[face.v[1]];
-            visible_triangle_indices[j++] = remap[face.v[2]];
-        }
+        weights[i] = end > begin ? 1.f / (float)(end - begin) : 0.f;
     }
 
-    printf("new_vertex_count = %d\n", new_vertex_count);
-    printf("new_triangle_count = %d\n", new_triangle_count);
-
-    FILE *f = fopen("ki.obj", "w");
-    for (u32 vert_idx = 0; vert_idx < new_vertex_count; ++vert_idx)
-        fprintf(f, "v %f %f %f\n", vbo[vert_idx * 3 + 0], vbo[vert_idx * 3 + 1], vbo[vert_idx * 3 + 2]);
-    for (u32 tria_idx = 0; tria_idx < new_triangle_count; ++tria_idx)
-        fprintf(f, "f %d %d %d\n", visible_triangle_indices[tria_idx * 3 + 0] + 1, visible_triangle_indices[tria_idx * 3 + 1] + 1, visible_triangle_indices[tria_idx * 3 + 2] + 1);
-    fclose(f);
-
-    params->vbo = vbo;
-    params->vbo_size = new_vertex_count;
-    params->vbo_orig_idx = vbo_orig_idx;
-    params->ebo = visible_triangle_indices;
-    params->ebo_size = new_triangle_count * 3;
-    params->global_ebo_size = num_faces;
-
-    ENCAS_FREE(used_vertices);
-    ENCAS_FREE(remap);
+    ENCAS_FREE(cursor);
+    ENCAS_FREE(row_of);
 
-    Encas_DeleteFaceKeyMap(&m);
-    ENCAS_FREE(vertices);
-    ENCAS_FREE(faces);
+    params->c2p_row_offsets = row_offsets;
+    params->c2p_cells = cells;
+    params->c2p_weights = weights;
+    params->c2p_num_cells = cell_offset;
 }
 
 ENCAS_API bool Encas_LoadVariableOnShell_Vertices(Encas_Case *encase, Encas_MeshArray *mesh, u32 variable_idx, u32 time_value_idx, Encas_ShellParams *params, float **var_vbo_out) {
     Encas_DescFile *variable = encase->variable->elems[variable_idx];
-
-    // TODO: Load variable data from FlatVariable
-
-    float **var_data = Encas_LoadVariableData(encase, time_value_idx, variable_idx);
-    if (var_data == NULL) {
-        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Could't load ensight gold variable!\n");
+    if (Encas_VariableIsMeasured(variable->type)) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Measured variables have no values on the shell!\n");
         return false;
     }
 
-    u32 dimension_count = (variable->type == ENCAS_VARIABLE_SCALAR_PER_ELEMENT
-                           || variable->type == ENCAS_VARIABLE_SCALAR_PER_NODE) ? 1 : 3;
-
-    // Flatten the variable matrix
+    u32 dimension_count = Encas_VariableNumComponents(variable->type);
 
     u32 mesh_info_array_idx = time_value_idx;
     if (time_value_idx > encase->geometry->model->num_of_files - 1)
@@ -2973,158 +7126,77 @@ ENCAS_API bool Encas_LoadVariableOnShell_Vertices(Encas_Case *encase, Encas_Mesh
 
     Encas_MeshInfo *mesh_info = &encase->geometry->model->mesh_info_array.elems[mesh_info_array_idx];
 
-    u64 vertices_size = 0;
-    u64 var_offset = 0;
-    for (u32 part_idx = 0; part_idx < mesh_info->len; ++part_idx) {
-        Encas_MeshInfoPart *part = mesh_info->parts + part_idx;
-        vertices_size += (u64)part->num_of_coords;
-    }
-
     float *local_var_vbo_out = (float *)ENCAS_MALLOC(dimension_count * params->vbo_size * sizeof(float));
-    if (variable->type == ENCAS_VARIABLE_SCALAR_PER_NODE) {
-        float *vertex_data = (float *)ENCAS_MALLOC(vertices_size * sizeof(float));
-
-        for (u32 part_idx = 0; part_idx < mesh_info->len; ++part_idx) {
-            Encas_MeshInfoPart *part = mesh_info->parts + part_idx;
-            u64 num_of_coords = part->num_of_coords;
-
-            memcpy(vertex_data + var_offset, var_data[part_idx], num_of_coords * sizeof(float));
-            var_offset += num_of_coords;
-        }
-
-        for (u32 i = 0; i < params->vbo_size; ++i)
-            local_var_vbo_out[i] = vertex_data[params->vbo_orig_idx[i]];
-
-
-        ENCAS_FREE(vertex_data);
-    } else if (variable->type == ENCAS_VARIABLE_VECTOR_PER_NODE) {
-        float *vertex_data = (float *)ENCAS_MALLOC(3 * vertices_size * sizeof(float));
-
-        for (u32 part_idx = 0; part_idx < mesh_info->len; ++part_idx) {
-            Encas_MeshInfoPart *part = mesh_info->parts + part_idx;
-            u64 num_of_coords = part->num_of_coords;
-
-            for (u64 i = 0; i < num_of_coords; ++i) {
-                vertex_data[var_offset + vertices_size * 0] = var_data[part_idx][i + 0 * num_of_coords];
-                vertex_data[var_offset + vertices_size * 1] = var_data[part_idx][i + 1 * num_of_coords];
-                vertex_data[var_offset + vertices_size * 2] = var_data[part_idx][i + 2 * num_of_coords];
-
-                ++var_offset;
-            }
-        }
-
-        for (u32 i = 0; i < params->vbo_size; ++i) {
-            u32 idx = params->vbo_orig_idx[i];
-            local_var_vbo_out[i + params->vbo_size * 0] = vertex_data[idx + vertices_size * 0];
-            local_var_vbo_out[i + params->vbo_size * 1] = vertex_data[idx + vertices_size * 1];
-            local_var_vbo_out[i + params->vbo_size * 2] = vertex_data[idx + vertices_size * 2];
+    if (!Encas_VariableIsPerElement(variable->type)) {
+        // Read only the shell vertices straight from the variable file
+        char filename[PATH_MAX + 1];
+        if (!_encas_variable_filename(encase, variable, time_value_idx, filename)
+            || !_encas_gather_shell_node_variable(mesh_info, filename, dimension_count, params, local_var_vbo_out)) {
+            Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Could't load ensight gold variable!\n");
+            ENCAS_FREE(local_var_vbo_out);
+            return false;
         }
-
-        ENCAS_FREE(vertex_data);
     } else {
-        // ENCAS_VARIABLE_SCALAR_PER_ELEMENT or ENCAS_VARIABLE_VECTOR_PER_ELEMENT
-        const u32 pool_size = dimension_count * vertices_size * sizeof(float) + vertices_size * sizeof(u32);
-        u8 *pool = (u8 *)ENCAS_MALLOC(pool_size);
-        float *node_values = (float *)pool;
-        u32 *node_counts = (u32 *)(pool + dimension_count * vertices_size * sizeof(float));
-
-        memset(pool, 0, pool_size);
-
-        u32 *coords_offset = (u32 *)ENCAS_MALLOC(mesh_info->len * sizeof(u32));
-        coords_offset[0] = 0;
-        for (u32 part_idx = 1; part_idx < mesh_info->len; ++part_idx)
-            coords_offset[part_idx] = coords_offset[part_idx - 1] + mesh_info->parts[part_idx - 1].num_of_coords;
-
-        if (variable->type == ENCAS_VARIABLE_SCALAR_PER_ELEMENT) {
-            for (u32 part_idx = 0; part_idx < mesh_info->len; ++part_idx) {
-                float *part_data = var_data[part_idx];
-                Encas_Mesh *mpart = mesh->elems[part_idx];
-
-                Encas_MeshInfoPart *mesh_part = &mesh_info->parts[part_idx];
+        // Per element variable
+        float **var_data = Encas_LoadVariableData(encase, time_value_idx, variable_idx);
+        if (var_data == NULL) {
+            Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Could't load ensight gold variable!\n");
+            ENCAS_FREE(local_var_vbo_out);
+            return false;
+        }
 
-                for (u32 elem_idx = 0; elem_idx < mesh_part->len; ++elem_idx) {
-                    u32 vert_cnt = _get_elem_vert_count(mpart->elem_array[elem_idx].type);
+        if (params->c2p_row_offsets == NULL)
+            _encas_build_cell_to_point(mesh, params);
 
-                    for (u32 cell_idx = 0; cell_idx < mesh_part->elem_sizes[elem_idx]; ++cell_idx) {
-                        const u32 val_idx = mesh_part->elem_offsets[elem_idx] + cell_idx;
-                        for (u32 node_idx = 0; node_idx < vert_cnt; ++node_idx) {
-                            u32 vert_idx = mpart->elem_vert_map_array[mpart->elem_array[elem_idx].elem_vert_map_entry + cell_idx * vert_cnt + node_idx];
-                            const u32 final_idx = vert_idx + coords_offset[part_idx];
+        // Flatten the cell values of every part, component by component
+        const u64 num_cells = params->c2p_num_cells;
+        float *cell_values = (float *)ENCAS_MALLOC(dimension_count * num_cells * sizeof(float));
 
-                            node_values[final_idx] += part_data[val_idx];
-                            ++node_counts[final_idx];
-                        }
-                    }
-                }
+        u64 cell_offset = 0;
+        for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx) {
+            Encas_MeshInfoPart *minfo_part = &mesh_info->parts[part_idx];
+            const u64 part_cells = _encas_part_cell_count(mesh->elems[part_idx]);
 
-            }
+            u64 part_stride = 0;
+            for (u32 elem_idx = 0; elem_idx < (u32)minfo_part->len; ++elem_idx)
+                part_stride += minfo_part->elem_sizes[elem_idx];
 
-            for (u32 i = 0; i < vertices_size; ++i) {
-                if (node_counts[i] > 0)
-                    node_values[i] /= node_counts[i];
+            for (u32 c = 0; c < dimension_count; ++c) {
+                float *dst = cell_values + c * num_cells + cell_offset;
+                if (var_data[part_idx])
+                    memcpy(dst, var_data[part_idx] + c * part_stride, part_cells * sizeof(float));
                 else
-                    node_values[i] = 0.f;
+                    memset(dst, 0, part_cells * sizeof(float));
             }
 
-            for (u32 i = 0; i < params->vbo_size; ++i)
-                local_var_vbo_out[i] = node_values[params->vbo_orig_idx[i]];
-        } else {
-            for (u32 part_idx = 0; part_idx < mesh_info->len; ++part_idx) {
-                float *part_data = var_data[part_idx];
-                Encas_MeshInfoPart *mesh_part = &mesh_info->parts[part_idx];
-                u32 num_of_total_cells = mesh_part->elem_offsets[mesh_part->len - 1] + mesh_part->elem_sizes[mesh_part->len - 1];
-
-                Encas_Mesh *mpart = mesh->elems[part_idx];
-
-
-                for (u32 elem_idx = 0; elem_idx < mesh_part->len; ++elem_idx) {
-                    u32 vert_cnt = _get_elem_vert_count(mpart->elem_array[elem_idx].type);
-
-                    for (u32 cell_idx = 0; cell_idx < mesh_part->elem_sizes[elem_idx]; ++cell_idx) {
-                        const u32 val_idx = mesh_part->elem_offsets[elem_idx] + cell_idx;
-                        for (u32 node_idx = 0; node_idx < vert_cnt; ++node_idx) {
-                            u32 vert_idx = mpart->elem_vert_map_array[mpart->elem_array[elem_idx].elem_vert_map_entry + cell_idx * vert_cnt + node_idx];
-                            const u32 final_idx = vert_idx + coords_offset[part_idx];
-
-                            node_values[final_idx + vertices_size * 0] += part_data[val_idx + num_of_total_cells * 0];
-                            node_values[final_idx + vertices_size * 1] += part_data[val_idx + num_of_total_cells * 1];
-                            node_values[final_idx + vertices_size * 2] += part_data[val_idx + num_of_total_cells * 2];
-                            ++node_counts[final_idx];
-                        }
-                    }
-                }
+            cell_offset += part_cells;
+        }
 
-            }
+        // Average the cells around every shell vertex (SpMV)
+        const u32 *row_offsets = params->c2p_row_offsets;
+        const u32 *cells = params->c2p_cells;
+        const float *weights = params->c2p_weights;
 
-            for (u32 i = 0; i < vertices_size; ++i) {
-                if (node_counts[i] > 0) {
-                    node_values[i + vertices_size * 0] /= node_counts[i];
-                    node_values[i + vertices_size * 1] /= node_counts[i];
-                    node_values[i + vertices_size * 2] /= node_counts[i];
-                }
-                else {
-                    node_values[i] = 0.f;
-                }
-            }
+        for (u32 c = 0; c < dimension_count; ++c) {
+            const float *values = cell_values + c * num_cells;
+            float *out = local_var_vbo_out + (u64)c * params->vbo_size;
 
+            ENCAS_OMP(parallel for)
             for (u32 i = 0; i < params->vbo_size; ++i) {
-                u32 idx = params->vbo_orig_idx[i];
-                local_var_vbo_out[i + params->vbo_size * 0] = node_values[idx + vertices_size * 0];
-                local_var_vbo_out[i + params->vbo_size * 1] = node_values[idx + vertices_size * 1];
-                local_var_vbo_out[i + params->vbo_size * 2] = node_values[idx + vertices_size * 2];
+                float sum = 0.f;
+                for (u32 j = row_offsets[i]; j < row_offsets[i + 1]; ++j)
+                    sum += values[cells[j]];
+                out[i] = sum * weights[i];
             }
-
         }
 
+        ENCAS_FREE(cell_values);
 
-        ENCAS_FREE(coords_offset);
-        ENCAS_FREE(pool);
-    }
-
-    for (u32 part_idx = 0; part_idx < mesh_info->len; ++part_idx)
-        ENCAS_FREE(var_data[part_idx]);
+        for (u32 part_idx = 0; part_idx < mesh_info->len; ++part_idx)
+            ENCAS_FREE(var_data[part_idx]);
 
-    ENCAS_FREE(var_data);
+        ENCAS_FREE(var_data);
+    }
 
     *var_vbo_out = local_var_vbo_out;
     return true;
@@ -3141,8 +7213,7 @@ ENCAS_API bool Encas_LoadVariableOnShell_Elements(Encas_Case *encase, Encas_Mesh
         return false;
     }
 
-    u32 dimension_count = (variable->type == ENCAS_VARIABLE_SCALAR_PER_ELEMENT
-                           || variable->type == ENCAS_VARIABLE_SCALAR_PER_NODE) ? 1 : 3;
+    u32 dimension_count = Encas_VariableNumComponents(variable->type);
 
     u32 mesh_info_array_idx = time_value_idx;
     if (time_value_idx > encase->geometry->model->num_of_files - 1)
@@ -3153,79 +7224,33 @@ ENCAS_API bool Encas_LoadVariableOnShell_Elements(Encas_Case *encase, Encas_Mesh
 
     u32 tria_count = params->ebo_size / 3;
     float *local_var_vbo = (float *)ENCAS_MALLOC(dimension_count * tria_count * sizeof(float));
-    if (variable->type == ENCAS_VARIABLE_SCALAR_PER_ELEMENT || variable->type == ENCAS_VARIABLE_VECTOR_PER_ELEMENT) {
-        u32 num_all_tria = params->global_ebo_size;
-
-        float *tria_var_lookup = (float *)ENCAS_MALLOC(dimension_count * num_all_tria * sizeof(float));
-
-        u32 g_tria_idx = 0;
-
-        if (variable->type == ENCAS_VARIABLE_SCALAR_PER_ELEMENT) {
-            for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx) {
-                float *part_data = var_data[part_idx];
-                Encas_Mesh *mesh_part = mesh->elems[part_idx];
-                Encas_MeshInfoPart *minfo_part = &mesh_info->parts[part_idx];
-
-                for (u32 elem_idx = 0; elem_idx < mesh_part->elem_array_size; ++elem_idx) {
-                    Encas_Elem *elem = &mesh_part->elem_array[elem_idx];
-                    u32 num_cells = elem->elem_vert_map_size / elem->elem_size;
-                    u32 num_tria_cell = Encas_GetCellTrianglesCount(elem->type);
-
-                    for (u32 cell_idx = 0; cell_idx < num_cells; ++cell_idx) {
-                        u32   val_idx = minfo_part->elem_offsets[elem_idx] + cell_idx;
-                        float val = part_data[val_idx];
-
-                        for (u32 tria_idx = 0; tria_idx < num_tria_cell; ++tria_idx)
-                            tria_var_lookup[g_tria_idx++] = val;
-                    }
-                }
-            }
-
-            for (u32 tria_idx = 0; tria_idx < tria_count; ++tria_idx) {
-                float value = tria_var_lookup[params->tria_global_idx[tria_idx]];
-                local_var_vbo[tria_idx] = value;
-            }
-        } else {
-            for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx) {
-                float *part_data = var_data[part_idx];
-                Encas_Mesh *mesh_part = mesh->elems[part_idx];
-                Encas_MeshInfoPart *minfo_part = &mesh_info->parts[part_idx];
-                const u32 num_of_total_cells = minfo_part->elem_offsets[minfo_part->len - 1] + minfo_part->elem_sizes[minfo_part->len - 1];
-
-                for (u32 elem_idx = 0; elem_idx < mesh_part->elem_array_size; ++elem_idx) {
-                    Encas_Elem *elem = &mesh_part->elem_array[elem_idx];
-                    u32 num_cells = elem->elem_vert_map_size / elem->elem_size;
-                    u32 num_tria_cell = Encas_GetCellTrianglesCount(elem->type);
-
-                    for (u32 cell_idx = 0; cell_idx < num_cells; ++cell_idx) {
-                        u32   val_idx = minfo_part->elem_offsets[elem_idx] + cell_idx;
-
-                        float val_x = part_data[val_idx + num_of_total_cells * 0];
-                        float val_y = part_data[val_idx + num_of_total_cells * 1];
-                        float val_z = part_data[val_idx + num_of_total_cells * 2];
-
-                        for (u32 tria_idx = 0; tria_idx < num_tria_cell; ++tria_idx) {
-                            tria_var_lookup[g_tria_idx * 3 + 0] = val_x;
-                            tria_var_lookup[g_tria_idx * 3 + 1] = val_y;
-                            tria_var_lookup[g_tria_idx * 3 + 2] = val_z;
-                            ++g_tria_idx;
-                        }
-                    }
+    if (Encas_VariableIsPerElement(variable->type)) {
+        // Gather the value of the cell of every shell triangle
+        for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx) {
+            const float *part_data = var_data[part_idx];
+            Encas_MeshInfoPart *minfo_part = &mesh_info->parts[part_idx];
+            const u32 begin = params->ebo_part_offsets[part_idx];
+            const u32 end = params->ebo_part_offsets[part_idx + 1];
+
+            u64 num_of_total_cells = 0;
+            for (u32 elem_idx = 0; elem_idx < (u32)minfo_part->len; ++elem_idx)
+                num_of_total_cells += minfo_part->elem_sizes[elem_idx];
+
+            for (u32 c = 0; c < dimension_count; ++c) {
+                float *out = local_var_vbo + (u64)c * tria_count;
+
+                if (part_data == NULL) {
+                    memset(out + begin, 0, (end - begin) * sizeof(float));
+                    continue;
                 }
-            }
 
-            for (u32 tria_idx = 0; tria_idx < tria_count; ++tria_idx) {
-                float value_x = tria_var_lookup[params->tria_global_idx[tria_idx] * 3 + 0];
-                float value_y = tria_var_lookup[params->tria_global_idx[tria_idx] * 3 + 1];
-                float value_z = tria_var_lookup[params->tria_global_idx[tria_idx] * 3 + 2];
+                const float *values = part_data + c * num_of_total_cells;
 
-                local_var_vbo[tria_idx + tria_count * 0] = value_x;
-                local_var_vbo[tria_idx + tria_count * 1] = value_y;
-                local_var_vbo[tria_idx + tria_count * 2] = value_z;
+                ENCAS_OMP(parallel for)
+                for (u32 tria_idx = begin; tria_idx < end; ++tria_idx)
+                    out[tria_idx] = values[params->tria_cell_idx[tria_idx]];
             }
         }
-
-        ENCAS_FREE(tria_var_lookup);
     } else {
         u64 vertices_size = 0;
         u64 var_offset = 0;
@@ -3236,55 +7261,26 @@ ENCAS_API bool Encas_LoadVariableOnShell_Elements(Encas_Case *encase, Encas_Mesh
 
         float *vertex_data = (float *)ENCAS_MALLOC(dimension_count * vertices_size * sizeof(float));
 
-        if (variable->type == ENCAS_VARIABLE_SCALAR_PER_NODE) {
-            for (u32 part_idx = 0; part_idx < mesh_info->len; ++part_idx) {
-                Encas_MeshInfoPart *part = mesh_info->parts + part_idx;
-                u64 num_of_coords = part->num_of_coords;
+        // Interleave the components of every vertex, then average them over the triangles
+        for (u32 part_idx = 0; part_idx < mesh_info->len; ++part_idx) {
+            Encas_MeshInfoPart *part = mesh_info->parts + part_idx;
+            u64 num_of_coords = part->num_of_coords;
 
-                memcpy(vertex_data + var_offset, var_data[part_idx], num_of_coords * sizeof(float));
-                var_offset += num_of_coords;
-            }
+            for (u64 i = 0; i < num_of_coords; ++i) {
+                for (u32 c = 0; c < dimension_count; ++c)
+                    vertex_data[var_offset * dimension_count + c] = var_data[part_idx][i + c * num_of_coords];
 
-            for (u32 tria_idx = 0; tria_idx < tria_count; ++tria_idx) {
-                local_var_vbo[tria_idx] = (
-                    vertex_data[params->vbo_orig_idx[params->ebo[tria_idx * 3 + 0]]] +
-                    vertex_data[params->vbo_orig_idx[params->ebo[tria_idx * 3 + 1]]] +
-                    vertex_data[params->vbo_orig_idx[params->ebo[tria_idx * 3 + 2]]]
-                ) / 3;
+                ++var_offset;
             }
-        } else {
-            for (u32 part_idx = 0; part_idx < mesh_info->len; ++part_idx) {
-                Encas_MeshInfoPart *part = mesh_info->parts + part_idx;
-                u64 num_of_coords = part->num_of_coords;
-
-                for (u64 i = 0; i < num_of_coords; ++i) {
-                    vertex_data[var_offset * 3 + 0] = var_data[part_idx][i + 0 * num_of_coords];
-                    vertex_data[var_offset * 3 + 1] = var_data[part_idx][i + 1 * num_of_coords];
-                    vertex_data[var_offset * 3 + 2] = var_data[part_idx][i + 2 * num_of_coords];
+        }
 
-                    ++var_offset;
-                }
-            }
+        for (u32 tria_idx = 0; tria_idx < tria_count; ++tria_idx) {
+            const u64 v0 = (u64)params->vbo_orig_idx[params->ebo[tria_idx * 3 + 0]] * dimension_count;
+            const u64 v1 = (u64)params->vbo_orig_idx[params->ebo[tria_idx * 3 + 1]] * dimension_count;
+            const u64 v2 = (u64)params->vbo_orig_idx[params->ebo[tria_idx * 3 + 2]] * dimension_count;
 
-            for (u32 tria_idx = 0; tria_idx < tria_count; ++tria_idx) {
-                local_var_vbo[tria_idx + tria_count * 0] = (
-                    vertex_data[params->vbo_orig_idx[params->ebo[tria_idx * 3 + 0]] * 3 + 0] +
-                    vertex_data[params->vbo_orig_idx[params->ebo[tria_idx * 3 + 1]] * 3 + 0] +
-                    vertex_data[params->vbo_orig_idx[params->ebo[tria_idx * 3 + 2]] * 3 + 0]
-                ) / 3;
-
-                local_var_vbo[tria_idx + tria_count * 1] = (
-                    vertex_data[params->vbo_orig_idx[params->ebo[tria_idx * 3 + 0]] * 3 + 1] +
-                    vertex_data[params->vbo_orig_idx[params->ebo[tria_idx * 3 + 1]] * 3 + 1] +
-                    vertex_data[params->vbo_orig_idx[params->ebo[tria_idx * 3 + 2]] * 3 + 1]
-                ) / 3;
-
-                local_var_vbo[tria_idx + tria_count * 2] = (
-                    vertex_data[params->vbo_orig_idx[params->ebo[tria_idx * 3 + 0]] * 3 + 2] +
-                    vertex_data[params->vbo_orig_idx[params->ebo[tria_idx * 3 + 1]] * 3 + 2] +
-                    vertex_data[params->vbo_orig_idx[params->ebo[tria_idx * 3 + 2]] * 3 + 2]
-                ) / 3;
-            }
+            for (u32 c = 0; c < dimension_count; ++c)
+                local_var_vbo[tria_idx + tria_count * c] = (vertex_data[v0 + c] + vertex_data[v1 + c] + vertex_data[v2 + c]) / 3;
         }
 
         ENCAS_FREE(vertex_data);
@@ -3306,30 +7302,46 @@ ENCAS_API void Encas_DeleteFloatArrParts(float **data, u32 num_of_parts) {
     ENCAS_FREE(data);
 }
 
-// num_of_data: 1 for scalar
-//              3 for vector
-ENCAS_API float **Encas_ReadVariableDataPerElement(Encas_Case *encase, Encas_MeshInfo *mesh_info, char *filename, u32 num_of_data) {
-    if (!check_if_file_exists(filename)) {
-        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' variable file doesn't exists!\n", filename);
-        return NULL;
-    }
+static u64 _encas_owned_cell_count(const Encas_MeshInfoPart *part) {
+    u64 num_cells = 0;
+    for (s32 elem_idx = 0; elem_idx < part->len; ++elem_idx)
+        if (!part->elem_ghost[elem_idx])
+            num_cells += part->elem_sizes[elem_idx];
+    return num_cells;
+}
 
-    Encas_File *f = Encas_SlurpFile(filename);
-    float **parts = (float **)ENCAS_MALLOC(mesh_info->len * sizeof(float *));
-    if (!parts) {
-        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Failed to allocate memory for variable data\n");
-        Encas_FreeFile(f);
-        return NULL;
-    }
+// Index of the next owned (or ghost) element block of the part from *cursor, -1 if there are no more.
+// The owned and the ghost blocks have their own cursors, so the variable file may leave out the g_ blocks.
+static s32 _encas_next_elem_block(const Encas_MeshInfoPart *part, bool is_ghost, u32 *cursor) {
+    while (*cursor < (u32)part->len && part->elem_ghost[*cursor] != is_ghost)
+        ++*cursor;
+    return *cursor < (u32)part->len ? (s32)(*cursor)++ : -1;
+}
 
-    // Initialize parts
-    for (u32 i = 0; i < mesh_info->len; ++i) {
-        parts[i] = NULL;
+// Copies n 32 bit values from the file buffer to every stride-th float of dst
+static void _encas_copy32_strided(float *dst, const u8 *src, u64 n, u64 stride, bool swap) {
+    if (stride == 1) {
+        _encas_copy32(dst, src, n, swap);
+        return;
     }
 
+    for (u64 i = 0; i < n; ++i)
+        dst[i * stride] = _encas_load_f32(src + i * sizeof(float), swap);
+}
+
+// Reads every part of a per node or per element variable file into parts. A part with count
+// values (nodes or cells times num_of_data) is allocated with count * num_of_slots floats the
+// first time a file names it, value j goes to slot of it: j + slot * count for the split
+// layout and j * num_of_slots + slot for the interleaved one. A plain variable is slot 0 of 1.
+static bool _encas_read_variable_file(Encas_File *f, Encas_MeshInfo *mesh_info, u32 num_of_data, bool per_element,
+                                      float **parts, u32 slot, u32 num_of_slots, Encas_ComplexLayout layout) {
     // Skip the description line
     Encas_FileAdvace(f, 80);
 
+    _encas_detect_byte_order(f, mesh_info);
+
+    const u64 stride = layout == ENCAS_COMPLEX_INTERLEAVED ? num_of_slots : 1;
+
     // Parts
     Encas_Str line = Encas_ReadBinaryLine(f);
     while (Encas_Str_StartsWith(line, Encas_Str_Lit("part"))) {
@@ -3338,61 +7350,129 @@ ENCAS_API float **Encas_ReadVariableDataPerElement(Encas_Case *encase, Encas_Mes
         s32 part_num_idx;
         if (!Encas_SearchHashTable(mesh_info->part_num_lookup, part_num, &part_num_idx)) {
             Encas_Log(ENCAS_LOG_LEVEL_ERROR, "invalid part number found!\n");
-            Encas_DeleteFloatArrParts(parts, mesh_info->len);
-            Encas_FreeFile(f);
-            return NULL;
+            return false;
+        }
+
+        Encas_MeshInfoPart *part = &mesh_info->parts[part_num_idx];
+
+        u32 num_of_total_cells = 0;
+        for (u32 elem_idx = 0; elem_idx < (u32)part->len; ++elem_idx)
+            num_of_total_cells += part->elem_sizes[elem_idx];
+
+        const u64 count = (per_element ? (u64)num_of_total_cells : (u64)part->num_of_coords) * num_of_data;
+        if (parts[part_num_idx] == NULL) {
+            parts[part_num_idx] = (float *)ENCAS_MALLOC(count * num_of_slots * sizeof(float));
+
+            // Ghost cells (and complex values) missing from the file read as 0
+            if (num_of_slots > 1 || (per_element && part->num_ghost_elemtypes))
+                memset(parts[part_num_idx], 0, count * num_of_slots * sizeof(float));
         }
 
-        u32 alloc_size = 0;
-        for (u32 elem_idx = 0; elem_idx < mesh_info->parts[part_num_idx].len; ++elem_idx)
-            alloc_size += mesh_info->parts[part_num_idx].elem_sizes[elem_idx];
+        float *dst = parts[part_num_idx] + (layout == ENCAS_COMPLEX_INTERLEAVED ? slot : slot * count);
+
+        if (!per_element) {
+            while (!IS_ENCAS_EOF(f)) {
+                line = Encas_ReadBinaryLine(f);
+                // Block parts store their nodes like the coordinates, i fastest
+                if (Encas_Str_StartsWith(line, Encas_Str_Lit("coordinates")) || Encas_Str_StartsWith(line, Encas_Str_Lit("block"))) {
+                    if (f->cur + count * sizeof(float) > f->size) {
+                        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Variable file is truncated!\n");
+                        return false;
+                    }
+
+                    // Every component is a record of its own in Fortran Binary
+                    const u64 num_of_coords = part->num_of_coords;
+                    for (u32 c = 0; c < num_of_data; ++c)
+                        _encas_copy32_strided(dst + c * num_of_coords * stride, _encas_file_at(f, f->cur + c * num_of_coords * sizeof(float), num_of_coords * sizeof(float)),
+                                              num_of_coords, stride, f->swap);
+                    Encas_FileAdvace(f, count * sizeof(float));
 
-        alloc_size *= num_of_data;
-        parts[part_num_idx] = (float *)ENCAS_MALLOC(alloc_size * sizeof(float));
+                } else { break; }
+            }
+            continue;
+        }
 
         u32 data_ptr = 0;
-        //parts_data[part_num_idx] = Encas_CreateScalarPerElementArray(mesh_arr->elems[part_num_idx]->elem_array_size);
+        u32 ghost_data_ptr = (u32)_encas_owned_cell_count(part);
 
-        Encas_Elem_Type elem_type;
         bool is_ghost = false;
 
-        u32 elem_idx = 0;
+        u32 owned_cursor = 0, ghost_cursor = 0;
 
         // element type
         while (!IS_ENCAS_EOF(f)) {
             line = Encas_ReadBinaryLine(f);
+            is_ghost = false;
 
-            if ((elem_type = Encas_ReadElemType(line, &is_ghost)) != ENCAS_ELEM_UNKNOWN) {
-                if (is_ghost) {
-                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Something unexpected happended: ghost elem type found in scalar per element file ('%s')!\n", filename);
-                    Encas_DeleteFloatArrParts(parts, mesh_info->len);
-                    Encas_FreeFile(f);
-                    return NULL;
-                }
-
-                if (elem_idx > mesh_info->parts[part_num_idx].len - 1) {
+            // A block part has a single element block
+            if (Encas_Str_StartsWith(line, Encas_Str_Lit("block")) || Encas_ReadElemType(line, &is_ghost) != ENCAS_ELEM_UNKNOWN) {
+                s32 elem_idx = _encas_next_elem_block(part, is_ghost, is_ghost ? &ghost_cursor : &owned_cursor);
+                if (elem_idx < 0) {
                     Encas_Log(ENCAS_LOG_LEVEL_ERROR, "elem_idx out of range!\n");
-                    Encas_DeleteFloatArrParts(parts, mesh_info->len);
-                    Encas_FreeFile(f);
-                    return NULL;
+                    return false;
                 }
 
-                u32 num_of_elems = mesh_info->parts[part_num_idx].elem_sizes[elem_idx];
-                memcpy(parts[part_num_idx] + data_ptr, f->buffer + f->cur, num_of_elems * num_of_data * sizeof(float));
+                // Every element block stores its components one after the other,
+                // the part data is stored component by component over all cells,
+                // the owned cells first then the ghost cells
+                u32 *ptr = is_ghost ? &ghost_data_ptr : &data_ptr;
+                u32 num_of_elems = part->elem_sizes[elem_idx];
+                if (f->cur + (u64)num_of_elems * num_of_data * sizeof(float) > f->size) {
+                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Variable file is truncated!\n");
+                    return false;
+                }
+                for (u32 c = 0; c < num_of_data; ++c)
+                    _encas_copy32_strided(dst + (*ptr + (u64)c * num_of_total_cells) * stride, _encas_file_at(f, f->cur + c * num_of_elems * sizeof(float), num_of_elems * sizeof(float)), num_of_elems, stride, f->swap);
                 Encas_FileAdvace(f, num_of_elems * num_of_data * sizeof(float));
 
-                data_ptr += num_of_elems * num_of_data;
-                ++elem_idx;
+                *ptr += num_of_elems;
 
             } else { break; }
         }
     }
 
-    Encas_FreeFile(f);
+    return true;
+}
+
+// Reads a whole variable file, parts missing from the file are NULL
+static float **_encas_read_variable_data(Encas_MeshInfo *mesh_info, char *filename, u32 num_of_data, bool per_element) {
+    if (!check_if_file_exists(filename)) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' variable file doesn't exists!\n", filename);
+        return NULL;
+    }
+
+    Encas_File *f = _encas_open_gold_file(filename, false);
+    if (!f)
+        return NULL;
+    float **parts = (float **)ENCAS_MALLOC(mesh_info->len * sizeof(float *));
+    if (!parts) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Failed to allocate memory for variable data\n");
+        Encas_FreeFile(f);
+        return NULL;
+    }
 
+    // Initialize parts
+    for (u32 i = 0; i < mesh_info->len; ++i) {
+        parts[i] = NULL;
+    }
+
+    if (!_encas_read_variable_file(f, mesh_info, num_of_data, per_element, parts, 0, 1, ENCAS_COMPLEX_SPLIT)) {
+        Encas_DeleteFloatArrParts(parts, mesh_info->len);
+        Encas_FreeFile(f);
+        return NULL;
+    }
+
+    Encas_FreeFile(f);
     return parts;
 }
 
+// num_of_data: 1 for scalar
+//              3 for vector
+// Every component holds the owned cells in element order, then the g_ ghost cells
+ENCAS_API float **Encas_ReadVariableDataPerElement(Encas_Case *encase, Encas_MeshInfo *mesh_info, char *filename, u32 num_of_data) {
+    return _encas_read_variable_data(mesh_info, filename, num_of_data, true);
+}
+
 // num_of_data: 1 for scalar
 //              3 for vector
 ENCAS_API float *Encas_ReadVariableDataPerElementPart(Encas_Case *encase, Encas_MeshInfo *mesh_info, char *filename, u32 part_idx, u32 num_of_data) {
@@ -3411,7 +7491,7 @@ ENCAS_API float *Encas_ReadVariableDataPerElementPart(Encas_Case *encase, Encas_
         return NULL;
     }
 
-    Encas_File *f = Encas_SlurpFile(filename);
+    Encas_File *f = _encas_open_gold_file(filename, false);
     if (f == NULL) {
         Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Failed to open file '%s'\n", filename);
         return NULL;
@@ -3422,6 +7502,7 @@ ENCAS_API float *Encas_ReadVariableDataPerElementPart(Encas_Case *encase, Encas_
     for (u32 i = 0; i < mesh_info->parts[part_idx].len; ++i)
         alloc_size += mesh_info->parts[part_idx].elem_sizes[i];
 
+    const u32 num_of_total_cells = alloc_size;
     alloc_size *= num_of_data;
     float *data = (float *)ENCAS_MALLOC(alloc_size * sizeof(float));
     if (!data) {
@@ -3430,6 +7511,10 @@ ENCAS_API float *Encas_ReadVariableDataPerElementPart(Encas_Case *encase, Encas_
         return NULL;
     }
 
+    // Ghost cells missing from the file read as 0
+    if (mesh_info->parts[part_idx].num_ghost_elemtypes)
+        memset(data, 0, alloc_size * sizeof(float));
+
     // Skip the description line
     if (!Encas_FileAdvace(f, 80)) {
         Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Failed to skip description line\n");
@@ -3438,13 +7523,12 @@ ENCAS_API float *Encas_ReadVariableDataPerElementPart(Encas_Case *encase, Encas_
         return NULL;
     }
 
-    u32 part_idx_inner = 0;
-    
+    _encas_detect_byte_order(f, mesh_info);
+
     // Parts
     Encas_Str line = Encas_ReadBinaryLine(f);
     while (Encas_Str_StartsWith(line, Encas_Str_Lit("part"))) {
         s32 part_num = Encas_ReadS32(f);
-        bool store = part_idx == part_idx_inner;
 
         s32 part_num_idx;
         if (!Encas_SearchHashTable(mesh_info->part_num_lookup, part_num, &part_num_idx)) {
@@ -3454,12 +7538,15 @@ ENCAS_API float *Encas_ReadVariableDataPerElementPart(Encas_Case *encase, Encas_
             return NULL;
         }
 
+        bool store = (u32)part_num_idx == part_idx;
+
         u32 data_ptr = 0;
+        u32 ghost_data_ptr = store ? (u32)_encas_owned_cell_count(&mesh_info->parts[part_idx]) : 0;
 
         Encas_Elem_Type elem_type;
         bool is_ghost = false;
 
-        u32 elem_idx = 0;
+        u32 owned_cursor = 0, ghost_cursor = 0;
 
         // element type
         while (!IS_ENCAS_EOF(f)) {
@@ -3467,34 +7554,33 @@ ENCAS_API float *Encas_ReadVariableDataPerElementPart(Encas_Case *encase, Encas_
             if (!line.buffer) {
                 break;
             }
+            is_ghost = false;
 
-            if ((elem_type = Encas_ReadElemType(line, &is_ghost)) != ENCAS_ELEM_UNKNOWN) {
-                if (is_ghost) {
-                    Encas_Log(ENCAS_LOG_LEVEL_ERROR,
-                              "Ghost elem type found in scalar per element file '%s'!\n",
-                              filename);
+            if (Encas_Str_StartsWith(line, Encas_Str_Lit("block")) || (elem_type = Encas_ReadElemType(line, &is_ghost)) != ENCAS_ELEM_UNKNOWN) {
+                s32 elem_idx = _encas_next_elem_block(&mesh_info->parts[part_num_idx], is_ghost, is_ghost ? &ghost_cursor : &owned_cursor);
+                if (elem_idx < 0) {
+                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "elem_idx out of range!\n");
                     ENCAS_FREE(data);
                     Encas_FreeFile(f);
                     return NULL;
                 }
 
-                if (elem_idx > mesh_info->parts[part_num_idx].len - 1) {
-                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "elem_idx out of range!\n");
+                u32 num_of_elems = mesh_info->parts[part_num_idx].elem_sizes[elem_idx];
+                if (f->cur + (u64)num_of_elems * num_of_data * sizeof(float) > f->size) {
+                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Variable file '%s' is truncated!\n", filename);
                     ENCAS_FREE(data);
                     Encas_FreeFile(f);
                     return NULL;
                 }
-
-                u32 num_of_elems = mesh_info->parts[part_num_idx].elem_sizes[elem_idx];
                 if (store) {
-                    memcpy(data + data_ptr, f->buffer + f->cur, num_of_elems * num_of_data * sizeof(float));
-                    data_ptr += num_of_elems * num_of_data;
+                    u32 *ptr = is_ghost ? &ghost_data_ptr : &data_ptr;
+                    for (u32 c = 0; c < num_of_data; ++c)
+                        _encas_copy32(data + *ptr + c * num_of_total_cells, _encas_file_at(f, f->cur + c * num_of_elems * sizeof(float), num_of_elems * sizeof(float)), num_of_elems, f->swap);
+                    *ptr += num_of_elems;
                 }
 
                 Encas_FileAdvace(f, num_of_elems * num_of_data * sizeof(float));
 
-                ++elem_idx;
-
             } else { break; }
         }
 
@@ -3511,62 +7597,7 @@ ENCAS_API float *Encas_ReadVariableDataPerElementPart(Encas_Case *encase, Encas_
 }
 
 ENCAS_API float **Encas_ReadVariableDataPerNode(Encas_Case *encase, Encas_MeshInfo *mesh_info, char *filename, u32 num_of_data) {
-    if (!check_if_file_exists(filename)) {
-        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' variable file doesn't exists!\n", filename);
-        return NULL;
-    }
-
-    Encas_File *f = Encas_SlurpFile(filename);
-    float **parts = (float **)ENCAS_MALLOC(mesh_info->len * sizeof(float *));
-    if (!parts) {
-        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Failed to allocate memory for variable data\n");
-        Encas_FreeFile(f);
-        return NULL;
-    }
-
-    // Initialize parts
-    for (u32 i = 0; i < mesh_info->len; ++i) {
-        parts[i] = NULL;
-    }
-
-    // Skip the description line
-    Encas_FileAdvace(f, 80);
-
-    // Parts
-    Encas_Str line = Encas_ReadBinaryLine(f);
-    while (Encas_Str_StartsWith(line, Encas_Str_Lit("part"))) {
-        s32 part_num = Encas_ReadS32(f);
-
-        s32 part_num_idx;
-        if (!Encas_SearchHashTable(mesh_info->part_num_lookup, part_num, &part_num_idx)) {
-            Encas_Log(ENCAS_LOG_LEVEL_ERROR, "invalid part number found!\n");
-            Encas_DeleteFloatArrParts(parts, mesh_info->len);
-            Encas_FreeFile(f);
-            return NULL;
-        }
-
-        u32 alloc_size = mesh_info->parts[part_num_idx].num_of_coords;
-        alloc_size *= num_of_data;
-        parts[part_num_idx] = (float *)ENCAS_MALLOC(alloc_size * sizeof(float));
-
-        while (!IS_ENCAS_EOF(f)) {
-            line = Encas_ReadBinaryLine(f);
-            if (Encas_Str_StartsWith(line, Encas_Str_Lit("coordinates"))) {
-                memcpy(parts[part_num_idx], f->buffer + f->cur, alloc_size * sizeof(float));
-                Encas_FileAdvace(f, alloc_size * sizeof(float));
-
-            }
-            else if (Encas_Str_StartsWith(line, Encas_Str_Lit("block"))) {
-                Encas_Log(ENCAS_LOG_LEVEL_ERROR, "block type is not implemented yet\n");
-                Encas_DeleteFloatArrParts(parts, mesh_info->len);
-                Encas_FreeFile(f);
-                return NULL;
-            } else { break; }
-        }
-    }
-
-    Encas_FreeFile(f);
-    return parts;
+    return _encas_read_variable_data(mesh_info, filename, num_of_data, false);
 }
 
 ENCAS_API float *Encas_ReadVariableDataPerNodePart(Encas_Case *encase, Encas_MeshInfo *mesh_info, char *filename, u32 part_idx, u32 num_of_data) {
@@ -3585,7 +7616,9 @@ ENCAS_API float *Encas_ReadVariableDataPerNodePart(Encas_Case *encase, Encas_Mes
         return NULL;
     }
 
-    Encas_File *f = Encas_SlurpFile(filename);
+    Encas_File *f = _encas_open_gold_file(filename, false);
+    if (!f)
+        return NULL;
     u32 alloc_size = 0;
     
     alloc_size += mesh_info->parts[part_idx].num_of_coords;
@@ -3606,13 +7639,12 @@ ENCAS_API float *Encas_ReadVariableDataPerNodePart(Encas_Case *encase, Encas_Mes
         return NULL;
     }
 
-    u32 part_idx_inner = 0;
-    
+    _encas_detect_byte_order(f, mesh_info);
+
     // Parts
     Encas_Str line = Encas_ReadBinaryLine(f);
     while (Encas_Str_StartsWith(line, Encas_Str_Lit("part"))) {
         s32 part_num = Encas_ReadS32(f);
-        bool store = part_idx == part_idx_inner;
 
         s32 part_num_idx;
         if (!Encas_SearchHashTable(mesh_info->part_num_lookup, part_num, &part_num_idx)) {
@@ -3622,21 +7654,30 @@ ENCAS_API float *Encas_ReadVariableDataPerNodePart(Encas_Case *encase, Encas_Mes
             return NULL;
         }
 
+        bool store = (u32)part_num_idx == part_idx;
+        const u64 part_size = (u64)mesh_info->parts[part_num_idx].num_of_coords * num_of_data * sizeof(float);
+
         // element type
         while (!IS_ENCAS_EOF(f)) {
             line = Encas_ReadBinaryLine(f);
 
-            if (Encas_Str_StartsWith(line, Encas_Str_Lit("coordinates"))) {
-                if (store)
-                    memcpy(data, f->buffer + f->cur, alloc_size * sizeof(float));
-                Encas_FileAdvace(f, alloc_size * sizeof(float));
+            if (Encas_Str_StartsWith(line, Encas_Str_Lit("coordinates")) || Encas_Str_StartsWith(line, Encas_Str_Lit("block"))) {
+                if (f->cur + part_size > f->size) {
+                    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Variable file '%s' is truncated!\n", filename);
+                    ENCAS_FREE(data);
+                    Encas_FreeFile(f);
+                    return NULL;
+                }
+
+                // Every component is a record of its own in Fortran Binary
+                if (store) {
+                    const u64 num_of_coords = mesh_info->parts[part_idx].num_of_coords;
+                    for (u32 c = 0; c < num_of_data; ++c)
+                        _encas_copy32(data + c * num_of_coords, _encas_file_at(f, f->cur + c * num_of_coords * sizeof(float), num_of_coords * sizeof(float)),
+                                      num_of_coords, f->swap);
+                }
+                Encas_FileAdvace(f, part_size);
 
-            }
-            else if (Encas_Str_StartsWith(line, Encas_Str_Lit("block"))) {
-                Encas_Log(ENCAS_LOG_LEVEL_ERROR, "block type is not implemented yet\n");
-                ENCAS_FREE(data);
-                Encas_FreeFile(f);
-                return NULL;
             } else { break; }
         }
 
@@ -3659,6 +7700,38 @@ ENCAS_API float *Encas_LoadVariableDataPart(Encas_Case *encase, u32 time_value_i
     }
 
     Encas_DescFile *df = encase->variable->elems[variable_idx];
+    if (Encas_VariableIsMeasured(df->type)) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%.*s' is a measured variable, see Encas_LoadMeasuredVariable!\n", df->description.len, df->description.buffer);
+        return NULL;
+    }
+    Encas_MeshInfo *mesh_info = NULL;
+
+    if (encase->geometry->model->num_of_files - 1 < time_value_idx)
+        mesh_info = &encase->geometry->model->mesh_info_array.elems[0];
+    else
+        mesh_info = &encase->geometry->model->mesh_info_array.elems[time_value_idx];
+
+    char filename[PATH_MAX + 1];
+    if (!_encas_variable_filename(encase, df, time_value_idx, filename))
+        return NULL;
+
+    if (Encas_VariableIsPerElement(df->type))
+        return Encas_ReadVariableDataPerElementPart(encase, mesh_info, filename, part_idx, Encas_VariableNumComponents(df->type));
+
+    return Encas_ReadVariableDataPerNodePart(encase, mesh_info, filename, part_idx, Encas_VariableNumComponents(df->type));
+}
+
+ENCAS_API float **Encas_LoadVariableData(Encas_Case *encase, u32 time_value_idx, u32 variable_idx) {
+    if (variable_idx > encase->variable->len - 1) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "variable_idx out of range (%d > %d)", variable_idx, encase->variable->len - 1);
+        return NULL;
+    }
+
+    Encas_DescFile *df = encase->variable->elems[variable_idx];
+    if (Encas_VariableIsMeasured(df->type)) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%.*s' is a measured variable, see Encas_LoadMeasuredVariable!\n", df->description.len, df->description.buffer);
+        return NULL;
+    }
     Encas_MeshInfo *mesh_info = NULL;
 
     if (encase->geometry->model->num_of_files - 1 < time_value_idx)
@@ -3666,197 +7739,490 @@ ENCAS_API float *Encas_LoadVariableDataPart(Encas_Case *encase, u32 time_value_i
     else
         mesh_info = &encase->geometry->model->mesh_info_array.elems[time_value_idx];
 
-    u32 dirname_length = strlen(encase->dirname);
+    char filename[PATH_MAX + 1];
+    if (!_encas_variable_filename(encase, df, time_value_idx, filename))
+        return NULL;
+
+    //printf("filename: %s\n", filename);
+    Encas_Log(ENCAS_LOG_LEVEL_INFO, "Filename: %s\n", filename);
+    if (Encas_VariableIsPerElement(df->type))
+        return Encas_ReadVariableDataPerElement(encase, mesh_info, filename, Encas_VariableNumComponents(df->type));
+
+    return Encas_ReadVariableDataPerNode(encase, mesh_info, filename, Encas_VariableNumComponents(df->type));
+}
+
+// Loads the Re_fn and the Im_fn file of a complex variable straight into one array per part
+// in the given layout, both files are read once. Values missing from a file read as 0.
+ENCAS_API float **Encas_LoadComplexVariableData(Encas_Case *encase, u32 time_value_idx, u32 variable_idx, Encas_ComplexLayout layout) {
+    if (variable_idx > encase->variable->len - 1) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "variable_idx out of range (%d > %d)", variable_idx, encase->variable->len - 1);
+        return NULL;
+    }
+
+    Encas_DescFile *df = encase->variable->elems[variable_idx];
+    if (!Encas_VariableIsComplex(df->type)) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%.*s' is not a complex variable!\n", df->description.len, df->description.buffer);
+        return NULL;
+    }
+
+    Encas_MeshInfo *mesh_info = NULL;
+    if (encase->geometry->model->num_of_files - 1 < time_value_idx)
+        mesh_info = &encase->geometry->model->mesh_info_array.elems[0];
+    else
+        mesh_info = &encase->geometry->model->mesh_info_array.elems[time_value_idx];
+
+    const u32 num_of_data = Encas_VariableNumComponents(df->type);
+    const bool per_element = Encas_VariableIsPerElement(df->type);
+
+    float **parts = (float **)ENCAS_MALLOC(mesh_info->len * sizeof(float *));
+    for (u32 i = 0; i < mesh_info->len; ++i)
+        parts[i] = NULL;
+
+    Encas_MutStr *patterns[2] = { &df->filename, &df->im_filename };
+    for (u32 slot = 0; slot < 2; ++slot) {
+        char filename[PATH_MAX + 1];
+        if (!_encas_expand_filename(encase, patterns[slot], df->ts_set, &df->ts, time_value_idx, filename)) {
+            Encas_DeleteFloatArrParts(parts, mesh_info->len);
+            return NULL;
+        }
+
+        Encas_Log(ENCAS_LOG_LEVEL_INFO, "Filename: %s\n", filename);
+        if (!check_if_file_exists(filename)) {
+            Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' variable file doesn't exists!\n", filename);
+            Encas_DeleteFloatArrParts(parts, mesh_info->len);
+            return NULL;
+        }
+
+        Encas_File *f = _encas_open_gold_file(filename, false);
+        if (!f || !_encas_read_variable_file(f, mesh_info, num_of_data, per_element, parts, slot, 2, layout)) {
+            if (f)
+                Encas_FreeFile(f);
+            Encas_DeleteFloatArrParts(parts, mesh_info->len);
+            return NULL;
+        }
+        Encas_FreeFile(f);
+    }
+
+    return parts;
+}
+
+// Real part of z * e^(i phase), the value of a harmonic result at the given phase angle
+// (radians), for count complex values
+ENCAS_API void Encas_ComplexAtPhase(const float *data, u64 count, Encas_ComplexLayout layout, float phase, float *out) {
+    const float c = cosf(phase), s = sinf(phase);
+
+    u64 i = 0;
+#ifdef ENCAS_SSE2
+    const __m128 vc = _mm_set1_ps(c), vs = _mm_set1_ps(s);
+    for (; i + 4 <= count; i += 4) {
+        __m128 re, im;
+        if (layout == ENCAS_COMPLEX_INTERLEAVED) {
+            __m128 lo = _mm_loadu_ps(data + 2 * i), hi = _mm_loadu_ps(data + 2 * i + 4);
+            re = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+            im = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+        } else {
+            re = _mm_loadu_ps(data + i);
+            im = _mm_loadu_ps(data + count + i);
+        }
+        _mm_storeu_ps(out + i, _mm_sub_ps(_mm_mul_ps(re, vc), _mm_mul_ps(im, vs)));
+    }
+#endif
+
+    if (layout == ENCAS_COMPLEX_INTERLEAVED) {
+        for (; i < count; ++i)
+            out[i] = data[2 * i] * c - data[2 * i + 1] * s;
+    } else {
+        for (; i < count; ++i)
+            out[i] = data[i] * c - data[count + i] * s;
+    }
+}
+
+// Magnitude and phase angle (radians, atan2) of count complex values, either output may be NULL
+ENCAS_API void Encas_ComplexMagnitudePhase(const float *data, u64 count, Encas_ComplexLayout layout, float *magnitude, float *phase) {
+    const u64 stride = layout == ENCAS_COMPLEX_INTERLEAVED ? 2 : 1;
+    const float *re = data;
+    const float *im = layout == ENCAS_COMPLEX_INTERLEAVED ? data + 1 : data + count;
+
+    if (magnitude) {
+        u64 i = 0;
+#ifdef ENCAS_SSE2
+        for (; i + 4 <= count; i += 4) {
+            __m128 vr, vi;
+            if (layout == ENCAS_COMPLEX_INTERLEAVED) {
+                __m128 lo = _mm_loadu_ps(data + 2 * i), hi = _mm_loadu_ps(data + 2 * i + 4);
+                vr = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+                vi = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+            } else {
+                vr = _mm_loadu_ps(re + i);
+                vi = _mm_loadu_ps(im + i);
+            }
+            _mm_storeu_ps(magnitude + i, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vr, vr), _mm_mul_ps(vi, vi))));
+        }
+#endif
+        for (; i < count; ++i)
+            magnitude[i] = sqrtf(re[i * stride] * re[i * stride] + im[i * stride] * im[i * stride]);
+    }
+
+    if (phase)
+        for (u64 i = 0; i < count; ++i)
+            phase[i] = atan2f(im[i * stride], re[i * stride]);
+}
+
+// Grows the arrays of particles to hold num_of_particles, the old values are not kept
+static void _encas_reserve_particles(Encas_Particles *particles, u64 num_of_particles) {
+    if (num_of_particles <= particles->cap)
+        return;
+
+    ENCAS_FREE(particles->positions.x);
+    ENCAS_FREE(particles->positions.y);
+    ENCAS_FREE(particles->positions.z);
+    ENCAS_FREE(particles->ids);
+
+    particles->positions.x = (float *)ENCAS_MALLOC(num_of_particles * sizeof(float));
+    particles->positions.y = (float *)ENCAS_MALLOC(num_of_particles * sizeof(float));
+    particles->positions.z = (float *)ENCAS_MALLOC(num_of_particles * sizeof(float));
+    particles->ids = (s32 *)ENCAS_MALLOC(num_of_particles * sizeof(s32));
+    particles->cap = num_of_particles;
+}
+
+// Measured geometry file: C Binary, a description line, "particle coordinates", the number
+// of particles, their ids, then x y z of every particle next to each other
+ENCAS_API bool Encas_ReadMeasuredGeometry(char *filename, Encas_Particles *particles) {
+    if (!check_if_file_exists(filename)) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Cannot open %s measured geometry file\n", filename);
+        return false;
+    }
+
+    Encas_File *f = _encas_open_gold_file(filename, true);
+    if (!f)
+        return false;
+
+    Encas_Str line = Encas_ReadBinaryLine(f);
+    if (!Encas_Str_StartsWith(line, Encas_Str_Lit("C Binary"))) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' is not in C Binary form!\n", filename);
+        Encas_FreeFile(f);
+        return false;
+    }
+
+    // Skip the description line
+    if (!Encas_FileAdvace(f, 80)) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file is not contains description!\n", filename);
+        Encas_FreeFile(f);
+        return false;
+    }
+
+    line = Encas_ReadBinaryLine(f);
+    if (!Encas_Str_StartsWith(line, Encas_Str_Lit("particle coordinates")) || f->cur + sizeof(s32) > f->size) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' file is not contains particle coordinates!\n", filename);
+        Encas_FreeFile(f);
+        return false;
+    }
+
+    // There is no part number, the count has to fit the 16 bytes per particle of the rest
+    const u64 rest = f->size - f->cur - sizeof(s32);
+    const u32 count = _encas_load_u32(_encas_file_at(f, f->cur, sizeof(u32)), false);
+    f->swap = (u64)count * 16 > rest && (u64)_encas_bswap32(count) * 16 <= rest;
+
+    const s32 num_of_particles = Encas_ReadS32(f);
+    if (num_of_particles < 0 || (u64)num_of_particles * 16 > rest) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' is truncated, %d particles don't fit!\n", filename, num_of_particles);
+        Encas_FreeFile(f);
+        return false;
+    }
+
+    const u64 n = (u64)num_of_particles;
+    _encas_reserve_particles(particles, n);
+
+    _encas_copy32(particles->ids, _encas_file_at(f, f->cur, n * sizeof(s32)), n, f->swap);
+    Encas_FileAdvace(f, n * sizeof(s32));
+
+    // Split the x y z triplets into the component arrays
+    const u8 *src = _encas_file_at(f, f->cur, n * 3 * sizeof(float));
+    const bool swap = f->swap;
+    float *xs = particles->positions.x, *ys = particles->positions.y, *zs = particles->positions.z;
+
+    ENCAS_OMP(parallel for if(n > ENCAS_PARALLEL_MIN))
+    for (s64 i = 0; i < (s64)n; ++i) {
+        const u8 *p = src + (u64)i * 3 * sizeof(float);
+        xs[i] = _encas_load_f32(p, swap);
+        ys[i] = _encas_load_f32(p + sizeof(float), swap);
+        zs[i] = _encas_load_f32(p + 2 * sizeof(float), swap);
+    }
+
+    particles->len = n;
+    particles->swap = swap;
+
+    Encas_FreeFile(f);
+    return true;
+}
+
+// Reads the measured geometry of the time step into particles
+ENCAS_API bool Encas_LoadMeasuredGeometry(Encas_Case *encase, u32 time_value_idx, Encas_Particles *particles) {
+    Encas_GeometryElem *gelem = encase->geometry->measured;
+    if (gelem == NULL) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "No measured geometry in the case file!\n");
+        return false;
+    }
 
     char filename[PATH_MAX + 1];
-    u32 filename_length = 0;
+    if (!_encas_expand_filename(encase, &gelem->filename, gelem->ts_set, &gelem->ts, time_value_idx, filename))
+        return false;
 
-    memcpy(filename, encase->dirname, dirname_length);
-    filename[dirname_length] = '/';
-    filename_length += dirname_length + 1;
+    Encas_Log(ENCAS_LOG_LEVEL_INFO, "Measured geometry filename: %s\n", filename);
+    return Encas_ReadMeasuredGeometry(filename, particles);
+}
 
-    if (!df->ts_set) {
-        memcpy(filename + filename_length, df->filename.buffer, df->filename.len);
-        filename[filename_length + df->filename.len] = '\0';
+// Measured variable file: a description line, then num_of_data values for every particle
+// (the components of a vector next to each other). out gets num_of_data * particles->len
+// floats, component by component.
+ENCAS_API bool Encas_ReadMeasuredVariable(char *filename, const Encas_Particles *particles, u32 num_of_data, float *out) {
+    if (!check_if_file_exists(filename)) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' variable file doesn't exists!\n", filename);
+        return false;
     }
-    else {
-        Encas_Time *time = NULL;
 
-        for (u32 time_idx = 0; time_idx < encase->times->len && time == NULL; ++time_idx)
-            if (encase->times->elems[time_idx]->time_set_number == df->ts)
-                time = encase->times->elems[time_idx];
+    Encas_File *f = _encas_open_gold_file(filename, false);
+    if (!f)
+        return false;
 
-        if (time == NULL) {
-            Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Encas_LoadVariableDataPart: Time with 'time set number = %d' not found!\n", df->ts);
-            return NULL;
-        }
+    const u64 n = particles->len;
+    if (!Encas_FileAdvace(f, 80) || f->size - f->cur < n * num_of_data * sizeof(float)) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%s' has less values than particles!\n", filename);
+        Encas_FreeFile(f);
+        return false;
+    }
 
-        s32 asterisk_idx = Encas_MutStr_FindChar(&df->filename, '*');
-        if (asterisk_idx == -1) {
-            memcpy(filename + filename_length, df->filename.buffer, df->filename.len);
-            filename[filename_length + df->filename.len] = '\0';
-        }
-        else {
-            u32 asterisk_count = 1;
-            for (u32 i = asterisk_idx + 1; i < df->filename.len && df->filename.buffer[i] == '*'; ++i)
-                ++asterisk_count;
+    const u8 *src = _encas_file_at(f, f->cur, n * num_of_data * sizeof(float));
+    const bool swap = particles->swap;
 
-            u32 file_num = time->filename_start_number + time->filename_increment * time_value_idx;
+    if (num_of_data == 1) {
+        _encas_copy32(out, src, n, swap);
+    } else {
+        ENCAS_OMP(parallel for if(n > ENCAS_PARALLEL_MIN))
+        for (s64 i = 0; i < (s64)n; ++i)
+            for (u32 c = 0; c < num_of_data; ++c)
+                out[c * n + (u64)i] = _encas_load_f32(src + ((u64)i * num_of_data + c) * sizeof(float), swap);
+    }
 
-            // Copy the first part of the filename (before the asterisks)
-            memcpy(filename + filename_length, df->filename.buffer, asterisk_idx);
+    Encas_FreeFile(f);
+    return true;
+}
 
-            // Format the number with leading zeros based on asterisk count
-            char tmp[256];
-            snprintf(tmp, 256, "%0*d", asterisk_count, file_num);
-            u32 tmp_len = strlen(tmp);
-            if (tmp_len != asterisk_count) {
-                Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Pattern '*' is shorter than the generated number!\n");
-                return NULL;
-            }
+// Reads a scalar or vector per measured node variable of the time step for particles,
+// which must hold the measured geometry of the same time step
+ENCAS_API bool Encas_LoadMeasuredVariable(Encas_Case *encase, u32 time_value_idx, u32 variable_idx, const Encas_Particles *particles, float *out) {
+    if (variable_idx > encase->variable->len - 1) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "variable_idx out of range (%d > %d)", variable_idx, encase->variable->len - 1);
+        return false;
+    }
 
-            // Copy the formatted number
-            memcpy(filename + filename_length + asterisk_idx, tmp, tmp_len);
+    Encas_DescFile *df = encase->variable->elems[variable_idx];
+    if (!Encas_VariableIsMeasured(df->type)) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "'%.*s' is not a measured variable!\n", df->description.len, df->description.buffer);
+        return false;
+    }
 
-            // Copy the rest of the filename (after the asterisks)
-            u32 remaining_len = df->filename.len - (asterisk_idx + asterisk_count);
-            if (remaining_len > 0) {
-                memcpy(filename + filename_length + asterisk_idx + tmp_len,
-                       df->filename.buffer + asterisk_idx + asterisk_count,
-                       remaining_len);
-            }
+    char filename[PATH_MAX + 1];
+    if (!_encas_variable_filename(encase, df, time_value_idx, filename))
+        return false;
 
-            // Null-terminate the filename
-            filename[filename_length + asterisk_idx + tmp_len + remaining_len] = '\0';
-        }
-    }
+    Encas_Log(ENCAS_LOG_LEVEL_INFO, "Filename: %s\n", filename);
+    return Encas_ReadMeasuredVariable(filename, particles, Encas_VariableNumComponents(df->type), out);
+}
 
-    switch (df->type) {
-        case ENCAS_VARIABLE_SCALAR_PER_NODE: {
-            return Encas_ReadVariableDataPerNodePart(encase, mesh_info, filename, part_idx, 1);
-            break;
-        }
-        case ENCAS_VARIABLE_VECTOR_PER_NODE: {
-            return Encas_ReadVariableDataPerNodePart(encase, mesh_info, filename, part_idx, 3);
-            break;
-        }
-        case ENCAS_VARIABLE_SCALAR_PER_ELEMENT: {
-            return Encas_ReadVariableDataPerElementPart(encase, mesh_info, filename, part_idx, 1);
-            break;
-        }
-        case ENCAS_VARIABLE_VECTOR_PER_ELEMENT: {
-            return Encas_ReadVariableDataPerElementPart(encase, mesh_info, filename, part_idx, 3);
-            break;
-        }
-        default: {
-            break;
-        }
-    }
-    return NULL;
+ENCAS_API void Encas_DeleteParticles(Encas_Particles *particles) {
+    ENCAS_FREE(particles->positions.x);
+    ENCAS_FREE(particles->positions.y);
+    ENCAS_FREE(particles->positions.z);
+    ENCAS_FREE(particles->ids);
+    memset(particles, 0, sizeof(Encas_Particles));
 }
 
-ENCAS_API float **Encas_LoadVariableData(Encas_Case *encase, u32 time_value_idx, u32 variable_idx) {
+// Loads a variable of a block part as a dense array, i fastest then j then k, one
+// component after the other. dims gets the node dims for per node variables and the
+// cell dims for per element variables.
+ENCAS_API float *Encas_LoadBlockVariable(Encas_Case *encase, u32 time_value_idx, u32 variable_idx, u32 part_idx, u32 dims[3]) {
     if (variable_idx > encase->variable->len - 1) {
         Encas_Log(ENCAS_LOG_LEVEL_ERROR, "variable_idx out of range (%d > %d)", variable_idx, encase->variable->len - 1);
         return NULL;
     }
 
-    Encas_DescFile *df = encase->variable->elems[variable_idx];
-    Encas_MeshInfo *mesh_info = NULL;
+    u32 mesh_info_array_idx = time_value_idx;
+    if (time_value_idx > encase->geometry->model->num_of_files - 1)
+        mesh_info_array_idx = 0;
 
-    if (encase->geometry->model->num_of_files - 1 < time_value_idx)
-        mesh_info = &encase->geometry->model->mesh_info_array.elems[0];
-    else
-        mesh_info = &encase->geometry->model->mesh_info_array.elems[time_value_idx];
+    Encas_MeshInfo *mesh_info = &encase->geometry->model->mesh_info_array.elems[mesh_info_array_idx];
+    if (part_idx >= mesh_info->len || mesh_info->parts[part_idx].block_dims[0] == 0) {
+        Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Part %u is not a block part!\n", part_idx);
+        return NULL;
+    }
 
-    u32 dirname_length = strlen(encase->dirname);
+    Encas_Block block;
+    memset(&block, 0, sizeof(block));
+    memcpy(block.dims, mesh_info->parts[part_idx].block_dims, sizeof(block.dims));
 
-    char filename[PATH_MAX + 1];
-    u32 filename_length = 0;
+    if (Encas_VariableIsPerElement(encase->variable->elems[variable_idx]->type))
+        Encas_BlockCellDims(&block, dims);
+    else
+        memcpy(dims, block.dims, sizeof(block.dims));
 
-    memcpy(filename, encase->dirname, dirname_length);
-    filename[dirname_length] = '/';
-    filename_length += dirname_length + 1;
+    // The part data is already dense, component by component
+    return Encas_LoadVariableDataPart(encase, time_value_idx, variable_idx, part_idx);
+}
 
-    if (!df->ts_set) {
-        df->ts = encase->times->elems[0]->time_set_number;
+ENCAS_API u32 Encas_VariableNumComponents(Encas_VariableType type) {
+    switch (type) {
+        case ENCAS_VARIABLE_VECTOR_PER_NODE:
+        case ENCAS_VARIABLE_VECTOR_PER_ELEMENT:
+        case ENCAS_VARIABLE_COMPLEX_VECTOR_PER_NODE:
+        case ENCAS_VARIABLE_COMPLEX_VECTOR_PER_ELEMENT:
+        case ENCAS_VARIABLE_VECTOR_PER_MEASURED_NODE:
+            return 3;
+        case ENCAS_VARIABLE_TENSOR_SYMM_PER_NODE:
+        case ENCAS_VARIABLE_TENSOR_SYMM_PER_ELEMENT:
+            return 6;
+        case ENCAS_VARIABLE_TENSOR_ASYMM_PER_NODE:
+        case ENCAS_VARIABLE_TENSOR_ASYMM_PER_ELEMENT:
+            return 9;
+        default:
+            return 1;
     }
+}
 
-    Encas_Time *time = NULL;
+ENCAS_API bool Encas_VariableIsPerElement(Encas_VariableType type) {
+    return type == ENCAS_VARIABLE_SCALAR_PER_ELEMENT || type == ENCAS_VARIABLE_VECTOR_PER_ELEMENT
+        || type == ENCAS_VARIABLE_TENSOR_SYMM_PER_ELEMENT || type == ENCAS_VARIABLE_TENSOR_ASYMM_PER_ELEMENT
+        || type == ENCAS_VARIABLE_COMPLEX_SCALAR_PER_ELEMENT || type == ENCAS_VARIABLE_COMPLEX_VECTOR_PER_ELEMENT;
+}
 
-    if (encase->times != NULL)
-        for (u32 time_idx = 0; time_idx < encase->times->len && time == NULL; ++time_idx)
-            if (encase->times->elems[time_idx]->time_set_number == df->ts)
-                time = encase->times->elems[time_idx];
+// Measured variables belong to the particles of the measured geometry, not to the parts
+ENCAS_API bool Encas_VariableIsMeasured(Encas_VariableType type) {
+    return type == ENCAS_VARIABLE_SCALAR_PER_MEASURED_NODE || type == ENCAS_VARIABLE_VECTOR_PER_MEASURED_NODE;
+}
 
+// Complex variables have a real and an imaginary file, the other loaders return the real part
+ENCAS_API bool Encas_VariableIsComplex(Encas_VariableType type) {
+    return type == ENCAS_VARIABLE_COMPLEX_SCALAR_PER_NODE || type == ENCAS_VARIABLE_COMPLEX_VECTOR_PER_NODE
+        || type == ENCAS_VARIABLE_COMPLEX_SCALAR_PER_ELEMENT || type == ENCAS_VARIABLE_COMPLEX_VECTOR_PER_ELEMENT;
+}
 
-    s32 asterisk_idx = Encas_MutStr_FindChar(&df->filename, '*');
-    if (asterisk_idx == -1) {
-        memcpy(filename + filename_length, df->filename.buffer, df->filename.len);
-        filename[filename_length + df->filename.len] = '\0';
-    } else {
-        if (time == NULL) {
-            Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Encas_LoadVariableData: Time with 'time set number = %d' not found!\n", df->ts);
-            return NULL;
+// Component arrays of a tensor block as a symmetric tensor: 11 22 33 then the shear pairs
+// 12/21, 13/31, 23/32. Both entries of a pair point to the same array for symmetric tensors,
+// an asymmetric one is used through its symmetric part.
+typedef struct Encas_TensorComponents {
+    const float *d[3];
+    const float *s[3][2];
+} Encas_TensorComponents;
+
+static bool _encas_tensor_components(const float *tensor, u64 count, u32 num_of_data, Encas_TensorComponents *t) {
+    if (num_of_data == 6) {
+        for (u32 c = 0; c < 3; ++c) {
+            t->d[c] = tensor + c * count;
+            t->s[c][0] = t->s[c][1] = tensor + (3 + c) * count;
         }
+        return true;
+    }
 
-        u32 asterisk_count = 1;
-        for (u32 i = asterisk_idx + 1; i < df->filename.len && df->filename.buffer[i] == '*'; ++i)
-            ++asterisk_count;
+    if (num_of_data == 9) {
+        static const u32 diag[3] = { 0, 4, 8 };
+        static const u32 shear[3][2] = { { 1, 3 }, { 2, 6 }, { 5, 7 } };
+        for (u32 c = 0; c < 3; ++c) {
+            t->d[c] = tensor + diag[c] * count;
+            t->s[c][0] = tensor + shear[c][0] * count;
+            t->s[c][1] = tensor + shear[c][1] * count;
+        }
+        return true;
+    }
 
-        u32 file_num = time->filename_start_number + time->filename_increment * time_value_idx;
+    Encas_Log(ENCAS_LOG_LEVEL_ERROR, "A tensor has 6 or 9 components, not %u!\n", num_of_data);
+    return false;
+}
 
-        // Copy the first part of the filename (before the asterisks)
-        memcpy(filename + filename_length, df->filename.buffer, asterisk_idx);
+// Von Mises stress of count tensors, laid out component by component like the variable
+// readers return them (num_of_data: 6 for symmetric, 9 for asymmetric tensors)
+ENCAS_API bool Encas_TensorVonMises(const float *tensor, u64 count, u32 num_of_data, float *out) {
+    Encas_TensorComponents t;
+    if (!_encas_tensor_components(tensor, count, num_of_data, &t))
+        return false;
 
-        // Format the number with leading zeros based on asterisk count
-        char tmp[256];
-        snprintf(tmp, 256, "%0*d", asterisk_count, file_num);
-        u32 tmp_len = strlen(tmp);
-        if (tmp_len != asterisk_count) {
-            Encas_Log(ENCAS_LOG_LEVEL_ERROR, "Pattern '*' is shorter than the generated number!\n");
-            return NULL;
+    const s64 num_of_quads = (s64)(count / 4);
+    ENCAS_OMP(parallel for if(count > ENCAS_PARALLEL_MIN))
+    for (s64 q = 0; q < num_of_quads; ++q) {
+        const u64 i = (u64)q * 4;
+#ifdef ENCAS_SSE2
+        const __m128 half = _mm_set1_ps(0.5f);
+        __m128 s11 = _mm_loadu_ps(t.d[0] + i), s22 = _mm_loadu_ps(t.d[1] + i), s33 = _mm_loadu_ps(t.d[2] + i);
+        __m128 s12 = _mm_mul_ps(half, _mm_add_ps(_mm_loadu_ps(t.s[0][0] + i), _mm_loadu_ps(t.s[0][1] + i)));
+        __m128 s13 = _mm_mul_ps(half, _mm_add_ps(_mm_loadu_ps(t.s[1][0] + i), _mm_loadu_ps(t.s[1][1] + i)));
+        __m128 s23 = _mm_mul_ps(half, _mm_add_ps(_mm_loadu_ps(t.s[2][0] + i), _mm_loadu_ps(t.s[2][1] + i)));
+
+        __m128 a = _mm_sub_ps(s11, s22), b = _mm_sub_ps(s22, s33), c = _mm_sub_ps(s33, s11);
+        __m128 normal = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b)), _mm_mul_ps(c, c));
+        __m128 shear = _mm_add_ps(_mm_add_ps(_mm_mul_ps(s12, s12), _mm_mul_ps(s13, s13)), _mm_mul_ps(s23, s23));
+        __m128 sum = _mm_add_ps(_mm_mul_ps(half, normal), _mm_mul_ps(_mm_set1_ps(3.0f), shear));
+        _mm_storeu_ps(out + i, _mm_sqrt_ps(sum));
+#else
+        for (u64 k = i; k < i + 4; ++k) {
+            float s12 = 0.5f * (t.s[0][0][k] + t.s[0][1][k]);
+            float s13 = 0.5f * (t.s[1][0][k] + t.s[1][1][k]);
+            float s23 = 0.5f * (t.s[2][0][k] + t.s[2][1][k]);
+            float a = t.d[0][k] - t.d[1][k], b = t.d[1][k] - t.d[2][k], c = t.d[2][k] - t.d[0][k];
+            out[k] = sqrtf(0.5f * (a * a + b * b + c * c) + 3.0f * (s12 * s12 + s13 * s13 + s23 * s23));
         }
+#endif
+    }
 
-        // Copy the formatted number
-        memcpy(filename + filename_length + asterisk_idx, tmp, tmp_len);
+    for (u64 k = (u64)num_of_quads * 4; k < count; ++k) {
+        float s12 = 0.5f * (t.s[0][0][k] + t.s[0][1][k]);
+        float s13 = 0.5f * (t.s[1][0][k] + t.s[1][1][k]);
+        float s23 = 0.5f * (t.s[2][0][k] + t.s[2][1][k]);
+        float a = t.d[0][k] - t.d[1][k], b = t.d[1][k] - t.d[2][k], c = t.d[2][k] - t.d[0][k];
+        out[k] = sqrtf(0.5f * (a * a + b * b + c * c) + 3.0f * (s12 * s12 + s13 * s13 + s23 * s23));
+    }
 
-        // Copy the rest of the filename (after the asterisks)
-        u32 remaining_len = df->filename.len - (asterisk_idx + asterisk_count);
-        if (remaining_len > 0) {
-            memcpy(filename + filename_length + asterisk_idx + tmp_len,
-                   df->filename.buffer + asterisk_idx + asterisk_count,
-                   remaining_len);
-        }
+    return true;
+}
 
-        // Null-terminate the filename
-        filename[filename_length + asterisk_idx + tmp_len + remaining_len] = '\0';
-    }
+// Principal values of count tensors (of the symmetric part for asymmetric ones), largest
+// first. out gets the 3 values component by component: out[i], out[i + count], out[i + 2 * count].
+// Closed form eigenvalues of a symmetric 3x3 matrix, computed in double.
+ENCAS_API bool Encas_TensorPrincipal(const float *tensor, u64 count, u32 num_of_data, float *out) {
+    Encas_TensorComponents t;
+    if (!_encas_tensor_components(tensor, count, num_of_data, &t))
+        return false;
 
-    //printf("filename: %s\n", filename);
-    Encas_Log(ENCAS_LOG_LEVEL_INFO, "Filename: %s\n", filename);
-    switch (df->type) {
-        case ENCAS_VARIABLE_SCALAR_PER_NODE: {
-            return Encas_ReadVariableDataPerNode(encase, mesh_info, filename, 1);
-            break;
-        }
-        case ENCAS_VARIABLE_VECTOR_PER_NODE: {
-            return Encas_ReadVariableDataPerNode(encase, mesh_info, filename, 3);
-            break;
-        }
-        case ENCAS_VARIABLE_SCALAR_PER_ELEMENT: {
-            return Encas_ReadVariableDataPerElement(encase, mesh_info, filename, 1);
-            break;
-        }
-        case ENCAS_VARIABLE_VECTOR_PER_ELEMENT: {
-            return Encas_ReadVariableDataPerElement(encase, mesh_info, filename, 3);
-            break;
-        }
-        default: {
-            break;
+    ENCAS_OMP(parallel for if(count > ENCAS_PARALLEL_MIN))
+    for (s64 k = 0; k < (s64)count; ++k) {
+        const double s11 = t.d[0][k], s22 = t.d[1][k], s33 = t.d[2][k];
+        const double s12 = 0.5 * ((double)t.s[0][0][k] + t.s[0][1][k]);
+        const double s13 = 0.5 * ((double)t.s[1][0][k] + t.s[1][1][k]);
+        const double s23 = 0.5 * ((double)t.s[2][0][k] + t.s[2][1][k]);
+
+        const double mean = (s11 + s22 + s33) / 3.0;
+        const double off = s12 * s12 + s13 * s13 + s23 * s23;
+        const double d11 = s11 - mean, d22 = s22 - mean, d33 = s33 - mean;
+        const double p2 = d11 * d11 + d22 * d22 + d33 * d33 + 2.0 * off;
+
+        double e1 = mean, e2 = mean, e3 = mean;
+        if (p2 > 0.0) {
+            // Eigenvalues of B = (A - mean I) / p are 2 cos(phi + 2 pi j / 3), det(B) = 2 cos(3 phi)
+            const double p = sqrt(p2 / 6.0);
+            const double det = d11 * (d22 * d33 - s23 * s23) - s12 * (s12 * d33 - s23 * s13) + s13 * (s12 * s23 - d22 * s13);
+            double r = det / (2.0 * p * p * p);
+            r = r < -1.0 ? -1.0 : (r > 1.0 ? 1.0 : r);
+
+            const double phi = acos(r) / 3.0;
+            e1 = mean + 2.0 * p * cos(phi);
+            e3 = mean + 2.0 * p * cos(phi + 2.0943951023931957); // 2 pi / 3
+            e2 = 3.0 * mean - e1 - e3;
         }
+
+        out[k] = (float)e1;
+        out[k + count] = (float)e2;
+        out[k + 2 * count] = (float)e3;
     }
-    return NULL;
+
+    return true;
 }
 
 // TODO: split every type to tetrahedrons
@@ -3874,29 +8240,29 @@ ENCAS_API void Encas_MeshArray_To_FlatMesh(Encas_Case *encas, Encas_MeshArray *m
         elem_vert_map_size += part->elem_vert_map_array_size;
     }
 
-    flat->vertices = (Encas_Vertex *)ENCAS_MALLOC(vertices_size * sizeof(Encas_Vertex));
-    flat->elem_vert_map = (u64 *)ENCAS_MALLOC(elem_vert_map_size * sizeof(u64));
+    // Indices are global over all the parts, the type is picked from the total vertex count
+    flat->elem_vert_map.type = Encas_IndexTypeFor(vertices_size);
+    flat->elem_vert_map.len = elem_vert_map_size;
+    flat->elem_vert_map.data = ENCAS_MALLOC(elem_vert_map_size * Encas_IndexSize(flat->elem_vert_map.type));
 
+    flat->vertices = (Encas_Vertex *)ENCAS_MALLOC(vertices_size * sizeof(Encas_Vertex));
     flat->vertices_size = vertices_size;
-    flat->elem_vert_map_size = elem_vert_map_size;
 
     u64 vert_offset = 0, elem_offset = 0;
     for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx) {
         Encas_Mesh *mesh_part = mesh->elems[part_idx];
         u64 elem_size = mesh_info->parts[part_idx].elem_vert_map_array_size;
 
-        for (u64 elem_idx = 0; elem_idx < elem_size; ++elem_idx) {
-            flat->elem_vert_map[elem_offset + elem_idx] = (u64)mesh_part->elem_vert_map_array[elem_idx] + vert_offset;
-        }
+        u32 *part_cells;
+        _encas_store_indices(&flat->elem_vert_map, elem_offset, _encas_cells_u32(mesh_part, 0, elem_size, &part_cells), elem_size, vert_offset);
+        ENCAS_FREE(part_cells);
         elem_offset += elem_size;
 
-        for (u64 vert_idx = 0; vert_idx < mesh_part->vert_array_size; ++vert_idx) {
-            Encas_Vertex *vs = flat->vertices + vert_offset + vert_idx;
-
-            vs->x = mesh_part->vert_array.x[vert_idx];
-            vs->y = mesh_part->vert_array.y[vert_idx];
-            vs->z = mesh_part->vert_array.z[vert_idx];
-        }
+        // Encas_Vertex is packed xyz
+        if (mesh_part->vertices && mesh_part->vertex_layout == ENCAS_VERTEX_AOS_XYZ)
+            memcpy(flat->vertices + vert_offset, mesh_part->vertices, mesh_part->vert_array_size * sizeof(Encas_Vertex));
+        else
+            Encas_InterleaveVertices(&mesh_part->vert_array, mesh_part->vert_array_size, (float *)(flat->vertices + vert_offset), ENCAS_VERTEX_AOS_XYZ);
 
         vert_offset += mesh_part->vert_array_size;
     }
@@ -3910,24 +8276,21 @@ ENCAS_API void Encas_MeshArray_To_FlatMesh(Encas_Case *encas, Encas_MeshArray *m
         Encas_DescFile *variable = encas->variable->elems[var_idx];
         u64 data_size;
 
-        switch (variable->type) {
-            case ENCAS_VARIABLE_SCALAR_PER_ELEMENT:
-                data_size = elem_vert_map_size / 4;
-                break;
-            case ENCAS_VARIABLE_VECTOR_PER_ELEMENT:
-                data_size = elem_vert_map_size / 4 * 3;
-                break;
-            case ENCAS_VARIABLE_SCALAR_PER_NODE:
-                data_size = vertices_size;
-                break;
-            case ENCAS_VARIABLE_VECTOR_PER_NODE:
-                data_size = vertices_size * 3;
-                break;
-            default:
-                data_size = 0;
-                break;
+        // Particles are not part of the flat mesh
+        if (Encas_VariableIsMeasured(variable->type)) {
+            flat->data_sizes[var_idx] = 0;
+            flat->data[var_idx] = NULL;
+            continue;
         }
 
+        const u32 num_of_data = Encas_VariableNumComponents(variable->type);
+        const bool per_element = Encas_VariableIsPerElement(variable->type);
+
+        if (per_element)
+            data_size = elem_vert_map_size / 4 * num_of_data;
+        else
+            data_size = vertices_size * num_of_data;
+
         flat->data_sizes[var_idx] = data_size;
 
         float **var_data = Encas_LoadVariableData(encas, time_idx, var_idx);
@@ -3939,50 +8302,23 @@ ENCAS_API void Encas_MeshArray_To_FlatMesh(Encas_Case *encas, Encas_MeshArray *m
         u64 var_offset = 0;
         flat->data[var_idx] = (float *)ENCAS_MALLOC(data_size * sizeof(float));
 
-        if (variable->type == ENCAS_VARIABLE_SCALAR_PER_NODE) {
-            for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx) {
-                Encas_MeshInfoPart *part = mesh_info->parts + part_idx;
-                u64 num_of_coords = part->num_of_coords;
-
-                memcpy(flat->data[var_idx] + var_offset, var_data[part_idx], num_of_coords * sizeof(float));
-                var_offset += num_of_coords;
-            }
-        } else if (variable->type == ENCAS_VARIABLE_VECTOR_PER_NODE) { /* ENCAS_VARIABLE_VECTOR_PER_NODE */
-            for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx) {
-                Encas_MeshInfoPart *part = mesh_info->parts + part_idx;
-                u64 num_of_coords = part->num_of_coords;
-
-                for (u64 i = 0; i < num_of_coords; ++i) {
-                    flat->data[var_idx][var_offset + 0] = var_data[part_idx][i + 0 * num_of_coords];
-                    flat->data[var_idx][var_offset + 1] = var_data[part_idx][i + 1 * num_of_coords];
-                    flat->data[var_idx][var_offset + 2] = var_data[part_idx][i + 2 * num_of_coords];
-
-                    var_offset += 3;
-                }
-            }
-        }
-
-        // Need to interpolate
-        else if (variable->type == ENCAS_VARIABLE_SCALAR_PER_ELEMENT) {
-            for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx) {
-                Encas_MeshInfoPart *part = mesh_info->parts + part_idx;
-                u64 num_of_tetras = part->elem_vert_map_array_size / 4;
+        // Components of a value next to each other
+        // Need to interpolate the per element ones
+        for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx) {
+            Encas_MeshInfoPart *part = mesh_info->parts + part_idx;
+            u64 num_of_values = per_element ? part->elem_vert_map_array_size / 4 : (u64)part->num_of_coords;
 
-                memcpy(flat->data[var_idx] + var_offset, var_data[part_idx], num_of_tetras * sizeof(float));
-                var_offset += num_of_tetras;
+            if (num_of_data == 1) {
+                memcpy(flat->data[var_idx] + var_offset, var_data[part_idx], num_of_values * sizeof(float));
+                var_offset += num_of_values;
+                continue;
             }
-        } else if (variable->type == ENCAS_VARIABLE_VECTOR_PER_ELEMENT) {
-            for (u32 part_idx = 0; part_idx < mesh->len; ++part_idx) {
-                Encas_MeshInfoPart *part = mesh_info->parts + part_idx;
-                u64 num_of_tetras = part->elem_vert_map_array_size / 4;
 
-                for (u64 i = 0; i < num_of_tetras; ++i) {
-                    flat->data[var_idx][var_offset + 0] = var_data[part_idx][i + 0 * num_of_tetras];
-                    flat->data[var_idx][var_offset + 1] = var_data[part_idx][i + 1 * num_of_tetras];
-                    flat->data[var_idx][var_offset + 2] = var_data[part_idx][i + 2 * num_of_tetras];
+            for (u64 i = 0; i < num_of_values; ++i) {
+                for (u32 c = 0; c < num_of_data; ++c)
+                    flat->data[var_idx][var_offset + c] = var_data[part_idx][i + c * num_of_values];
 
-                    var_offset += 3;
-                }
+                var_offset += num_of_data;
             }
         }
 
@@ -3995,7 +8331,7 @@ ENCAS_API void Encas_MeshArray_To_FlatMesh(Encas_Case *encas, Encas_MeshArray *m
 
 ENCAS_API void Encas_DeleteFlatMesh(Encas_FlatMesh *flat) {
     ENCAS_FREE(flat->vertices);
-    ENCAS_FREE(flat->elem_vert_map);
+    ENCAS_FREE(flat->elem_vert_map.data);
     ENCAS_FREE(flat->data_sizes);
 
     for (u32 var_idx = 0; var_idx < flat->num_variables; ++var_idx)
@@ -4098,6 +8434,105 @@ ENCAS_API void Encas_RehashFaceKeyMap(Encas_FaceKeyMap *map, u32 new_cap) {
 
     ENCAS_FREE(old_keys);
     ENCAS_FREE(old_values);
+    ENCAS_FREE(old_global_indices);
+}
+
+// FNV-1a 64-bit hash
+static inline u64 hash_quadkey(const Encas_QuadKey *key) {
+    const u8 *data = (const u8 *)key;
+    u64 hash = 14695981039346656037ULL;
+    for (u32 i = 0; i < sizeof(Encas_QuadKey); ++i) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+ENCAS_API bool Encas_EqualQuadKey(const Encas_QuadKey *a, const Encas_QuadKey *b) {
+    return memcmp(a, b, sizeof(Encas_QuadKey)) == 0;
+}
+
+ENCAS_API void Encas_CreateQuadKeyMap(Encas_QuadKeyMap *map, u32 cap) {
+    map->cap = cap;
+    map->len = 0;
+    map->keys = (Encas_QuadKey *)ENCAS_MALLOC(map->cap * sizeof(Encas_QuadKey));
+    memset(map->keys, 0, map->cap * sizeof(Encas_QuadKey));
+    map->values = (u8 *)ENCAS_MALLOC(map->cap * sizeof(u8));
+    map->global_indices = (u32 *)ENCAS_MALLOC(map->cap * sizeof(u32));
+    memset(map->values, 0, map->cap * sizeof(u8));
+}
+
+ENCAS_API void Encas_DeleteQuadKeyMap(Encas_QuadKeyMap *map) {
+    ENCAS_FREE(map->keys);
+    ENCAS_FREE(map->values);
+    ENCAS_FREE(map->global_indices);
+    map->keys = NULL;
+    map->values = NULL;
+    map->global_indices = NULL;
+    map->cap = 0;
+    map->len = 0;
+}
+
+ENCAS_API void Encas_SetQuadKeyMap(Encas_QuadKeyMap *map, Encas_QuadKey key, u8 value, u32 global_idx) {
+    if ((float)map->len / map->cap >= LOAD_FACTOR) {
+        Encas_RehashQuadKeyMap(map, map->cap * 2);
+    }
+
+    u64 hash = hash_quadkey(&key);
+    u32 index = hash % map->cap;
+
+    while (map->values[index] != 0) {
+        if (Encas_EqualQuadKey(&map->keys[index], &key)) {
+            map->values[index] = value;
+            map->global_indices[index] = global_idx;
+            return;
+        }
+        index = (index + 1) % map->cap;
+    }
+
+    map->keys[index] = key;
+    map->values[index] = value;
+    map->global_indices[index] = global_idx;
+    map->len++;
+}
+
+ENCAS_API bool Encas_GetQuadKeyMap(Encas_QuadKeyMap *map, Encas_QuadKey key, u8 *out_value) {
+    u64 hash = hash_quadkey(&key);
+    u32 index = hash % map->cap;
+
+    while (map->values[index] != 0) {
+        if (Encas_EqualQuadKey(&map->keys[index], &key)) {
+            *out_value = map->values[index];
+            return true;
+        }
+        index = (index + 1) % map->cap;
+    }
+    return false;
+}
+
+ENCAS_API void Encas_RehashQuadKeyMap(Encas_QuadKeyMap *map, u32 new_cap) {
+    Encas_QuadKey *old_keys = map->keys;
+    u8 *old_values = map->values;
+    u32 *old_global_indices = map->global_indices;
+    u32 old_cap = map->cap;
+
+    map->keys = (Encas_QuadKey *)ENCAS_MALLOC(new_cap * sizeof(Encas_QuadKey));
+    memset(map->keys, 0, new_cap * sizeof(Encas_QuadKey));
+    map->values = (u8 *)ENCAS_MALLOC(new_cap * sizeof(u8));
+    memset(map->values, 0, new_cap * sizeof(u8));
+    map->global_indices = (u32 *)ENCAS_MALLOC(new_cap * sizeof(u32));
+    map->cap = new_cap;
+    map->len = 0;
+
+    for (u32 i = 0; i < old_cap; ++i) {
+        if (old_values[i] != 0) {
+            Encas_SetQuadKeyMap(map, old_keys[i], old_values[i], old_global_indices[i]);
+        }
+    }
+
+    ENCAS_FREE(old_keys);
+    ENCAS_FREE(old_values);
+    ENCAS_FREE(old_global_indices);
 }
 
 #endif /* ENCAS_IMPLEMENTATION */